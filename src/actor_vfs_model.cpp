@@ -8,8 +8,11 @@
  *
  */
 
+#include <algorithm>
 #include <vector>
 #include <stdint.h>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QTimer>
 #include <QIcon>
 #include <QDateTime>
@@ -17,6 +20,7 @@
 #include "actor/service.h"
 #include "actor/cxx_helper.h"
 #include "actor_vfs_model.h"
+#include "vfs_batch.h"
 #include "deconz/am_core.h"
 #include "deconz/am_vfs.h"
 #include "deconz/atom_table.h"
@@ -24,6 +28,7 @@
 #include "deconz/u_assert.h"
 #include "deconz/u_sstream.h"
 #include "deconz/u_memory.h"
+#include "deconz/util.h"
 
 #define AM_ACTOR_ID_REST_PLUGIN 4001
 #define AM_ACTOR_ID_UI_VFS      4006
@@ -31,6 +36,18 @@
 
 #define DIR_VALUE_INITIAL 0xDEADBEEF
 
+/*
+ * Up to maxInFlight list directory and read entry requests are outstanding at
+ * a time, responses are matched to their fetcher by tag.
+ * The depth can be set with --vfs-fetch-depth=<n>.
+ */
+#define VFS_FETCH_DEFAULT_DEPTH   8
+#define VFS_FETCH_CHECK_INTERVAL  50  // ms
+#define VFS_FETCH_TIMEOUT         200 // ms per request
+#define VFS_FETCH_MAX_RETRIES     3
+#define VFS_MAX_VISIBLE_ENTRIES   64
+#define VFS_MAX_PATH_DEPTH        32
+
 static struct am_api_functions *am = nullptr;
 static struct am_actor am_actor_vfs_model;
 
@@ -102,6 +119,8 @@ struct DirFetcher
     int timeout;
     uint32_t index;
     uint16_t tag;
+    uint8_t priority; // requested by the view
+    int64_t sendTime;
 };
 
 struct EntryFetcher
@@ -109,7 +128,11 @@ struct EntryFetcher
     int entryIndex;
     int timeout;
     uint16_t tag;
+    uint8_t priority; // visible in the view
+    uint8_t refetch; // changed while the request was in flight
+    uint8_t batchIndex; // position in a VFS_M_ID_READ_ENTRIES_REQ
     EntryFetchState state;
+    int64_t sendTime;
 };
 
 
@@ -119,8 +142,13 @@ public:
     std::vector<Entry> entries;
     std::vector<DirFetcher> dirFetchers;
     std::vector<EntryFetcher> entryFetchers;
+    std::vector<int> visibleEntries;
+    std::vector<uint64_t> entryMtime; // by entry index, grows on demand
+    QHash<uint64_t, int> children; // (parent, name atom) -> child entry, see childKey()
     uint16_t allocTag = 1;
+    unsigned maxInFlight = VFS_FETCH_DEFAULT_DEPTH;
     QTimer fetchTimer;
+    QElapsedTimer clock;
 
     QIcon iconActor;
     QIcon iconDirectory;
@@ -136,9 +164,16 @@ static const char* amResponseStatusToString(unsigned status)
     if (status == AM_RESPONSE_STATUS_TIMEOUT) return "NTIMEOUT";
     if (status == AM_RESPONSE_STATUS_FAIL) return "FAIL";
     if (status == AM_RESPONSE_STATUS_UNSUPPORTED) return "UNSUPPORTED";
+    if (status == VFS_RESPONSE_STATUS_NOT_MODIFIED) return "NOT_MODIFIED";
     return "UNKNOWN";
 }
 
+static inline uint64_t childKey(int parent_e, AT_AtomIndex name)
+{
+    return (uint64_t(uint32_t(parent_e)) << 32) | name.index;
+}
+
+/*! Entries are never removed, so the children index is only extended in addEntryToParent(). */
 int findChildEntry(const std::vector<Entry> &entries, int parent_e, AT_AtomIndex name)
 {
     if (parent_e < 0)
@@ -147,39 +182,78 @@ int findChildEntry(const std::vector<Entry> &entries, int parent_e, AT_AtomIndex
     if (parent_e >= (int)entries.size())
         return ENTRY_CHILD_NONE;
 
-    int e = entries[parent_e].child;
+    return _priv->children.value(childKey(parent_e, name), ENTRY_CHILD_NONE);
+}
+
+/*! Writes the path of entry \p e relative to its actor, empty for the actor itself.
+    \returns the actor entry, or -1 if the path is deeper than VFS_MAX_PATH_DEPTH, nothing is written then
+ */
+static int putEntryPath(U_SStream *ss, int e)
+{
+    const auto &entries = _priv->entries;
+    int path[VFS_MAX_PATH_DEPTH];
+    int depth = 0;
 
-    for (;e > 0;)
+    for (;entries[e].parent >= 0;)
     {
-        if (entries[e].name == name)
-            return e;
+        if (depth == VFS_MAX_PATH_DEPTH)
+        {
+            DBG_Printf(DBG_ERROR, "vfs model: path of entry %d exceeds max depth %d\n", path[0], VFS_MAX_PATH_DEPTH);
+            return -1;
+        }
+        path[depth++] = e;
+        e = entries[e].parent;
+    }
 
-        e = entries[e].sibling;
+    while (depth > 0)
+    {
+        depth--;
+        AT_Atom a = AT_GetAtomByIndex(entries[path[depth]].name);
+        if (a.len)
+        {
+            U_sstream_put_str(ss, (const char*)a.data);
+            if (depth > 0)
+                U_sstream_put_str(ss, "/");
+        }
     }
 
-    return ENTRY_CHILD_NONE;
+    return e;
 }
 
 static void addEntryToValueFetchers(int e)
 {
-    for (const EntryFetcher &ef : _priv->entryFetchers)
+    for (EntryFetcher &ef : _priv->entryFetchers)
     {
         if (ef.entryIndex == e)
+        {
+            // a pending request already gets the latest value,
+            // an outstanding one might be older than the change
+            if (ef.state == ENTRY_FETCH_STATE_WAIT_RESPONSE)
+                ef.refetch = 1;
             return;
+        }
     }
 
-    EntryFetcher ef;
+    EntryFetcher ef = {};
     ef.state = ENTRY_FETCH_STATE_WAIT_START;
     ef.entryIndex = e;
-    ef.tag = 0;
-    ef.timeout = 0;
 
     _priv->entryFetchers.push_back(ef);
 }
 
+/*! Called for value cells painted by the view, these are fetched first. */
+static void markVisibleEntry(int e)
+{
+    auto &visible = _priv->visibleEntries;
+
+    if (visible.size() < VFS_MAX_VISIBLE_ENTRIES && std::find(visible.begin(), visible.end(), e) == visible.end())
+        visible.push_back(e);
+}
+
 static void addEntryToParent(std::vector<Entry> &entries, int parent_e, Entry &entry)
 {
     entries.push_back(entry);
+    _priv->children.insert(childKey(parent_e, entry.name), int(entries.size() - 1));
 
     if (entries[parent_e].child < 0)
     {
@@ -223,49 +297,24 @@ static void listDirectoryRequest(DirFetcher &df)
     int e = df.entryIndex;
     DBG_Assert(e >= 0);
 
-    am_actor_id dstActorId;
-    auto &entries = _priv->entries;
-    Entry &entry = entries[e];
-
-    {
-        int ep = e;
-        for (;_priv->entries[ep].parent >= 0;)
-        {
-            ep = _priv->entries[ep].parent;
-        }
-
-        dstActorId = _priv->entries[ep].value;
-    }
-
     U_ASSERT(df.state == ENTRY_FETCH_STATE_WAIT_START);
 
-    std::vector<int> path;
-
-    for (;entries[e].parent >= 0;)
-    {
-        path.push_back(e);
-        e = entries[e].parent;
-    }
-
     char url[1024];
     url[0] = '\0';
     U_SStream ss;
 
     U_sstream_init(&ss, url, sizeof(url));
 
-    while (!path.empty()) // can be empty for actors as root
+    // empty for actors as root
+    const int actorEntry = putEntryPath(&ss, e);
+    if (actorEntry < 0)
     {
-        e = path.back();
-        path.pop_back();
-        AT_Atom a = AT_GetAtomByIndex(entries[e].name);
-        if (a.len)
-        {
-            U_sstream_put_str(&ss, (const char*)a.data);
-            if (!path.empty())
-                U_sstream_put_str(&ss, "/");
-        }
+        df.state = ENTRY_FETCH_STATE_DONE; // can't be addressed, don't retry
+        return;
     }
 
+    const am_actor_id dstActorId = _priv->entries[actorEntry].value;
+
     am_message *m = am->msg_alloc();
     if (!m)
         return;
@@ -284,57 +333,64 @@ static void listDirectoryRequest(DirFetcher &df)
     m->id = VFS_M_ID_LIST_DIR_REQ;
 
     if (am->send_message(m))
+    {
         df.state = ENTRY_FETCH_STATE_WAIT_RESPONSE;
+        df.sendTime = _priv->clock.elapsed();
+    }
 
 }
 
-static int readEntryRequest(EntryFetcher &ef)
+static am_actor_id actorForEntry(int e)
 {
-    int e = ef.entryIndex;
+    for (;_priv->entries[e].parent >= 0;)
+    {
+        e = _priv->entries[e].parent;
+    }
 
-    if (e < 0)
-        return 0;
+    return _priv->entries[e].value;
+}
 
-    auto &entries = _priv->entries;
-    Entry &entry = entries[e];
+/*! Writes the url of entry \p e for a read request.
+    \returns false if the entry can't be addressed, see putEntryPath()
+ */
+static bool putEntryUrl(U_SStream *ss, int e)
+{
+    if (_priv->entries[e].parent < 0)
+    {
+        // special case query actors name
+        U_sstream_put_str(ss, ".actor/name");
+        return true;
+    }
 
-    U_ASSERT(ef.state == ENTRY_FETCH_STATE_WAIT_START);
+    return putEntryPath(ss, e) >= 0;
+}
 
-    std::vector<int> path;
+/*! Sends the read request of a single entry.
+    \returns 1 if sent, 0 if no message is available, -1 if the entry can't be addressed
+ */
+static int readEntryRequest(EntryFetcher &ef)
+{
+    int e = ef.entryIndex;
 
-    for (;entries[e].parent >= 0;)
+    if (e < 0)
     {
-        path.push_back(e);
-        e = entries[e].parent;
+        ef.state = ENTRY_FETCH_STATE_DONE;
+        return -1;
     }
 
-    am_actor_id actorId = entries[e].value;
+    U_ASSERT(ef.state == ENTRY_FETCH_STATE_WAIT_START);
+
+    am_actor_id actorId = actorForEntry(e);
 
     char url[1024];
     url[0] = '\0';
     U_SStream ss;
 
     U_sstream_init(&ss, url, sizeof(url));
-
-    if (path.empty() && entry.parent < 0)
+    if (!putEntryUrl(&ss, e))
     {
-        // special case query actors name
-        U_sstream_put_str(&ss, ".actor/name");
-    }
-    else
-    {
-        while (!path.empty()) // can be empty for actors as root
-        {
-            e = path.back();
-            path.pop_back();
-            AT_Atom a = AT_GetAtomByIndex(entries[e].name);
-            if (a.len)
-            {
-                U_sstream_put_str(&ss, (const char*)a.data);
-                if (!path.empty())
-                    U_sstream_put_str(&ss, "/");
-            }
-        }
+        ef.state = ENTRY_FETCH_STATE_DONE; // can't be addressed, don't retry
+        return -1;
     }
 
     am_message *m = am->msg_alloc();
@@ -346,7 +402,8 @@ static int readEntryRequest(EntryFetcher &ef)
     _priv->allocTag++;
     ef.tag = _priv->allocTag;
     ef.state = ENTRY_FETCH_STATE_WAIT_RESPONSE;
-    ef.timeout = 0;
+    ef.sendTime = _priv->clock.elapsed();
+    ef.batchIndex = 0;
 
     am->msg_put_u16(m, ef.tag);
     am->msg_put_cstring(m, url);
@@ -362,6 +419,116 @@ static int readEntryRequest(EntryFetcher &ef)
     return 0;
 }
 
+/*! Reads pending core_aps entries starting at \p first in one batch, see vfs_batch.h.
+    \returns 1 if sent, 0 if no message is available, -1 if none of the entries can be addressed
+ */
+static int readEntriesRequest(size_t first, int minPriority)
+{
+    auto &fetchers = _priv->entryFetchers;
+
+    am_message *m = am->msg_alloc();
+    if (!m)
+        return 0;
+
+    _priv->allocTag++;
+    const uint16_t tag = _priv->allocTag;
+    const int64_t now = _priv->clock.elapsed();
+    unsigned count = 0;
+
+    am->msg_put_u16(m, tag);
+    const unsigned countPos = m->pos;
+    am->msg_put_u16(m, 0); // updated below
+
+    for (size_t i = first; i < fetchers.size() && count < VFS_READ_ENTRIES_MAX; i++)
+    {
+        EntryFetcher &ef = fetchers[i];
+
+        if (ef.state != ENTRY_FETCH_STATE_WAIT_START || ef.priority < minPriority)
+            continue;
+
+        if (ef.entryIndex < 0 || actorForEntry(ef.entryIndex) != AM_ACTOR_ID_CORE_APS)
+            continue;
+
+        char url[1024];
+        url[0] = '\0';
+        U_SStream ss;
+
+        U_sstream_init(&ss, url, sizeof(url));
+        if (!putEntryUrl(&ss, ef.entryIndex))
+        {
+            ef.state = ENTRY_FETCH_STATE_DONE; // can't be addressed, don't retry
+            continue;
+        }
+
+        // values which weren't read yet have no mtime
+        uint64_t since = 0;
+        if ((size_t)ef.entryIndex < _priv->entryMtime.size())
+            since = _priv->entryMtime[ef.entryIndex];
+
+        const unsigned pos = m->pos;
+        am->msg_put_cstring(m, url);
+        am->msg_put_u64(m, since);
+        if (m->status != AM_MSG_STATUS_OK) // message full
+        {
+            m->pos = pos;
+            m->status = AM_MSG_STATUS_OK;
+            break;
+        }
+
+        ef.tag = tag;
+        ef.batchIndex = count;
+        ef.state = ENTRY_FETCH_STATE_WAIT_RESPONSE;
+        ef.sendTime = now;
+        count++;
+    }
+
+    const unsigned endPos = m->pos;
+    m->pos = countPos;
+    am->msg_put_u16(m, count);
+    m->pos = endPos;
+
+    DBG_Printf(DBG_VFS, "vfs model: fetch %u values, tag: %u\n", count, tag);
+
+    m->src = AM_ACTOR_ID_UI_VFS;
+    m->dst = AM_ACTOR_ID_CORE_APS;
+    m->id = VFS_M_ID_READ_ENTRIES_REQ;
+
+    if (count == 0)
+        return -1;
+
+    if (am->send_message(m))
+        return 1;
+
+    for (EntryFetcher &ef : fetchers)
+    {
+        if (ef.tag == tag && ef.state == ENTRY_FETCH_STATE_WAIT_RESPONSE)
+            ef.state = ENTRY_FETCH_STATE_WAIT_START;
+    }
+
+    return 0;
+}
+
+/*! Removes a fetcher after its response and returns the entry index. */
+static int removeEntryFetcher(size_t i)
+{
+    auto &fetchers = _priv->entryFetchers;
+
+    EntryFetcher ef = fetchers[i];
+    fetchers[i] = fetchers.back();
+    fetchers.pop_back();
+
+    if (ef.entryIndex >= 0 && ef.refetch)
+    {
+        // collapse all change notifies received meanwhile into one read
+        ef.state = ENTRY_FETCH_STATE_WAIT_START;
+        ef.refetch = 0;
+        ef.timeout = 0;
+        fetchers.push_back(ef);
+    }
+
+    return ef.entryIndex;
+}
+
 int ActorVfsModel::listDirectoryResponse(am_message *msg)
 {
     unsigned i;
@@ -402,8 +569,6 @@ int ActorVfsModel::listDirectoryResponse(am_message *msg)
     _priv->dirFetchers[fetcherIndex] = _priv->dirFetchers.back();
     _priv->dirFetchers.pop_back();
 
-    priv->fetchTimer.stop(); // clear for continuation
-
     if (status == AM_RESPONSE_STATUS_OK)
     {
         index = am->msg_get_u32(msg);
@@ -689,15 +854,126 @@ int ActorVfsModel::changedNotify(am_message *msg)
     return AM_CB_STATUS_UNSUPPORTED;
 }
 
+/*! Reads type, mode, mtime and value of entry \p e from a read entry response. */
+bool ActorVfsModel::updateEntryValue(int e, am_message *msg)
+{
+    am_string type;
+    unsigned mode;
+    uint64_t mtime;
+
+    Entry &entry = priv->entries[e];
+
+    type = am->msg_get_string(msg);
+    mode = am->msg_get_u32(msg);
+    mtime = am->msg_get_u64(msg);
+
+    AT_AtomIndex ati_type = ati_unknown;
+    if (type.size)
+    {
+        if (0 == AT_GetAtomIndex(type.data, type.size, &ati_type))
+            ati_type = ati_unknown;
+    }
+
+    if (msg->status == AM_MSG_STATUS_OK && type.size)
+    {
+        entry.mode = mode;
+        entry.type = ati_type;
+
+        if (priv->entryMtime.size() <= (size_t)e)
+            priv->entryMtime.resize(priv->entries.size(), 0);
+        priv->entryMtime[e] = mtime;
+
+        if      (type == "bool") { entry.value = am->msg_get_u8(msg); }
+        else if (type == "u8")   { entry.value = am->msg_get_u8(msg); }
+        else if (type == "u16")  { entry.value = am->msg_get_u16(msg); }
+        else if (type == "u32")  { entry.value = am->msg_get_u32(msg); }
+        else if (type == "u64")  { entry.value = am->msg_get_u64(msg); }
+        else if (type == "i8")   { entry.value = am->msg_get_s8(msg); }
+        else if (type == "i16")  { entry.value = am->msg_get_s16(msg); }
+        else if (type == "i32")  { entry.value = am->msg_get_s32(msg); }
+        else if (type == "i64")  { entry.value = am->msg_get_s64(msg); }
+        else if (type == "time")  { entry.value = am->msg_get_s64(msg); }
+        else if (type == "str")
+        {
+            am_string str = am->msg_get_string(msg);
+            entry.value = str.size;
+            if (entry.value > sizeof(entry.data))
+                entry.value = sizeof(entry.data);
+
+            for (unsigned i = 0; i < entry.value; i++)
+            {
+                entry.data[i] = (uint8_t)str.data[i];
+            }
+
+            // special case: .actor/name in root entry
+            U_ASSERT(entry.parent >= 0);
+            if (entry.name == ati_name && priv->entries[entry.parent].name == ati_dot_actor)
+            {
+                int ppp = priv->entries[entry.parent].parent;
+                Entry &actorEntry = priv->entries[ppp];
+                if (actorEntry.name == ati_unknown)
+                {
+                    AT_AddAtom(str.data, str.size, &actorEntry.name);
+
+                    QModelIndex index = createIndex(ppp, 0, (quintptr)ppp);
+                    emit dataChanged(index, index);
+                }
+            }
+        }
+        else if (type == "blob")
+        {
+            am_blob blob = am->msg_get_blob(msg);
+            entry.value = blob.size;
+            if (entry.value > sizeof(entry.data))
+                entry.value = sizeof(entry.data);
+
+            for (unsigned i = 0; i < entry.value; i++)
+            {
+                entry.data[i] = blob.data[i];
+            }
+        }
+        else
+        {
+            DBG_Printf(DBG_VFS, "vfs model: read entry rsp: TODO handle type\n");
+        }
+
+        DBG_Printf(DBG_VFS, "vfs model: read entry rsp: type: %.*s, value: %llu\n", type.size, type.data, (unsigned long long)entry.value);
+
+        {
+            int parent_e = priv->entries[e].parent;
+
+            if (parent_e < 0)
+                parent_e = 0;
+
+            int row = 0;
+            int child = priv->entries[parent_e].child;
+            for (; child > 0; )
+            {
+                if (child == e)
+                    break;
+
+                row++;
+                child = priv->entries[child].sibling;
+            }
+
+            int column = 1; // type;
+            QModelIndex index = createIndex(row, column, (quintptr)e);
+            column = 2; // value;
+            QModelIndex index2 = createIndex(row, column, (quintptr)e);
+            emit dataChanged(index, index2);
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
 int ActorVfsModel::readEntryResponse(am_message *msg)
 {
     int e;
     unsigned status;
     unsigned short tag;
-
-    am_string type;
-    unsigned mode;
-    uint64_t mtime;
     int fetchIter;
 
     tag = am->msg_get_u16(msg);
@@ -712,167 +988,192 @@ int ActorVfsModel::readEntryResponse(am_message *msg)
     if (fetchIter == priv->entryFetchers.size())
         return AM_CB_STATUS_OK;
 
-    {
-        EntryFetcher ef = priv->entryFetchers[fetchIter];
-        priv->entryFetchers[fetchIter] = priv->entryFetchers.back();
-        priv->entryFetchers.pop_back();
-
-        if (ef.state == ENTRY_FETCH_STATE_WAIT_RESPONSE)
-            priv->fetchTimer.stop(); // clear for continuation
-
-        e = ef.entryIndex;
-        if (e < 0)
-            return AM_CB_STATUS_OK;
-    }
+    e = removeEntryFetcher(fetchIter);
+    if (e < 0)
+        return AM_CB_STATUS_OK;
 
     Entry &entry = priv->entries[e];
 
     if (status == AM_RESPONSE_STATUS_OK && msg->status == AM_MSG_STATUS_OK)
     {
-        type = am->msg_get_string(msg);
-        mode = am->msg_get_u32(msg);
-        mtime = am->msg_get_u64(msg);
-        (void)mtime;
-
-        AT_AtomIndex ati_type = ati_unknown;
-        if (type.size)
-        {
-            if (0 == AT_GetAtomIndex(type.data, type.size, &ati_type))
-                ati_type = ati_unknown;
-        }
-
-        if (msg->status == AM_MSG_STATUS_OK && type.size)
+        if (updateEntryValue(e, msg))
+            return AM_CB_STATUS_OK;
+    }
+    else
+    {
+        // if this is a actor entry assume it doesn't export a vfs
+        if (entry.parent == ENTRY_PARENT_NONE)
         {
-            entry.mode = mode;
-            entry.type = ati_type;
-
-            if      (type == "bool") { entry.value = am->msg_get_u8(msg); }
-            else if (type == "u8")   { entry.value = am->msg_get_u8(msg); }
-            else if (type == "u16")  { entry.value = am->msg_get_u16(msg); }
-            else if (type == "u32")  { entry.value = am->msg_get_u32(msg); }
-            else if (type == "u64")  { entry.value = am->msg_get_u64(msg); }
-            else if (type == "i8")   { entry.value = am->msg_get_s8(msg); }
-            else if (type == "i16")  { entry.value = am->msg_get_s16(msg); }
-            else if (type == "i32")  { entry.value = am->msg_get_s32(msg); }
-            else if (type == "i64")  { entry.value = am->msg_get_s64(msg); }
-            else if (type == "time")  { entry.value = am->msg_get_s64(msg); }
-            else if (type == "str")
+            if (entry.child == ENTRY_CHILD_UNKNOWN)
             {
-                am_string str = am->msg_get_string(msg);
-                entry.value = str.size;
-                if (entry.value > sizeof(entry.data))
-                    entry.value = sizeof(entry.data);
+                entry.child = ENTRY_CHILD_NONE;
+            }
+        }
+    }
 
-                for (unsigned i = 0; i < entry.value; i++)
-                {
-                    entry.data[i] = (uint8_t)str.data[i];
-                }
+    DBG_Printf(DBG_VFS, "vfs model: read entry: %d response error, tag: %u, status: %s (%u)\n", e, tag, amResponseStatusToString(status), status);
+    return AM_CB_STATUS_OK;
+}
 
-                // special case: .actor/name in root entry
-                U_ASSERT(entry.parent >= 0);
-                if (entry.name == ati_name && priv->entries[entry.parent].name == ati_dot_actor)
-                {
-                    int ppp = priv->entries[entry.parent].parent;
-                    Entry &actorEntry = priv->entries[ppp];
-                    if (actorEntry.name == ati_unknown)
-                    {
-                        AT_AddAtom(str.data, str.size, &actorEntry.name);
+int ActorVfsModel::readEntriesResponse(am_message *msg)
+{
+    unsigned status;
+    unsigned short tag;
+    unsigned count = 0;
 
-                        QModelIndex index = createIndex(ppp, 0, (quintptr)ppp);
-                        emit dataChanged(index, index);
-                    }
-                }
-            }
-            else if (type == "blob")
-            {
-                am_blob blob = am->msg_get_blob(msg);
-                entry.value = blob.size;
-                if (entry.value > sizeof(entry.data))
-                    entry.value = sizeof(entry.data);
+    tag = am->msg_get_u16(msg);
+    status = am->msg_get_u8(msg);
 
-                for (unsigned i = 0; i < entry.value; i++)
-                {
-                    entry.data[i] = blob.data[i];
-                }
-            }
-            else
-            {
-                DBG_Printf(DBG_VFS, "vfs model: read entry rsp: TODO handle type\n");
-            }
+    if (status == AM_RESPONSE_STATUS_OK)
+        count = am->msg_get_u16(msg);
 
-            DBG_Printf(DBG_VFS, "vfs model: read entry rsp: type: %.*s, value: %llu\n", type.size, type.data, (unsigned long long)entry.value);
+    if (msg->status != AM_MSG_STATUS_OK)
+        return AM_CB_STATUS_INVALID;
 
-            {
-                int parent_e = priv->entries[e].parent;
+    DBG_Printf(DBG_VFS, "vfs model: read entries rsp, tag: %u, status: %s (%u), count: %u\n", tag, amResponseStatusToString(status), status, count);
 
-                if (parent_e < 0)
-                    parent_e = 0;
+    for (unsigned i = 0; i < count; i++)
+    {
+        size_t fetchIter;
+        for (fetchIter = 0; fetchIter < priv->entryFetchers.size(); fetchIter++)
+        {
+            const EntryFetcher &ef = priv->entryFetchers[fetchIter];
+            if (ef.tag == tag && ef.batchIndex == i && ef.state == ENTRY_FETCH_STATE_WAIT_RESPONSE)
+                break;
+        }
 
-                int row = 0;
-                int child = priv->entries[parent_e].child;
-                for (; child > 0; )
-                {
-                    if (child == e)
-                        break;
+        // timed out and requested again, the remaining values can't be skipped
+        if (fetchIter == priv->entryFetchers.size())
+            break;
 
-                    row++;
-                    child = priv->entries[child].sibling;
-                }
+        const int e = removeEntryFetcher(fetchIter);
+        const unsigned entryStatus = am->msg_get_u8(msg);
 
-                int column = 1; // type;
-                QModelIndex index = createIndex(row, column, (quintptr)e);
-                column = 2; // value;
-                QModelIndex index2 = createIndex(row, column, (quintptr)e);
-                emit dataChanged(index, index2);
-            }
+        if (entryStatus == VFS_RESPONSE_STATUS_NOT_MODIFIED)
+            continue;
 
-            return AM_CB_STATUS_OK;
+        if (entryStatus != AM_RESPONSE_STATUS_OK)
+        {
+            DBG_Printf(DBG_VFS, "vfs model: read entry: %d response error, status: %s (%u)\n", e, amResponseStatusToString(entryStatus), entryStatus);
+            continue;
         }
+
+        if (msg->status != AM_MSG_STATUS_OK || !updateEntryValue(e, msg))
+            break;
     }
-    else
+
+    for (size_t i = 0; i < priv->entryFetchers.size(); )
     {
-        // if this is a actor entry assume it doesn't export a vfs
-        if (entry.parent == ENTRY_PARENT_NONE)
+        EntryFetcher &ef = priv->entryFetchers[i];
+
+        if (ef.tag == tag && ef.state == ENTRY_FETCH_STATE_WAIT_RESPONSE)
         {
-            if (entry.child == ENTRY_CHILD_UNKNOWN)
+            if (status == AM_RESPONSE_STATUS_OK)
             {
-                entry.child = ENTRY_CHILD_NONE;
+                ef.state = ENTRY_FETCH_STATE_WAIT_START; // didn't fit in the response
+            }
+            else
+            {
+                removeEntryFetcher(i);
+                continue;
             }
         }
+        i++;
     }
 
-    DBG_Printf(DBG_VFS, "vfs model: read entry: %d response error, tag: %u, status: %s (%u)\n", e, tag, amResponseStatusToString(status), status);
     return AM_CB_STATUS_OK;
 }
 
+/*! Sends pending requests until maxInFlight requests are outstanding.
+    Requests for entries shown in the view go first, directories before values.
+ */
 void ActorVfsModel::continueFetching()
 {
-    if (!priv->dirFetchers.empty())
+    auto &visible = priv->visibleEntries;
+
+    if (!visible.empty())
     {
-        DirFetcher &df = priv->dirFetchers.front();
+        for (EntryFetcher &ef : priv->entryFetchers)
+        {
+            if (ef.priority == 0 && std::find(visible.begin(), visible.end(), ef.entryIndex) != visible.end())
+                ef.priority = 1;
+        }
+        visible.clear();
+    }
+
+    unsigned inFlight = 0;
 
-        if (df.state == ENTRY_FETCH_STATE_WAIT_START)
+    for (const DirFetcher &df : priv->dirFetchers)
+    {
+        if (df.state == ENTRY_FETCH_STATE_WAIT_RESPONSE)
+            inFlight++;
+    }
+
+    for (const EntryFetcher &ef : priv->entryFetchers)
+    {
+        if (ef.state == ENTRY_FETCH_STATE_WAIT_RESPONSE && ef.batchIndex == 0) // a batch counts once
+            inFlight++;
+    }
+
+    bool blocked = false; // no message available
+
+    for (int minPriority = 1; minPriority >= 0 && !blocked; minPriority--)
+    {
+        for (size_t i = 0; i < priv->dirFetchers.size() && inFlight < priv->maxInFlight; i++)
         {
+            DirFetcher &df = priv->dirFetchers[i];
+
+            if (df.state != ENTRY_FETCH_STATE_WAIT_START || df.priority < minPriority)
+                continue;
+
             listDirectoryRequest(df);
-            if (df.state == ENTRY_FETCH_STATE_WAIT_RESPONSE)
+            if (df.state == ENTRY_FETCH_STATE_DONE)
+                continue;
+
+            if (df.state != ENTRY_FETCH_STATE_WAIT_RESPONSE)
             {
-                priv->fetchTimer.start(50);
+                blocked = true;
+                break;
             }
+            inFlight++;
         }
-    }
-    else if (!priv->entryFetchers.empty())
-    {
-        EntryFetcher &ef = priv->entryFetchers.front();
 
-        if (ef.state == ENTRY_FETCH_STATE_WAIT_START)
+        for (size_t i = 0; i < priv->entryFetchers.size() && inFlight < priv->maxInFlight && !blocked; i++)
         {
-            readEntryRequest(ef);
-            if (ef.state == ENTRY_FETCH_STATE_WAIT_RESPONSE)
+            EntryFetcher &ef = priv->entryFetchers[i];
+
+            if (ef.state != ENTRY_FETCH_STATE_WAIT_START || ef.priority < minPriority)
+                continue;
+
+            int ret;
+            if (ef.entryIndex >= 0 && actorForEntry(ef.entryIndex) == AM_ACTOR_ID_CORE_APS)
+                ret = readEntriesRequest(i, minPriority);
+            else
+                ret = readEntryRequest(ef);
+
+            if (ret < 0)
+                continue;
+
+            if (ret == 0)
             {
-                priv->fetchTimer.start(50);
+                blocked = true;
+                break;
             }
+            inFlight++;
         }
     }
+
+    // drop fetchers of entries which can't be addressed
+    const auto isDone = [](const auto &fetcher) { return fetcher.state == ENTRY_FETCH_STATE_DONE; };
+    auto &dirFetchers = priv->dirFetchers;
+    auto &entryFetchers = priv->entryFetchers;
+    dirFetchers.erase(std::remove_if(dirFetchers.begin(), dirFetchers.end(), isDone), dirFetchers.end());
+    entryFetchers.erase(std::remove_if(entryFetchers.begin(), entryFetchers.end(), isDone), entryFetchers.end());
+
+    if ((inFlight > 0 || blocked) && !priv->fetchTimer.isActive())
+    {
+        priv->fetchTimer.start(VFS_FETCH_CHECK_INTERVAL);
+    }
 }
 
 void ActorVfsModel::addActorId(unsigned int actorId)
@@ -951,46 +1252,49 @@ ActorVfsModel *ActorVfsModel::instance()
 
 void ActorVfsModel::fetchTimerFired()
 {
-    DBG_Printf(DBG_VFS, "vfs timer fired after %d, dirf: %zu, entryFetchers.size: %zu\n", priv->fetchTimer.interval(), priv->dirFetchers.size(), priv->entryFetchers.size());
+    const int64_t now = priv->clock.elapsed();
 
-    if (!priv->dirFetchers.empty())
+    DBG_Printf(DBG_VFS, "vfs timer fired, dirf: %zu, entryFetchers.size: %zu\n", priv->dirFetchers.size(), priv->entryFetchers.size());
+
+    for (size_t i = 0; i < priv->dirFetchers.size(); )
     {
-        DirFetcher &df = priv->dirFetchers.front();
+        DirFetcher &df = priv->dirFetchers[i];
 
-        if (df.state == ENTRY_FETCH_STATE_WAIT_RESPONSE)
+        if (df.state == ENTRY_FETCH_STATE_WAIT_RESPONSE && now - df.sendTime >= VFS_FETCH_TIMEOUT)
         {
             df.timeout++;
-            if (df.timeout < 3)
-            {
-                df.state = ENTRY_FETCH_STATE_WAIT_START;
-            }
-            else
+            if (df.timeout >= VFS_FETCH_MAX_RETRIES)
             {
-                priv->dirFetchers.front() = priv->dirFetchers.back();
+                DBG_Printf(DBG_VFS, "vfs model: list directory e: %d timeout, give up\n", df.entryIndex);
+                df = priv->dirFetchers.back();
                 priv->dirFetchers.pop_back();
+                continue;
             }
-            continueFetching();
+            df.state = ENTRY_FETCH_STATE_WAIT_START;
         }
+        i++;
     }
-    else if (!priv->entryFetchers.empty())
+
+    for (size_t i = 0; i < priv->entryFetchers.size(); )
     {
-        EntryFetcher &ef = priv->entryFetchers.front();
+        EntryFetcher &ef = priv->entryFetchers[i];
 
-        if (ef.state == ENTRY_FETCH_STATE_WAIT_RESPONSE)
+        if (ef.state == ENTRY_FETCH_STATE_WAIT_RESPONSE && now - ef.sendTime >= VFS_FETCH_TIMEOUT)
         {
             ef.timeout++;
-            if (ef.timeout < 3)
+            if (ef.timeout >= VFS_FETCH_MAX_RETRIES)
             {
-                ef.state = ENTRY_FETCH_STATE_WAIT_START;
-            }
-            else
-            {
-                priv->entryFetchers.front() = priv->entryFetchers.back();
+                DBG_Printf(DBG_VFS, "vfs model: read entry e: %d timeout, give up\n", ef.entryIndex);
+                ef = priv->entryFetchers.back();
                 priv->entryFetchers.pop_back();
+                continue;
             }
-            continueFetching();
+            ef.state = ENTRY_FETCH_STATE_WAIT_START;
         }
+        i++;
     }
+
+    continueFetching();
 }
 
 static int VfsModel_MessageCallback(struct am_message *msg)
@@ -1011,6 +1315,11 @@ static int VfsModel_MessageCallback(struct am_message *msg)
         ret = _instance->listDirectoryResponse(msg);
         _instance->continueFetching();
     }
+    else if (msg->id == VFS_M_ID_READ_ENTRIES_RSP)
+    {
+        ret = _instance->readEntriesResponse(msg);
+        _instance->continueFetching();
+    }
 
     return ret;
 }
@@ -1023,6 +1332,9 @@ ActorVfsModel::ActorVfsModel(QObject *parent) :
     _priv = priv;
     _instance = this;
 
+    priv->maxInFlight = qMax(1, int(deCONZ::appArgumentNumeric("--vfs-fetch-depth", VFS_FETCH_DEFAULT_DEPTH)));
+    priv->clock.start();
+
     priv->iconActor.addFile(":/icons/cryo/32/drive-disk.png");
     priv->iconDirectory.addFile(":/icons/cryo/32/folder.png");
 
@@ -1123,6 +1435,9 @@ QVariant ActorVfsModel::data(const QModelIndex &index, int role) const
                 if (entry.type == ati_type_dir)
                     return QVariant();
 
+                if (entry.type == ati_unknown)
+                    markVisibleEntry(e);
+
                 unsigned display = (entry.mode & 0xF0000);
 
                 if (display == VFS_ENTRY_MODE_DISPLAY_HEX)
@@ -1436,6 +1751,7 @@ void ActorVfsModel::fetchMore(const QModelIndex &parent)
         df.index = 0;
         df.state = ENTRY_FETCH_STATE_WAIT_START;
         df.timeout = 0;
+        df.priority = 1;
 
         priv->dirFetchers.push_back(df);
         continueFetching();
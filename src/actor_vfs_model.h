@@ -52,6 +52,7 @@ public:
     int changedNotify(struct am_message *msg);
     int listDirectoryResponse(struct am_message *msg);
     int readEntryResponse(struct am_message *msg);
+    int readEntriesResponse(struct am_message *msg);
     void continueFetching();
 
     void addActorId(unsigned actorId);
@@ -63,6 +64,7 @@ private Q_SLOTS:
     void fetchTimerFired();
 
 private:
+    bool updateEntryValue(int e, struct am_message *msg);
 
     ActorVfsModelPrivate *priv = nullptr;
 };
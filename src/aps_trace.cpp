@@ -0,0 +1,540 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <fcntl.h>
+#ifdef _WIN32
+  #include <io.h>
+#else
+  #include <unistd.h>
+#endif
+#include "deconz/aps.h"
+#include "deconz/dbg_trace.h"
+#include "deconz/u_platform.h"
+#include "deconz/util.h"
+#include "aps_trace.h"
+
+#define TRC_MAX_THREADS 8
+#define TRC_FILE_VERSION 1
+
+/*! Ring of one thread, written only by the owning thread. */
+struct TRC_Ring
+{
+    uint8_t thread;
+    uint32_t size; // power of two
+    std::atomic<uint32_t> head;
+    TRC_Record *records;
+};
+
+struct TRC_FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+};
+
+std::atomic<bool> trcEnabled{false};
+
+static unsigned trcRingSize = 0;
+static std::atomic<unsigned> trcRingCount{0};
+static TRC_Ring *trcRings[TRC_MAX_THREADS];
+static thread_local TRC_Ring *trcRing = nullptr;
+static char trcDumpPath[512];
+static char trcCrashPath[512];
+
+static uint64_t TRC_TimeUs()
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+}
+
+/*! Returns the next record of the calling threads ring, or nullptr if no ring is available. */
+static TRC_Record *TRC_Next()
+{
+    TRC_Ring *ring = trcRing;
+
+    if (!ring)
+    {
+        const unsigned n = trcRingCount.load(std::memory_order_relaxed);
+        if (n >= TRC_MAX_THREADS || trcRingSize == 0)
+        {
+            return nullptr;
+        }
+
+        // allocated once per thread, only the first record pays for it
+        ring = new TRC_Ring;
+        ring->size = trcRingSize;
+        ring->head = 0;
+        ring->records = new TRC_Record[trcRingSize];
+        memset(ring->records, 0, sizeof(TRC_Record) * trcRingSize);
+
+        unsigned idx = trcRingCount.fetch_add(1, std::memory_order_acq_rel);
+        if (idx >= TRC_MAX_THREADS)
+        {
+            delete [] ring->records;
+            delete ring;
+            return nullptr;
+        }
+
+        ring->thread = uint8_t(idx);
+        trcRings[idx] = ring;
+        trcRing = ring;
+    }
+
+    // records are reused, no bytes of an older frame may end up in the dump
+    TRC_Record *rec = &ring->records[ring->head.load(std::memory_order_relaxed) & (ring->size - 1)];
+    memset(rec, 0, sizeof(*rec));
+    rec->timeUs = TRC_TimeUs();
+    rec->thread = ring->thread;
+    return rec;
+}
+
+static void TRC_Commit()
+{
+    trcRing->head.fetch_add(1, std::memory_order_release);
+}
+
+static void TRC_SetPayload(TRC_Record *rec, const QByteArray &asdu)
+{
+    rec->asduLength = uint16_t(asdu.size());
+    rec->payloadLength = uint8_t(std::min<int>(asdu.size(), TRC_PAYLOAD_SIZE));
+    memcpy(rec->payload, asdu.constData(), rec->payloadLength);
+}
+
+static void TRC_SetAddress(TRC_Record *rec, const deCONZ::Address &addr)
+{
+    rec->nwk = addr.hasNwk() ? addr.nwk() : (addr.hasGroup() ? addr.group() : 0xFFFF);
+    rec->ext = addr.hasExt() ? addr.ext() : 0;
+}
+
+static int TRC_WriteAll(int fd, const void *data, size_t len)
+{
+    const char *p = static_cast<const char*>(data);
+
+    while (len > 0)
+    {
+#ifdef _WIN32
+        const int n = _write(fd, p, unsigned(len));
+#else
+        const ssize_t n = write(fd, p, len);
+#endif
+        if (n <= 0)
+        {
+            return -1;
+        }
+        p += n;
+        len -= size_t(n);
+    }
+
+    return 0;
+}
+
+/*! Writes all rings to \p path.
+
+    Only uses async-signal-safe calls so it can run from a signal handler.
+    Records written while dumping might be torn, which is acceptable for diagnostics.
+ */
+int TRC_Dump(const char *path)
+{
+#ifdef _WIN32
+    const int fd = _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+    const int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    TRC_FileHeader hdr;
+    memcpy(hdr.magic, "DETRACE", 8);
+    hdr.version = TRC_FILE_VERSION;
+    hdr.recordSize = sizeof(TRC_Record);
+
+    int ret = TRC_WriteAll(fd, &hdr, sizeof(hdr));
+
+    const unsigned count = std::min<unsigned>(trcRingCount.load(std::memory_order_acquire), TRC_MAX_THREADS);
+
+    for (unsigned i = 0; ret == 0 && i < count; i++)
+    {
+        const TRC_Ring *ring = trcRings[i];
+        if (!ring)
+        {
+            continue;
+        }
+
+        const uint32_t head = ring->head.load(std::memory_order_acquire);
+        const uint32_t n = std::min(head, ring->size);
+        const uint32_t start = head - n;
+
+        // oldest first, in up to two chunks
+        const uint32_t first = start & (ring->size - 1);
+        const uint32_t chunk = std::min(n, ring->size - first);
+
+        ret = TRC_WriteAll(fd, &ring->records[first], chunk * sizeof(TRC_Record));
+        if (ret == 0 && chunk < n)
+        {
+            ret = TRC_WriteAll(fd, &ring->records[0], (n - chunk) * sizeof(TRC_Record));
+        }
+    }
+
+#ifdef _WIN32
+    _close(fd);
+#else
+    close(fd);
+#endif
+
+    return ret;
+}
+
+#ifdef PL_UNIX
+static const int trcSignals[] = { SIGUSR1, SIGSEGV, SIGBUS, SIGABRT };
+#define TRC_SIGNAL_COUNT (sizeof(trcSignals) / sizeof(trcSignals[0]))
+static struct sigaction trcPrevActions[TRC_SIGNAL_COUNT];
+static bool trcHandlersInstalled = false;
+
+/*! Passes \p signo to the handler which was installed before TRC_InstallHandlers(). */
+static void TRC_ChainSignal(int signo, siginfo_t *info, void *context)
+{
+    for (size_t i = 0; i < TRC_SIGNAL_COUNT; i++)
+    {
+        if (trcSignals[i] != signo)
+        {
+            continue;
+        }
+
+        const struct sigaction &prev = trcPrevActions[i];
+
+        if (signo != SIGUSR1)
+        {
+            sigaction(signo, &prev, nullptr);
+        }
+
+        if (prev.sa_flags & SA_SIGINFO)
+        {
+            if (prev.sa_sigaction)
+            {
+                prev.sa_sigaction(signo, info, context);
+            }
+        }
+        else if (prev.sa_handler != SIG_DFL && prev.sa_handler != SIG_IGN)
+        {
+            prev.sa_handler(signo);
+        }
+        else if (prev.sa_handler == SIG_DFL && signo != SIGUSR1)
+        {
+            raise(signo); // delivered with the default action after returning
+        }
+        break;
+    }
+}
+
+static void TRC_SignalDump(int signo, siginfo_t *info, void *context)
+{
+    TRC_Dump(trcDumpPath);
+    TRC_ChainSignal(signo, info, context);
+}
+
+static void TRC_CrashHandler(int signo, siginfo_t *info, void *context)
+{
+    if (trcRingCount.load(std::memory_order_acquire) > 0)
+    {
+        TRC_Dump(trcCrashPath);
+    }
+    TRC_ChainSignal(signo, info, context);
+}
+
+/*! Installs the dump and crash handlers once, previous handlers are kept and called afterwards. */
+static void TRC_InstallHandlers()
+{
+    if (trcHandlersInstalled)
+    {
+        return;
+    }
+
+    trcHandlersInstalled = true;
+
+    for (size_t i = 0; i < TRC_SIGNAL_COUNT; i++)
+    {
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sigemptyset(&sa.sa_mask);
+        sa.sa_flags = SA_SIGINFO;
+
+        if (trcSignals[i] == SIGUSR1)
+        {
+            sa.sa_sigaction = TRC_SignalDump;
+            sa.sa_flags |= SA_RESTART;
+        }
+        else
+        {
+            sa.sa_sigaction = TRC_CrashHandler;
+            sa.sa_flags |= SA_RESETHAND;
+        }
+
+        sigaction(trcSignals[i], &sa, &trcPrevActions[i]);
+    }
+}
+#endif
+
+/*! Setup of the recorder, a size of 0 disables tracing.
+
+    The trace is enabled at start via --aps-trace=1 and can be toggled at runtime by TRC_SetEnabled().
+    The SIGUSR1 and crash handlers are installed when tracing is enabled the first time.
+    \param recordsPerThread - ring size per thread, rounded up to a power of two
+ */
+void TRC_Init(unsigned recordsPerThread)
+{
+    unsigned size = 1;
+    while (size < recordsPerThread)
+    {
+        size <<= 1;
+    }
+
+    trcRingSize = recordsPerThread > 0 ? size : 0;
+
+    const QByteArray dataPath = deCONZ::getStorageLocation(deCONZ::ApplicationsDataLocation).toUtf8();
+    snprintf(trcDumpPath, sizeof(trcDumpPath), "%s/aps-trace.bin", dataPath.constData());
+    snprintf(trcCrashPath, sizeof(trcCrashPath), "%s/aps-trace-crash.bin", dataPath.constData());
+
+    TRC_SetEnabled(trcRingSize > 0 && deCONZ::appArgumentNumeric("--aps-trace", 0) > 0);
+}
+
+void TRC_SetEnabled(bool enabled)
+{
+    if (trcRingSize == 0)
+    {
+        enabled = false;
+    }
+
+#ifdef PL_UNIX
+    if (enabled)
+    {
+        TRC_InstallHandlers();
+    }
+#endif
+
+    if (trcEnabled.exchange(enabled) != enabled)
+    {
+        DBG_Printf(DBG_INFO, "APS trace %s, dump: %s\n", enabled ? "enabled" : "disabled", trcDumpPath);
+    }
+}
+
+void TRC_RecordApsRequest(const deCONZ::ApsDataRequest &req, uint8_t seq)
+{
+    if (!TRC_IsEnabled())
+    {
+        return;
+    }
+
+    TRC_Record *rec = TRC_Next();
+    if (!rec)
+    {
+        return;
+    }
+
+    rec->type = TRC_ApsRequest;
+    rec->direction = TRC_DirTx;
+    rec->seq = seq;
+    rec->apsId = req.id();
+    rec->status = 0;
+    rec->addrMode = uint8_t(req.dstAddressMode());
+    rec->srcEndpoint = req.srcEndpoint();
+    rec->dstEndpoint = req.dstEndpoint();
+    rec->profileId = req.profileId();
+    rec->clusterId = req.clusterId();
+    TRC_SetAddress(rec, req.dstAddress());
+    rec->lqi = 0;
+    rec->rssi = 0;
+    TRC_SetPayload(rec, req.asdu());
+    TRC_Commit();
+}
+
+void TRC_RecordApsRequestStatus(uint8_t apsId, uint8_t seq, uint8_t status)
+{
+    if (!TRC_IsEnabled())
+    {
+        return;
+    }
+
+    TRC_Record *rec = TRC_Next();
+    if (!rec)
+    {
+        return;
+    }
+
+    rec->type = TRC_ApsRequestStatus;
+    rec->direction = TRC_DirRx;
+    rec->seq = seq;
+    rec->apsId = apsId;
+    rec->status = status;
+    TRC_Commit();
+}
+
+void TRC_RecordApsConfirm(const deCONZ::ApsDataConfirm &conf, uint8_t seq, uint8_t status)
+{
+    if (!TRC_IsEnabled())
+    {
+        return;
+    }
+
+    TRC_Record *rec = TRC_Next();
+    if (!rec)
+    {
+        return;
+    }
+
+    rec->type = TRC_ApsConfirm;
+    rec->direction = TRC_DirRx;
+    rec->seq = seq;
+    rec->apsId = conf.id();
+    rec->status = status == 0 ? conf.status() : status;
+    rec->srcEndpoint = conf.srcEndpoint();
+    rec->dstEndpoint = conf.dstEndpoint();
+    TRC_SetAddress(rec, conf.dstAddress());
+    TRC_Commit();
+}
+
+void TRC_RecordApsIndication(const deCONZ::ApsDataIndication &ind, uint8_t seq)
+{
+    if (!TRC_IsEnabled())
+    {
+        return;
+    }
+
+    TRC_Record *rec = TRC_Next();
+    if (!rec)
+    {
+        return;
+    }
+
+    rec->type = TRC_ApsIndication;
+    rec->direction = TRC_DirRx;
+    rec->seq = seq;
+    rec->apsId = 0;
+    rec->status = 0;
+    rec->addrMode = uint8_t(ind.srcAddressMode());
+    rec->srcEndpoint = ind.srcEndpoint();
+    rec->dstEndpoint = ind.dstEndpoint();
+    rec->profileId = ind.profileId();
+    rec->clusterId = ind.clusterId();
+    TRC_SetAddress(rec, ind.srcAddress());
+    rec->lqi = ind.linkQuality();
+    rec->rssi = ind.rssi();
+    TRC_SetPayload(rec, ind.asdu());
+    TRC_Commit();
+}
+
+static const char *TRC_TypeToString(uint8_t type)
+{
+    switch (type)
+    {
+    case TRC_ApsRequest: return "APS-DATA.request";
+    case TRC_ApsRequestStatus: return "APS-DATA.request.status";
+    case TRC_ApsConfirm: return "APS-DATA.confirm";
+    case TRC_ApsIndication: return "APS-DATA.indication";
+    default:
+        break;
+    }
+
+    return "unknown";
+}
+
+/*! Converts a dump into <path>.json and <path>.pcap, records are sorted by time.
+
+    The pcap uses LINKTYPE_USER0 (147) with the raw 64 byte record as packet data.
+    \return 0 on success
+ */
+int TRC_Export(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "failed to open %s\n", path);
+        return -1;
+    }
+
+    TRC_FileHeader hdr;
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 || memcmp(hdr.magic, "DETRACE", 8) != 0 ||
+        hdr.version != TRC_FILE_VERSION || hdr.recordSize != sizeof(TRC_Record))
+    {
+        fprintf(stderr, "%s is not a supported trace file\n", path);
+        fclose(f);
+        return -2;
+    }
+
+    std::vector<TRC_Record> records;
+    TRC_Record rec;
+    while (fread(&rec, sizeof(rec), 1, f) == 1)
+    {
+        if (rec.type != 0) // skip unused slots
+        {
+            records.push_back(rec);
+        }
+    }
+    fclose(f);
+
+    std::stable_sort(records.begin(), records.end(), [](const TRC_Record &a, const TRC_Record &b) {
+        return a.timeUs < b.timeUs;
+    });
+
+    char outPath[600];
+    snprintf(outPath, sizeof(outPath), "%s.json", path);
+    FILE *json = fopen(outPath, "w");
+    snprintf(outPath, sizeof(outPath), "%s.pcap", path);
+    FILE *pcap = fopen(outPath, "wb");
+
+    if (!json || !pcap)
+    {
+        fprintf(stderr, "failed to create export files\n");
+        if (json) { fclose(json); }
+        if (pcap) { fclose(pcap); }
+        return -3;
+    }
+
+    const uint32_t pcapHeader[6] = { 0xa1b2c3d4, 0x00040002, 0, 0, 65535, 147 };
+    fwrite(pcapHeader, sizeof(pcapHeader), 1, pcap);
+
+    fprintf(json, "[\n");
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        const TRC_Record &r = records[i];
+
+        char payload[TRC_PAYLOAD_SIZE * 2 + 1];
+        for (unsigned j = 0; j < r.payloadLength && j < TRC_PAYLOAD_SIZE; j++)
+        {
+            snprintf(&payload[j * 2], 3, "%02x", r.payload[j]);
+        }
+        payload[std::min<unsigned>(r.payloadLength, TRC_PAYLOAD_SIZE) * 2] = '\0';
+
+        fprintf(json, "  {\"t\": %llu, \"thread\": %u, \"type\": \"%s\", \"dir\": \"%s\", \"seq\": %u, \"id\": %u, \"status\": %u, "
+                      "\"addrmode\": %u, \"nwk\": \"0x%04X\", \"ext\": \"0x%016llX\", \"ep\": [%u, %u], \"profile\": \"0x%04X\", "
+                      "\"cluster\": \"0x%04X\", \"lqi\": %u, \"rssi\": %d, \"len\": %u, \"payload\": \"%s\"}%s\n",
+                (unsigned long long)r.timeUs, r.thread, TRC_TypeToString(r.type), r.direction == TRC_DirTx ? "tx" : "rx",
+                r.seq, r.apsId, r.status, r.addrMode, r.nwk, (unsigned long long)r.ext, r.srcEndpoint, r.dstEndpoint,
+                r.profileId, r.clusterId, r.lqi, r.rssi, r.asduLength, payload, (i + 1) < records.size() ? "," : "");
+
+        const uint32_t pkt[4] = { uint32_t(r.timeUs / 1000000), uint32_t(r.timeUs % 1000000), sizeof(r), sizeof(r) };
+        fwrite(pkt, sizeof(pkt), 1, pcap);
+        fwrite(&r, sizeof(r), 1, pcap);
+    }
+    fprintf(json, "]\n");
+
+    fclose(json);
+    fclose(pcap);
+
+    fprintf(stdout, "exported %d records to %s.json and %s.pcap\n", int(records.size()), path, path);
+    return 0;
+}
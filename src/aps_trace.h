@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef APS_TRACE_H
+#define APS_TRACE_H
+
+#include <atomic>
+#include <stdint.h>
+
+/*
+ * Binary trace recorder for APS traffic.
+ *
+ * Each thread records into its own fixed size ring of compact records,
+ * no formatting and no allocations happen on the hot path. The rings can be
+ * dumped to disk on demand (SIGUSR1, debug view) and are dumped on crash.
+ * The signal handlers are only installed once tracing was enabled, they call
+ * the previously installed handlers afterwards.
+ * A dump is converted to JSON and pcap via: deCONZ --aps-trace-export=<file>
+ */
+
+namespace deCONZ {
+    class ApsDataRequest;
+    class ApsDataConfirm;
+    class ApsDataIndication;
+}
+
+enum TRC_RecordType
+{
+    TRC_ApsRequest = 1,
+    TRC_ApsRequestStatus = 2,
+    TRC_ApsConfirm = 3,
+    TRC_ApsIndication = 4
+};
+
+enum TRC_Direction
+{
+    TRC_DirTx = 0,
+    TRC_DirRx = 1
+};
+
+#define TRC_PAYLOAD_SIZE 28
+
+/*! A trace record, 64 bytes written as is to the dump file (little endian). */
+struct TRC_Record
+{
+    uint64_t timeUs; // steady clock
+    uint8_t type; // TRC_RecordType
+    uint8_t direction; // TRC_Direction
+    uint8_t seq; // serial protocol sequence number
+    uint8_t apsId;
+    uint8_t status;
+    uint8_t addrMode;
+    uint8_t srcEndpoint;
+    uint8_t dstEndpoint;
+    uint16_t profileId;
+    uint16_t clusterId;
+    uint16_t nwk;
+    uint16_t asduLength; // full length, payload might be truncated
+    uint64_t ext;
+    uint8_t lqi;
+    int8_t rssi;
+    uint8_t payloadLength;
+    uint8_t thread;
+    uint8_t payload[TRC_PAYLOAD_SIZE];
+};
+
+static_assert (sizeof(TRC_Record) == 64, "unexpected TRC_Record size");
+
+extern std::atomic<bool> trcEnabled;
+
+void TRC_Init(unsigned recordsPerThread);
+void TRC_SetEnabled(bool enabled);
+inline bool TRC_IsEnabled() { return trcEnabled.load(std::memory_order_relaxed); }
+
+void TRC_RecordApsRequest(const deCONZ::ApsDataRequest &req, uint8_t seq);
+void TRC_RecordApsRequestStatus(uint8_t apsId, uint8_t seq, uint8_t status);
+void TRC_RecordApsConfirm(const deCONZ::ApsDataConfirm &conf, uint8_t seq, uint8_t status);
+void TRC_RecordApsIndication(const deCONZ::ApsDataIndication &ind, uint8_t seq);
+
+int TRC_Dump(const char *path);
+int TRC_Export(const char *path);
+
+#endif // APS_TRACE_H
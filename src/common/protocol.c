@@ -78,6 +78,7 @@ typedef struct stProtocol_s
  */
 static unsigned char bInit = 0;
 static tProtocol arDevices[PROTO_MAX_DEV];
+static unsigned long u32CrcErrors = 0;
 
 /*
  * Local prototypes
@@ -298,6 +299,20 @@ void protocol_receive(unsigned char u8Instance)
    }
 }
 
+/*****************************************************************************/
+/**
+  * number of received frames dropped due a crc mismatch
+  *
+  *
+  * @param         void
+  * @return        unsigned long      the error count since start
+  *
+  *****************************************************************************/
+unsigned long protocol_crc_errors(void)
+{
+   return u32CrcErrors;
+}
+
 /*****************************************************************************/
 /**
   * receive a binary data packet - use escape technique and check the crc
@@ -350,6 +365,10 @@ static void protocol_receive_flagged(tProtocol* pDev)
                         pDev->pPacket(&pDev->pBuffer[0], (unsigned short)(pDev->u16BufferPos - 2));
                     }
                 }
+                else
+                {
+                    u32CrcErrors++;
+                }
             }
 
             pDev->u16BufferPos = 0;
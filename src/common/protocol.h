@@ -51,6 +51,7 @@ unsigned char protocol_remove(unsigned char u8Instance);
 unsigned char protocol_set_buffer(unsigned char u8Instance, unsigned char* pBuffer, unsigned short u16Len);
 void protocol_send(unsigned char u8Instance, unsigned char* pData, unsigned short u16Len);
 void protocol_receive(unsigned char u8Instance);
+unsigned long protocol_crc_errors(void);
 
 
 #ifdef __cplusplus
@@ -22,10 +22,13 @@
 #include <deconz/u_sstream.h>
 #include <deconz/node_event.h>
 
+#include "zm_app.h"
 #include "zm_node_model.h"
 #include "zm_controller.h"
 #include "db_nodes.h"
 #include "db_json_nodes.h"
+#include "event_monitor.h"
+#include "metrics.h"
 
 static sqlite3 *db = nullptr;
 
@@ -227,7 +230,6 @@ static NodeInfo DB_CreateNodeInfo(const DB_Node &dbNode, int nodeId)
 
     node.id = static_cast<quint32>(nodeId);
     node.data = new deCONZ::zmNode(dbNode.nodeDescriptor.macCapabilities());
-    node.g = new zmgNode(node.data, nullptr);
 
     node.data->setNodeDescriptor(dbNode.nodeDescriptor);
     node.data->setFetched(deCONZ::ReqNodeDescriptor, true);
@@ -239,23 +241,26 @@ static NodeInfo DB_CreateNodeInfo(const DB_Node &dbNode, int nodeId)
         addr.setNwk(static_cast<quint16>(dbNode.nwkAddr));
 
     node.data->setAddress(addr);
-    node.g->setAddress(addr.nwk(), addr.ext());
 
-    QPointF p;
-    p.setX(dbNode.sceneX);
-    p.setY(dbNode.sceneY);
-    node.g->setDeviceType(node.data->deviceType());
-    node.g->setPos(p);
-    node.g->show();
+    node.pos.setX(dbNode.sceneX);
+    node.pos.setY(dbNode.sceneY);
 
     for (const auto &sd : dbNode.simpleDescriptors)
     {
         DBG_Assert(sd.isValid());
-
         node.data->setSimpleDescriptor(sd);
+    }
+
+    if (!gHeadlessVersion)
+    {
+        node.g = new zmgNode(node.data, nullptr);
+        node.g->setAddress(addr.nwk(), addr.ext());
+        node.g->setDeviceType(node.data->deviceType());
+        node.g->setPos(node.pos);
+        node.g->show();
         node.g->updated(deCONZ::ReqSimpleDescriptor);
+        node.g->requestUpdate();
     }
-    node.g->requestUpdate();
 
     CoreNode_NotifyDeviceChanged(node.data->address().ext(), "");
 
@@ -425,7 +430,7 @@ void zmController::loadNodesFromDb()
         auto node = DB_CreateNodeInfo(dbNode, m_nodes.size() + 1);
         Q_ASSERT(node.data);
 
-        if (!node.g->scene())
+        if (node.g && !node.g->scene())
         {
             m_scene->addItem(node.g);
         }
@@ -448,11 +453,12 @@ void zmController::loadNodesFromDb()
 
         deCONZ::nodeModel()->addNode(dbNode.extAddr, dbNode.nwkAddr);
         m_nodes.push_back(node);
+        scheduleNodeDiscovery(&m_nodes.back());
     }
 
     for (auto &node : m_nodes)
     {
-        if (!node.data || !node.g)
+        if (!node.data)
             continue;
 
         emit nodeEvent({deCONZ::NodeEvent::NodeAdded, node.data});
@@ -479,6 +485,7 @@ void zmController::loadNodesFromDb()
 
 void zmController::saveNodesState()
 {
+    EVM_Scope evm("zmController::saveNodesState");
     if (m_saveNodesChanges == 0)
     {
         return;
@@ -511,6 +518,9 @@ void zmController::saveNodesState()
         return;
     }
 
+    QElapsedTimer t;
+    t.start();
+
     rc = sqlite3_exec(db, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
     DBG_Assert(rc == SQLITE_OK);
 
@@ -532,11 +542,13 @@ void zmController::saveNodesState()
         if (rc != SQLITE_OK) // previous command must succeed
             break;
 
-        if (!node.g || !node.data)
+        if (!node.data)
             continue;
 
-        if (node.g->needSaveToDatabase())
+        // in headless mode there is no zmgNode, the position is kept in NodeInfo
+        if (node.g ? node.g->needSaveToDatabase() : node.needSaveToDatabase)
         {
+            const QPointF pos = node.g ? node.g->pos() : node.pos;
             char mac[23 + 1];
             generateUniqueId2(node.data->address().ext(), mac, sizeof(mac));
             assert(mac[23] == '\0');
@@ -545,13 +557,13 @@ void zmController::saveNodesState()
 
             if (rc == SQLITE_OK)
             {
-                rc = sqlite3_bind_double(stmt, 1, node.g->pos().x());
+                rc = sqlite3_bind_double(stmt, 1, pos.x());
                 DBG_Assert(rc == SQLITE_OK);
             }
 
             if (rc == SQLITE_OK)
             {
-                rc = sqlite3_bind_double(stmt, 2, node.g->pos().y());
+                rc = sqlite3_bind_double(stmt, 2, pos.y());
                 DBG_Assert(rc == SQLITE_OK);
             }
 
@@ -585,7 +597,10 @@ void zmController::saveNodesState()
             if (rc != SQLITE_OK)
                 break;
 
-            node.g->setNeedSaveToDatabase(false);
+            if (node.g)
+                node.g->setNeedSaveToDatabase(false);
+            else
+                node.needSaveToDatabase = false;
         }
     }
 
@@ -601,8 +616,7 @@ void zmController::saveNodesState()
 
     closeDb();
 
-    QElapsedTimer t;
-    t.start();
+    MET_Observe(MET_DbWriteTime, uint64_t(t.nsecsElapsed() / 1000));
 
     m_saveNodesChanges = 0;
 
@@ -705,7 +719,9 @@ bool DB_StoreConfigValue(const char *key, const QVariant &value)
     U_sstream_put_str(&ss, "' ");
     U_sstream_put_str(&ss, "WHERE (SELECT changes() = 0);");
 
+    const uint64_t startUs = MET_TimeUs();
     rc = sqlite3_exec(db, sql, nullptr, nullptr, &errmsg);
+    MET_Observe(MET_DbWriteTime, MET_TimeUs() - startUs);
 
     if (rc != SQLITE_OK)
     {
@@ -8,20 +8,130 @@
  *
  */
 
+#include <atomic>
 #include <QCheckBox>
+#include <QPushButton>
 #include <QTimer>
-#include <QThread>
+#include <QTimerEvent>
 #include <QSpacerItem>
 #include <QVariant>
 #include "deconz/dbg_trace.h"
+#include "deconz/util.h"
+#include "aps_trace.h"
 #include "debug_view.h"
 #include "ui_debug_view.h"
 
+/*
+ * Log records are pushed by any thread into a bounded lock-free ring
+ * (multi producer, single consumer) and drained by the GUI thread in batches.
+ * Producers never block: if the ring is full the record is dropped and counted.
+ */
+
+namespace {
+    constexpr unsigned LogRingSize = 1024; // power of two
+    constexpr unsigned LogRecordSize = 480; // incl. '\0'
+    constexpr int LogDrainIntervalMs = 100;
+    constexpr int LogDrainMaxBatch = 512;
+
+    struct LogRecord
+    {
+        std::atomic<unsigned> seq;
+        int level;
+        char text[LogRecordSize];
+    };
+
+    struct LogRing
+    {
+        LogRing()
+        {
+            for (unsigned i = 0; i < LogRingSize; i++)
+            {
+                records[i].seq.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        std::atomic<unsigned> enqPos{0};
+        unsigned deqPos = 0; // GUI thread only
+        std::atomic<unsigned> dropped{0};
+        std::atomic<bool> accept{false}; // view is visible, see DebugView::showEvent()
+        LogRecord records[LogRingSize];
+    };
+
+    LogRing logRing;
+}
+
 DebugView *_dbgView = nullptr;
 
+/*! Copies \p msg into a free ring slot, callable from any thread. */
+static bool LOG_Push(int level, const char *msg)
+{
+    LogRing &r = logRing;
+    LogRecord *rec;
+    unsigned pos = r.enqPos.load(std::memory_order_relaxed);
+
+    for (;;)
+    {
+        rec = &r.records[pos & (LogRingSize - 1)];
+        const unsigned seq = rec->seq.load(std::memory_order_acquire);
+        const int diff = int(seq - pos);
+
+        if (diff == 0)
+        {
+            if (r.enqPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0) // full
+        {
+            r.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = r.enqPos.load(std::memory_order_relaxed);
+        }
+    }
+
+    unsigned i = 0;
+    for (; msg[i] && i < LogRecordSize - 1; i++)
+    {
+        rec->text[i] = msg[i];
+    }
+
+    // strip trailing newlines, each record is one block in the view
+    while (i > 0 && rec->text[i - 1] == '\n')
+    {
+        i--;
+    }
+
+    rec->text[i] = '\0';
+    rec->level = level;
+    rec->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+/*! Takes the oldest record out of the ring, GUI thread only. */
+static const LogRecord *LOG_Front()
+{
+    LogRecord *rec = &logRing.records[logRing.deqPos & (LogRingSize - 1)];
+    if (rec->seq.load(std::memory_order_acquire) != logRing.deqPos + 1)
+    {
+        return nullptr;
+    }
+    return rec;
+}
+
+static void LOG_PopFront(const LogRecord *rec)
+{
+    const_cast<LogRecord*>(rec)->seq.store(logRing.deqPos + LogRingSize, std::memory_order_release);
+    logRing.deqPos++;
+}
+
 static void dbgCallback(int level, const char *msg)
 {
-    if (_dbgView)
+    // filter before copying anything, a hidden view costs only this check
+    if (_dbgView && logRing.accept.load(std::memory_order_relaxed) && DBG_IsEnabled(level))
     {
         _dbgView->log(level, msg);
     }
@@ -62,6 +172,23 @@ DebugView::DebugView(QWidget *parent) :
         chk->setChecked(DBG_IsEnabled(level));
     }
 
+    {
+        QCheckBox *chk = new QCheckBox(QLatin1String("APS trace"), ui->dbgItems);
+        chk->setChecked(TRC_IsEnabled());
+        ui->dbgItems->layout()->addWidget(chk);
+        connect(chk, &QCheckBox::toggled, this, [](bool checked) { TRC_SetEnabled(checked); });
+
+        QPushButton *dump = new QPushButton(tr("Dump trace"), ui->dbgItems);
+        ui->dbgItems->layout()->addWidget(dump);
+        connect(dump, &QPushButton::clicked, this, []() {
+            const QString path = deCONZ::getStorageLocation(deCONZ::ApplicationsDataLocation) + QLatin1String("/aps-trace.bin");
+            if (TRC_Dump(qPrintable(path)) == 0)
+            {
+                DBG_Printf(DBG_INFO, "APS trace written to %s\n", qPrintable(path));
+            }
+        });
+    }
+
     QSpacerItem *spacer = new QSpacerItem(24,24, QSizePolicy::Minimum, QSizePolicy::Expanding);
     setProperty("theme.bgrole", QPalette::Mid);
     ui->dbgItems->layout()->addItem(spacer);
@@ -76,29 +203,83 @@ DebugView::~DebugView()
     delete ui;
 }
 
+/*! Queues a log message, this is non-blocking and can be called from any thread. */
 void DebugView::log(int level, const char *msg)
 {
-    Q_UNUSED(level)
+    if (msg)
+    {
+        LOG_Push(level, msg);
+    }
+}
 
-    if (_dbgView->thread() == QThread::currentThread())
+/*! Starts collecting log records, messages logged while the view is hidden are not shown. */
+void DebugView::showEvent(QShowEvent *event)
+{
+    logRing.accept.store(true, std::memory_order_relaxed);
+
+    if (m_drainTimer == 0)
     {
-#ifdef ARCH_ARM
-        if (!isVisible())
-        {
-            return;
-        }
-#endif
+        m_drainTimer = startTimer(LogDrainIntervalMs);
+    }
+
+    QDialog::showEvent(event);
+}
+
+void DebugView::hideEvent(QHideEvent *event)
+{
+    logRing.accept.store(false, std::memory_order_relaxed);
+
+    if (m_drainTimer != 0)
+    {
+        killTimer(m_drainTimer);
+        m_drainTimer = 0;
+    }
+
+    drainLog(); // release records of the last interval
 
-        QString text(msg);
-        while (text.endsWith('\n'))
+    QDialog::hideEvent(event);
+}
+
+void DebugView::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() == m_drainTimer)
+    {
+        drainLog();
+    }
+    else
+    {
+        QDialog::timerEvent(event);
+    }
+}
+
+/*! Appends queued log records in one batch to the view. */
+void DebugView::drainLog()
+{
+    QString text;
+    int count = 0;
+
+    for (const LogRecord *rec = LOG_Front(); rec && count < LogDrainMaxBatch; rec = LOG_Front())
+    {
+        if (count > 0)
         {
-            text.chop(1);
+            text += QLatin1Char('\n');
         }
-        ui->log->appendPlainText(text);
+        text += QString::fromUtf8(rec->text);
+        LOG_PopFront(rec);
+        count++;
     }
-    else
+
+    const unsigned dropped = logRing.dropped.exchange(0, std::memory_order_relaxed);
+
+    if (dropped > 0)
     {
-        // discard message from other threads, todo
+        text += QString("%1(%2 log messages dropped)").arg(count > 0 ? "\n" : "").arg(dropped);
+        count++;
+    }
+
+    if (count > 0)
+    {
+        ui->log->appendPlainText(text);
     }
 }
 
@@ -27,12 +27,21 @@ public:
 
     void log(int level, const char *msg);
 
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+    void timerEvent(QTimerEvent *event) override;
+
 private Q_SLOTS:
     void checkboxStateChanged(int state);
     void init();
 
+private:
+    void drainLog();
+
 private:
     Ui::DebugView *ui;
+    int m_drainTimer = 0;
 };
 
 #endif // DEBUG_VIEW_H
@@ -0,0 +1,288 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <signal.h>
+#include "deconz/dbg_trace.h"
+#include "deconz/u_platform.h"
+#include "event_monitor.h"
+#include "metrics.h"
+
+#if defined(PL_LINUX) && defined(__GLIBC__)
+  #include <execinfo.h>
+  #include <pthread.h>
+  #include <unistd.h>
+  #define EVM_HAS_BACKTRACE
+#endif
+
+#define EVM_MAX_HANDLERS 32
+#define EVM_CHECK_INTERVAL_MS 50
+#define EVM_STATS_INTERVAL_US (60 * 1000000ULL)
+#define EVM_BACKTRACE_DEPTH 32
+
+/*! Per handler statistics, only accessed by the main thread. */
+struct EVM_HandlerStats
+{
+    const char *handler;
+    uint32_t count;
+    uint32_t slow; // above threshold
+    uint64_t totalUs;
+    uint64_t maxUs;
+};
+
+static std::atomic<const char*> evmHandler{nullptr};
+static std::atomic<uint64_t> evmHandlerStartUs{0};
+static std::atomic<uint64_t> evmHeartbeatUs{0};
+static uint64_t evmThresholdUs = 0;
+static uint64_t evmStatsTimeUs = 0;
+static EVM_HandlerStats evmStats[EVM_MAX_HANDLERS];
+
+static std::thread evmThread;
+static std::mutex evmMutex;
+static std::condition_variable evmCondition;
+static bool evmRunning = false;
+
+#ifdef EVM_HAS_BACKTRACE
+static bool evmBacktrace = false;
+static pthread_t evmMainThread;
+
+static void EVM_BacktraceHandler(int)
+{
+    void *frames[EVM_BACKTRACE_DEPTH];
+    const int n = backtrace(frames, EVM_BACKTRACE_DEPTH);
+    backtrace_symbols_fd(frames, n, STDERR_FILENO);
+}
+#endif
+
+static EVM_HandlerStats *EVM_GetStats(const char *handler)
+{
+    for (EVM_HandlerStats &s : evmStats)
+    {
+        if (s.handler == handler)
+        {
+            return &s;
+        }
+
+        if (!s.handler)
+        {
+            s.handler = handler;
+            return &s;
+        }
+    }
+
+    return nullptr;
+}
+
+/*! Reports a stall once per missed heartbeat while the main thread is still blocked. */
+static void EVM_ThreadFunc()
+{
+    uint64_t reportedBeat = 0;
+    std::unique_lock<std::mutex> lock(evmMutex);
+
+    while (evmRunning)
+    {
+        evmCondition.wait_for(lock, std::chrono::milliseconds(EVM_CHECK_INTERVAL_MS));
+
+        const uint64_t beat = evmHeartbeatUs.load(std::memory_order_acquire);
+        const uint64_t now = MET_TimeUs();
+
+        if (!evmRunning || beat == 0 || beat == reportedBeat || now - beat < evmThresholdUs)
+        {
+            continue;
+        }
+
+        reportedBeat = beat;
+        MET_Inc(MET_EventLoopStalls);
+
+        const char *handler = evmHandler.load(std::memory_order_acquire);
+        if (handler)
+        {
+            const uint64_t running = now - evmHandlerStartUs.load(std::memory_order_relaxed);
+            DBG_Printf(DBG_INFO, "EVM main loop stalled for %u ms in %s (running %u ms)\n",
+                       unsigned((now - beat) / 1000), handler, unsigned(running / 1000));
+        }
+        else
+        {
+            DBG_Printf(DBG_INFO, "EVM main loop stalled for %u ms outside of monitored handlers\n", unsigned((now - beat) / 1000));
+        }
+
+#ifdef EVM_HAS_BACKTRACE
+        if (evmBacktrace)
+        {
+            pthread_kill(evmMainThread, SIGUSR2);
+        }
+#endif
+    }
+}
+
+static void EVM_PrintStats()
+{
+    DBG_Printf(DBG_MEASURE, "EVM handler p50: %u us, p99: %u us, tick lag p99: %u us, stalls: %u\n",
+               unsigned(MET_Percentile(MET_HandlerDuration, 50)),
+               unsigned(MET_Percentile(MET_HandlerDuration, 99)),
+               unsigned(MET_Percentile(MET_TickLag, 99)),
+               unsigned(MET_Value(MET_EventLoopStalls)));
+
+    for (const EVM_HandlerStats &s : evmStats)
+    {
+        if (!s.handler)
+        {
+            break;
+        }
+
+        if (s.count > 0)
+        {
+            DBG_Printf(DBG_MEASURE, "EVM   %s count: %u, avg: %u us, max: %u us, slow: %u\n",
+                       s.handler, s.count, unsigned(s.totalUs / s.count), unsigned(s.maxUs), s.slow);
+        }
+    }
+}
+
+/*! Starts the monitor thread, must be called from the main thread.
+
+    \param thresholdMs - handlers and stalls above this duration are reported, 0 disables the monitor
+    \param withBacktrace - print a backtrace of the main thread on stalls
+ */
+void EVM_Init(unsigned thresholdMs, bool withBacktrace)
+{
+    if (evmRunning || thresholdMs == 0)
+    {
+        return;
+    }
+
+    evmThresholdUs = uint64_t(thresholdMs) * 1000;
+
+#ifdef EVM_HAS_BACKTRACE
+    evmBacktrace = withBacktrace;
+    evmMainThread = pthread_self();
+
+    if (evmBacktrace)
+    {
+        // first call loads libgcc, don't do this in the signal handler
+        void *frame;
+        backtrace(&frame, 1);
+
+        // restart interrupted syscalls of the main thread
+        struct sigaction sa = {};
+        sa.sa_handler = EVM_BacktraceHandler;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGUSR2, &sa, nullptr);
+    }
+#else
+    (void)withBacktrace;
+#endif
+
+    evmRunning = true;
+    evmThread = std::thread(EVM_ThreadFunc);
+}
+
+void EVM_Exit()
+{
+    if (!evmRunning)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(evmMutex);
+        evmRunning = false;
+    }
+
+    evmCondition.notify_one();
+    evmThread.join();
+}
+
+/*! Stops stall detection until the next EVM_Heartbeat().
+
+    Called when the main loop exits, e.g. on APP_RET_RESTART_APP, so the
+    time to set up the application again isn't reported as stall.
+ */
+void EVM_Reset()
+{
+    evmHeartbeatUs.store(0, std::memory_order_release);
+}
+
+/*! Called by the main loop tick, a missing heartbeat is detected as stall. */
+void EVM_Heartbeat()
+{
+    const uint64_t now = MET_TimeUs();
+    evmHeartbeatUs.store(now, std::memory_order_release);
+
+    if (evmStatsTimeUs == 0)
+    {
+        evmStatsTimeUs = now;
+    }
+    else if (now - evmStatsTimeUs > EVM_STATS_INTERVAL_US)
+    {
+        evmStatsTimeUs = now;
+
+        if (DBG_IsEnabled(DBG_MEASURE))
+        {
+            EVM_PrintStats();
+        }
+
+        for (EVM_HandlerStats &s : evmStats)
+        {
+            s.count = 0;
+            s.slow = 0;
+            s.totalUs = 0;
+            s.maxUs = 0;
+        }
+    }
+}
+
+EVM_Scope::EVM_Scope(const char *handler) :
+    m_handler(handler),
+    m_prevHandler(evmHandler.load(std::memory_order_relaxed)),
+    m_startUs(MET_TimeUs()),
+    m_prevStartUs(evmHandlerStartUs.load(std::memory_order_relaxed))
+{
+    evmHandlerStartUs.store(m_startUs, std::memory_order_relaxed);
+    evmHandler.store(handler, std::memory_order_release);
+}
+
+EVM_Scope::~EVM_Scope()
+{
+    const uint64_t dt = MET_TimeUs() - m_startUs;
+
+    evmHandlerStartUs.store(m_prevStartUs, std::memory_order_relaxed);
+    evmHandler.store(m_prevHandler, std::memory_order_release);
+
+    // nested scopes are part of the outer duration, observe only top level handlers
+    if (!m_prevHandler)
+    {
+        MET_Observe(MET_HandlerDuration, dt);
+    }
+
+    EVM_HandlerStats *s = EVM_GetStats(m_handler);
+    if (s)
+    {
+        s->count++;
+        s->totalUs += dt;
+        if (dt > s->maxUs)
+        {
+            s->maxUs = dt;
+        }
+    }
+
+    if (evmThresholdUs > 0 && dt >= evmThresholdUs)
+    {
+        if (s)
+        {
+            s->slow++;
+        }
+        DBG_Printf(DBG_INFO, "EVM %s took %u ms\n", m_handler, unsigned(dt / 1000));
+    }
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef EVENT_MONITOR_H
+#define EVENT_MONITOR_H
+
+#include <stdint.h>
+
+/*
+ * Main event loop stall detector.
+ *
+ * Timer events and slots of the main thread are wrapped in an EVM_Scope
+ * which tracks the running handler and its duration. A monitor thread checks
+ * the heartbeat of the main loop and reports stalls while they happen,
+ * optionally with a backtrace of the main thread (Linux only).
+ *
+ * Options: --stall-threshold=<ms> (default 300, 0 disables the monitor)
+ *          --stall-backtrace=1 (for debugging, signals the main thread)
+ */
+
+void EVM_Init(unsigned thresholdMs, bool withBacktrace);
+void EVM_Exit();
+void EVM_Heartbeat();
+void EVM_Reset();
+
+/*! Marks a handler invocation in the main thread, scopes can be nested.
+
+    The per handler statistics include the time of nested scopes, the
+    handler duration histogram only counts the outermost scope.
+ */
+class EVM_Scope
+{
+public:
+    explicit EVM_Scope(const char *handler);
+    ~EVM_Scope();
+
+private:
+    const char *m_handler;
+    const char *m_prevHandler;
+    uint64_t m_startUs;
+    uint64_t m_prevStartUs;
+};
+
+#endif // EVENT_MONITOR_H
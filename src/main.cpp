@@ -20,6 +20,10 @@
 #include "deconz/dbg_trace.h"
 #include "deconz/util.h"
 #include "deconz/zcl.h"
+#include "aps_trace.h"
+#include "event_monitor.h"
+#include "phy_sniffer.h"
+#include "serial_capture.h"
 #include "zm_app.h"
 #include "mainwindow.h"
 
@@ -63,15 +67,27 @@ int main(int argc, char *argv[])
     }
 #endif
 
-    // detect if we run with -platform minimal (headless)
+    bool hasPlatformArg = false;
+
+    // detect if we run with -platform minimal or --headless
     for (int i = 0; i < argc; i++)
     {
-        if (strcmp(argv[i], "-platform") == 0 &&
-            argc > (i + 1) &&
-            strcmp(argv[i + 1], "minimal") == 0)
+        if (strcmp(argv[i], "-platform") == 0)
+        {
+            hasPlatformArg = true;
+            if (argc > (i + 1) && strcmp(argv[i + 1], "minimal") == 0)
+            {
+                gHeadlessVersion = true;
+            }
+        }
+        else if (strcmp(argv[i], "--headless") == 0 || strcmp(argv[i], "--headless=1") == 0)
         {
             gHeadlessVersion = true;
-            break;
+        }
+        else if (strncmp(argv[i], "--aps-trace-export=", 19) == 0)
+        {
+            // offline conversion of a trace dump, no application needed
+            return TRC_Export(argv[i] + 19) == 0 ? 0 : 1;
         }
     }
 
@@ -86,6 +102,13 @@ int main(int argc, char *argv[])
         args.push_back(argv[i]);
     }
 
+    // --headless doesn't need a display, node graphics aren't created
+    if (gHeadlessVersion && !hasPlatformArg)
+    {
+        args.push_back("-platform");
+        args.push_back("minimal");
+    }
+
     bool pidInitialised = false;
     int exitCode = 0;
 
@@ -273,6 +296,11 @@ int main(int argc, char *argv[])
 
         a.setApplicationVersion(QString("v%1.%2.%3%4").arg(APP_VERSION_MAJOR).arg(APP_VERSION_MINOR).arg(APP_VERSION_BUGFIX).arg(APP_CHANNEL));
 
+        TRC_Init(unsigned(deCONZ::appArgumentNumeric("--aps-trace-size", 4096)));
+        EVM_Init(unsigned(deCONZ::appArgumentNumeric("--stall-threshold", 300)), deCONZ::appArgumentNumeric("--stall-backtrace", 0) > 0);
+        SNF_Init(unsigned(deCONZ::appArgumentNumeric("--zep-port", 0)), unsigned(deCONZ::appArgumentNumeric("--phy-pcap", 0)));
+        CAP_Init(deCONZ::appArgumentNumeric("--serial-capture", 0) > 0);
+
         {
             QString dataLocation = deCONZ::getStorageLocation(deCONZ::ApplicationsLocation);
 
@@ -308,9 +336,22 @@ int main(int argc, char *argv[])
 
         MainWindow w;
         w.show();
+
+        const QString replayPath = deCONZ::appArgumentString("--serial-replay", "");
+        if (!replayPath.isEmpty())
+        {
+            CAP_StartReplay(qPrintable(replayPath), unsigned(deCONZ::appArgumentNumeric("--replay-speed", 1)),
+                            deCONZ::appArgumentNumeric("--replay-exit", 0) > 0);
+        }
+
         exitCode = a.exec();
+        EVM_Reset();
+        CAP_ResetReplay();
     } while (exitCode == APP_RET_RESTART_APP);
 
+    EVM_Exit();
+    SNF_Exit();
+    CAP_Exit();
     DBG_Destroy();
 
     return exitCode;
@@ -42,6 +42,7 @@
 #include "gui/actor_vfs_view.h"
 #include "gui/theme.h"
 #include "actor_vfs_model.h"
+#include "event_monitor.h"
 #include "mainwindow.h"
 #include "source_route_info.h"
 #include "zm_app.h"
@@ -1039,6 +1040,7 @@ void MainWindow::onDeviceStateTimeout()
 
 void MainWindow::timerEvent(QTimerEvent *event)
 {
+    EVM_Scope evm("MainWindow::timerEvent");
     if (event->timerId() == m_fetchTimer)
     {
         if (!m_controller)
@@ -2057,6 +2059,11 @@ void MainWindow::createViewMenu()
     m_darkThemeAction = menu->addAction(tr("Dark theme"));
     m_darkThemeAction->setData("dark");
     connect(m_darkThemeAction, &QAction::triggered, this, &MainWindow::switchTheme);
+
+    menu->addSeparator();
+
+    QAction *autoLayout = menu->addAction(tr("Auto layout nodes"));
+    connect(autoLayout, &QAction::triggered, ui->graphicsView, &zmGraphicsView::startAutoLayout);
 }
 
 void MainWindow::showAboutDialog()
@@ -2405,7 +2412,7 @@ void MainWindow::editDDFActionTriggered()
         if (node && node->data())
         {
             deCONZ::NodeEvent event(deCONZ::NodeEvent::EditDeviceDDF, node->data());
-            emit deCONZ::controller()->nodeEvent(event);
+            deCONZ::controller()->dispatchNodeEvent(event);
         }
     }
 }
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <chrono>
+#include <stdio.h>
+#include "metrics.h"
+
+#define MET_PREFIX "deconz_"
+// exported bucket bounds 2^6 µs .. 2^25 µs (64 µs .. 33.5 s)
+#define MET_EXPORT_MIN_POW2 6
+#define MET_EXPORT_MAX_POW2 25
+
+enum MET_Type
+{
+    MET_TypeCounter,
+    MET_TypeGauge
+};
+
+struct MET_Descriptor
+{
+    const char *name;
+    const char *help;
+    MET_Type type;
+};
+
+static const MET_Descriptor metDescriptors[MET_IdCount] = {
+    { "aps_frames_rx_total", "APS frames received", MET_TypeCounter },
+    { "aps_frames_tx_total", "APS frames sent successfully", MET_TypeCounter },
+    { "aps_confirms_total", "APS-DATA.confirm received", MET_TypeCounter },
+    { "aps_no_ack_total", "APS-DATA.confirm with APS NO_ACK status", MET_TypeCounter },
+    { "mac_no_ack_total", "APS-DATA.confirm with MAC NO_ACK status", MET_TypeCounter },
+    { "aps_busy_status_total", "APS-DATA.request rejected by firmware with BUSY", MET_TypeCounter },
+    { "serial_rx_bytes_total", "Bytes read from the serial port", MET_TypeCounter },
+    { "serial_tx_bytes_total", "Bytes written to the serial port", MET_TypeCounter },
+    { "serial_rx_frames_total", "Serial protocol frames received", MET_TypeCounter },
+    { "serial_tx_frames_total", "Serial protocol frames sent", MET_TypeCounter },
+    { "serial_crc_errors_total", "Serial protocol frames dropped due CRC errors", MET_TypeCounter },
+    { "serial_tx_writes_total", "Writes to the serial port, frames sent together share one", MET_TypeCounter },
+    { "serial_status_coalesced_total", "Status requests skipped because a queued APS request returns the status", MET_TypeCounter },
+    { "serial_status_requests_total", "ZM_CMD_STATUS requests sent to poll the firmware", MET_TypeCounter },
+    { "serial_status_push_total", "Unsolicited status change frames received", MET_TypeCounter },
+    { "event_loop_stalls_total", "Main loop stalls detected by the event monitor", MET_TypeCounter },
+    { "vfs_read_requests_total", "Core VFS read entry requests, a batch counts once", MET_TypeCounter },
+    { "vfs_read_entries_total", "Core VFS entries read", MET_TypeCounter },
+    { "vfs_notify_sent_total", "Core VFS change notifications sent", MET_TypeCounter },
+    { "vfs_notify_coalesced_total", "Core VFS change notifications merged into a pending one", MET_TypeCounter },
+    { "vfs_not_modified_total", "Core VFS conditional reads answered without value", MET_TypeCounter },
+    { "phy_frames_total", "PHY frames queued for ZEP/pcapng output", MET_TypeCounter },
+    { "phy_frames_dropped_total", "PHY frames dropped because the sniffer output was busy", MET_TypeCounter },
+    { "aps_queue_depth", "APS requests in queue", MET_TypeGauge },
+    { "aps_requests_busy", "APS requests sent but not confirmed", MET_TypeGauge },
+    { "qitems_wait_send", "Serial commands waiting to be sent", MET_TypeGauge },
+    { "qitems_wait_confirm", "Serial commands waiting for a response", MET_TypeGauge },
+    { "serial_baudrate", "Baud rate of the serial link", MET_TypeGauge }
+};
+
+struct MET_HistogramDescriptor
+{
+    const char *name;
+    const char *help;
+};
+
+static const MET_HistogramDescriptor metHistogramDescriptors[MET_HistogramCount] = {
+    { "aps_confirm_latency_seconds", "Time from sending an APS request until its confirm" },
+    { "aps_indication_latency_seconds", "Time from a status reporting a pending APS indication until it is fetched" },
+    { "http_request_duration_seconds", "Time to handle a HTTP request" },
+    { "db_write_duration_seconds", "Time of database write transactions" },
+    { "tick_lag_seconds", "Main loop tick delay beyond the tick interval" },
+    { "handler_duration_seconds", "Duration of monitored timer events and slots in the main thread" }
+};
+
+std::atomic<uint64_t> metValues[MET_IdCount];
+MET_Histogram metHistograms[MET_HistogramCount];
+
+/*! Returns the bucket index, the upper two bits below the MSB select the sub bucket. */
+static unsigned MET_BucketIndex(uint64_t us)
+{
+    if (us < MET_HIST_SUB_BUCKETS)
+    {
+        return unsigned(us);
+    }
+
+    unsigned msb = 63;
+    while (!(us & (uint64_t(1) << msb)))
+    {
+        msb--;
+    }
+
+    const unsigned sub = unsigned(us >> (msb - 2)) & (MET_HIST_SUB_BUCKETS - 1);
+    const unsigned index = (msb - 1) * MET_HIST_SUB_BUCKETS + sub;
+
+    return index < MET_HIST_BUCKETS ? index : MET_HIST_BUCKETS - 1;
+}
+
+/*! Returns the exclusive upper bound of a bucket. */
+static uint64_t MET_BucketUpperBound(unsigned index)
+{
+    if (index < MET_HIST_SUB_BUCKETS)
+    {
+        return index + 1;
+    }
+
+    const unsigned msb = index / MET_HIST_SUB_BUCKETS + 1;
+    const unsigned sub = index % MET_HIST_SUB_BUCKETS;
+
+    return uint64_t(MET_HIST_SUB_BUCKETS + 1 + sub) << (msb - 2);
+}
+
+uint64_t MET_TimeUs()
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+}
+
+void MET_Observe(MET_HistogramId id, uint64_t us)
+{
+    MET_Histogram &h = metHistograms[id];
+    h.buckets[MET_BucketIndex(us)].fetch_add(1, std::memory_order_relaxed);
+    h.sum.fetch_add(us, std::memory_order_relaxed);
+    h.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+/*! Returns the upper bound in µs of the bucket containing the \p percent percentile, 0 if empty. */
+uint64_t MET_Percentile(MET_HistogramId id, unsigned percent)
+{
+    const MET_Histogram &h = metHistograms[id];
+    const uint64_t count = h.count.load(std::memory_order_relaxed);
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    const uint64_t rank = (count * percent + 99) / 100;
+    uint64_t n = 0;
+
+    for (unsigned i = 0; i < MET_HIST_BUCKETS; i++)
+    {
+        n += h.buckets[i].load(std::memory_order_relaxed);
+        if (n >= rank)
+        {
+            return MET_BucketUpperBound(i);
+        }
+    }
+
+    return MET_BucketUpperBound(MET_HIST_BUCKETS - 1);
+}
+
+const char *MET_Name(MET_Id id)
+{
+    return metDescriptors[id].name;
+}
+
+const char *MET_HistogramName(MET_HistogramId id)
+{
+    return metHistogramDescriptors[id].name;
+}
+
+/*! Writes all metrics in Prometheus text format.
+    \returns the length of the text, or 0 if \p buf is too small
+ */
+unsigned MET_Format(char *buf, unsigned size)
+{
+    unsigned pos = 0;
+    int n;
+
+#define MET_PUT(...) \
+    n = snprintf(&buf[pos], size - pos, __VA_ARGS__); \
+    if (n < 0 || unsigned(n) >= size - pos) { return 0; } \
+    pos += unsigned(n)
+
+    for (unsigned i = 0; i < MET_IdCount; i++)
+    {
+        const MET_Descriptor &d = metDescriptors[i];
+        MET_PUT("# HELP " MET_PREFIX "%s %s\n", d.name, d.help);
+        MET_PUT("# TYPE " MET_PREFIX "%s %s\n", d.name, d.type == MET_TypeCounter ? "counter" : "gauge");
+        MET_PUT(MET_PREFIX "%s %llu\n", d.name, (unsigned long long)metValues[i].load(std::memory_order_relaxed));
+    }
+
+    for (unsigned i = 0; i < MET_HistogramCount; i++)
+    {
+        const MET_HistogramDescriptor &d = metHistogramDescriptors[i];
+        const MET_Histogram &h = metHistograms[i];
+
+        MET_PUT("# HELP " MET_PREFIX "%s %s\n", d.name, d.help);
+        MET_PUT("# TYPE " MET_PREFIX "%s histogram\n", d.name);
+
+        // values below 2^k µs are in the first 4(k - 1) sub buckets
+        uint64_t cumulative = 0;
+        unsigned b = 0;
+        for (unsigned k = MET_EXPORT_MIN_POW2; k <= MET_EXPORT_MAX_POW2; k++)
+        {
+            for (; b < (k - 1) * MET_HIST_SUB_BUCKETS; b++)
+            {
+                cumulative += h.buckets[b].load(std::memory_order_relaxed);
+            }
+            MET_PUT(MET_PREFIX "%s_bucket{le=\"%.6f\"} %llu\n", d.name, double(uint64_t(1) << k) / 1e6, (unsigned long long)cumulative);
+        }
+
+        const uint64_t count = h.count.load(std::memory_order_relaxed);
+        MET_PUT(MET_PREFIX "%s_bucket{le=\"+Inf\"} %llu\n", d.name, (unsigned long long)count);
+        MET_PUT(MET_PREFIX "%s_sum %.6f\n", d.name, double(h.sum.load(std::memory_order_relaxed)) / 1e6);
+        MET_PUT(MET_PREFIX "%s_count %llu\n", d.name, (unsigned long long)count);
+    }
+
+#undef MET_PUT
+
+    return pos;
+}
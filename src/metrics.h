@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <stdint.h>
+
+/*
+ * Runtime metrics registry.
+ *
+ * All metrics are statically allocated, updates are a single relaxed atomic
+ * operation without locks or allocations so they can be used on hot paths.
+ * The registry is exported in Prometheus text format via GET /metrics and as
+ * entries in the core_aps VFS metrics directory.
+ */
+
+/*! Counters and gauges. */
+enum MET_Id
+{
+    // counters
+    MET_ApsFramesRx,
+    MET_ApsFramesTx,
+    MET_ApsConfirms,
+    MET_ApsNoAck,
+    MET_MacNoAck,
+    MET_ApsBusyStatus,
+    MET_SerialRxBytes,
+    MET_SerialTxBytes,
+    MET_SerialRxFrames,
+    MET_SerialTxFrames,
+    MET_SerialCrcErrors,
+    MET_SerialTxWrites,
+    MET_SerialStatusCoalesced,
+    MET_SerialStatusRequests,
+    MET_SerialStatusPush,
+    MET_EventLoopStalls,
+    MET_VfsReadRequests,
+    MET_VfsReadEntries,
+    MET_VfsNotifySent,
+    MET_VfsNotifyCoalesced,
+    MET_VfsNotModified,
+    MET_PhyFrames,
+    MET_PhyFramesDropped,
+    // gauges
+    MET_ApsQueueDepth,
+    MET_ApsRequestsBusy,
+    MET_QItemsWaitSend,
+    MET_QItemsWaitConfirm,
+    MET_SerialBaudrate,
+
+    MET_IdCount
+};
+
+/*! Histograms, all values are in microseconds. */
+enum MET_HistogramId
+{
+    MET_ApsConfirmLatency,
+    MET_ApsIndicationLatency,
+    MET_HttpRequestTime,
+    MET_DbWriteTime,
+    MET_TickLag,
+    MET_HandlerDuration,
+
+    MET_HistogramCount
+};
+
+// log2 buckets with 4 linear sub buckets each, covers 0 µs .. 134 s
+#define MET_HIST_SUB_BUCKETS 4
+#define MET_HIST_BUCKETS (26 * MET_HIST_SUB_BUCKETS)
+
+struct MET_Histogram
+{
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> buckets[MET_HIST_BUCKETS];
+};
+
+extern std::atomic<uint64_t> metValues[MET_IdCount];
+extern MET_Histogram metHistograms[MET_HistogramCount];
+
+inline void MET_Inc(MET_Id id) { metValues[id].fetch_add(1, std::memory_order_relaxed); }
+inline void MET_Add(MET_Id id, uint64_t n) { metValues[id].fetch_add(n, std::memory_order_relaxed); }
+inline void MET_Set(MET_Id id, uint64_t val) { metValues[id].store(val, std::memory_order_relaxed); }
+inline uint64_t MET_Value(MET_Id id) { return metValues[id].load(std::memory_order_relaxed); }
+
+uint64_t MET_TimeUs();
+void MET_Observe(MET_HistogramId id, uint64_t us);
+uint64_t MET_Percentile(MET_HistogramId id, unsigned percent);
+const char *MET_Name(MET_Id id);
+const char *MET_HistogramName(MET_HistogramId id);
+unsigned MET_Format(char *buf, unsigned size);
+
+#endif // METRICS_H
@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "param_cache.h"
+
+// a lost response must not block the parameter forever
+#define PRM_PENDING_TIMEOUT_MS 10000
+
+#define PRM_FLAG_VALID   0x01 // a success response was received since the last invalidation
+#define PRM_FLAG_PENDING 0x02 // read is queued or waiting for its response
+#define PRM_FLAG_HASHED  0x04 // hash holds the last response
+
+struct PRM_Entry
+{
+    int64_t readTime;
+    int64_t pendingTime;
+    uint32_t ttlMs; // 0 not subscribed
+    uint32_t hash;
+    uint8_t flags;
+};
+
+static PRM_Entry prmEntries[PRM_MAX_PARAMS];
+
+static PRM_Entry *PRM_GetEntry(ZM_DataId_t id)
+{
+    if (unsigned(id) < PRM_MAX_PARAMS && PRM_IsCacheable(id))
+    {
+        return &prmEntries[id];
+    }
+
+    return nullptr;
+}
+
+/*! FNV-1a over status and value, only used to detect changes. */
+static uint32_t PRM_Hash(ZM_State_t status, const uint8_t *data, unsigned length)
+{
+    uint32_t h = 2166136261U;
+
+    h = (h ^ uint8_t(status)) * 16777619U;
+    for (unsigned i = 0; i < length; i++)
+    {
+        h = (h ^ data[i]) * 16777619U;
+    }
+
+    return h;
+}
+
+/*! Forgets all values and pending reads, subscriptions are kept. Called on (dis)connect. */
+void PRM_Reset()
+{
+    for (PRM_Entry &e : prmEntries)
+    {
+        e.flags = 0;
+        e.readTime = 0;
+        e.pendingTime = 0;
+    }
+}
+
+/*! Marks all values as outdated, reads already queued aren't affected. */
+void PRM_Invalidate()
+{
+    for (PRM_Entry &e : prmEntries)
+    {
+        e.flags &= ~PRM_FLAG_VALID;
+    }
+}
+
+/*! Marks the value of \p id as outdated, e.g. after it was written. */
+void PRM_InvalidateParam(ZM_DataId_t id)
+{
+    PRM_Entry *e = PRM_GetEntry(id);
+
+    if (e)
+    {
+        e->flags &= ~PRM_FLAG_VALID;
+    }
+}
+
+/*! Requests a refresh of \p id at least every \p ttlMs, the shortest TTL of all subscribers wins. */
+void PRM_Subscribe(ZM_DataId_t id, uint32_t ttlMs)
+{
+    PRM_Entry *e = PRM_GetEntry(id);
+
+    if (e && ttlMs > 0 && (e->ttlMs == 0 || ttlMs < e->ttlMs))
+    {
+        e->ttlMs = ttlMs;
+    }
+}
+
+/*! Returns false for parameters which need an argument, different arguments yield different values. */
+bool PRM_IsCacheable(ZM_DataId_t id)
+{
+    switch (id)
+    {
+    case ZM_DID_STK_ENDPOINT:
+    case ZM_DID_STK_NETWORK_KEY:
+    case ZM_DID_STK_NETWORK_KEY2:
+    case ZM_DID_STK_LINK_KEY:
+    case ZM_DID_STK_KEY_FOR_INDEX:
+        return false;
+
+    default:
+        break;
+    }
+
+    return true;
+}
+
+/*! Returns true if the value was read successfully since the last invalidation. */
+bool PRM_IsValid(ZM_DataId_t id)
+{
+    const PRM_Entry *e = PRM_GetEntry(id);
+
+    return e && (e->flags & PRM_FLAG_VALID);
+}
+
+/*! Returns true if \p id is subscribed, valid and its TTL hasn't expired. */
+bool PRM_IsFresh(ZM_DataId_t id, int64_t now)
+{
+    const PRM_Entry *e = PRM_GetEntry(id);
+
+    if (!e || e->ttlMs == 0 || !(e->flags & PRM_FLAG_VALID))
+    {
+        return false;
+    }
+
+    return now - e->readTime < int64_t(e->ttlMs);
+}
+
+bool PRM_IsPending(ZM_DataId_t id, int64_t now)
+{
+    const PRM_Entry *e = PRM_GetEntry(id);
+
+    return e && (e->flags & PRM_FLAG_PENDING) && now - e->pendingTime < PRM_PENDING_TIMEOUT_MS;
+}
+
+void PRM_SetPending(ZM_DataId_t id, int64_t now)
+{
+    PRM_Entry *e = PRM_GetEntry(id);
+
+    if (e)
+    {
+        e->flags |= PRM_FLAG_PENDING;
+        e->pendingTime = now;
+    }
+}
+
+void PRM_ClearPending(ZM_DataId_t id)
+{
+    PRM_Entry *e = PRM_GetEntry(id);
+
+    if (e)
+    {
+        e->flags &= ~PRM_FLAG_PENDING;
+    }
+}
+
+/*! Stores a read parameter response.
+    \returns true if the value or status differs from the last response
+ */
+bool PRM_Update(ZM_DataId_t id, ZM_State_t status, const uint8_t *data, unsigned length, int64_t now)
+{
+    PRM_Entry *e = PRM_GetEntry(id);
+
+    if (!e)
+    {
+        return true; // not tracked, might have changed
+    }
+
+    const uint32_t hash = PRM_Hash(status, data, length);
+    const bool changed = !(e->flags & PRM_FLAG_HASHED) || e->hash != hash;
+
+    e->flags = PRM_FLAG_HASHED;
+    e->hash = hash;
+
+    if (status == ZM_STATE_SUCCESS)
+    {
+        e->flags |= PRM_FLAG_VALID;
+        e->readTime = now;
+    }
+
+    return changed;
+}
+
+/*! Collects subscribed parameters which are outdated and not already queued.
+    \returns the number of parameters written to \p ids
+ */
+unsigned PRM_Expired(ZM_DataId_t *ids, unsigned max, int64_t now)
+{
+    unsigned n = 0;
+
+    for (unsigned i = 0; i < PRM_MAX_PARAMS && n < max; i++)
+    {
+        const ZM_DataId_t id = ZM_DataId_t(i);
+
+        if (prmEntries[i].ttlMs == 0 || PRM_IsFresh(id, now) || PRM_IsPending(id, now))
+        {
+            continue;
+        }
+
+        ids[n++] = id;
+    }
+
+    return n;
+}
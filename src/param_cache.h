@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef PARAM_CACHE_H
+#define PARAM_CACHE_H
+
+#include <stdint.h>
+#include "common/zm_protocol.h"
+
+/*
+ * Firmware parameter cache.
+ *
+ * Tracks the state of parameters read via ZM_CMD_READ_PARAM: when a value was
+ * last received, whether a read is already queued and a hash to detect changes.
+ * Subscribed parameters are refreshed when their TTL expires instead of being
+ * polled at a fixed interval, unsubscribed ones are never considered fresh.
+ * ZM_STATUS_CONFIG_CHANGED invalidates all entries, writing a parameter its
+ * entry and the pending read, since a read queued before the write doesn't
+ * see the new value. Error responses don't make a value valid.
+ *
+ * Parameters which are read with an argument (keys, endpoints) aren't cached.
+ */
+
+#define PRM_MAX_PARAMS 64
+
+void PRM_Reset();
+void PRM_Invalidate();
+void PRM_InvalidateParam(ZM_DataId_t id);
+void PRM_Subscribe(ZM_DataId_t id, uint32_t ttlMs);
+bool PRM_IsCacheable(ZM_DataId_t id);
+bool PRM_IsValid(ZM_DataId_t id);
+bool PRM_IsFresh(ZM_DataId_t id, int64_t now);
+bool PRM_IsPending(ZM_DataId_t id, int64_t now);
+void PRM_SetPending(ZM_DataId_t id, int64_t now);
+void PRM_ClearPending(ZM_DataId_t id);
+bool PRM_Update(ZM_DataId_t id, ZM_State_t status, const uint8_t *data, unsigned length, int64_t now);
+unsigned PRM_Expired(ZM_DataId_t *ids, unsigned max, int64_t now);
+
+#endif // PARAM_CACHE_H
@@ -0,0 +1,418 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+#else
+  #include <arpa/inet.h>
+  #include <netinet/in.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+#endif
+#include "deconz/dbg_trace.h"
+#include "deconz/util.h"
+#include "metrics.h"
+#include "phy_sniffer.h"
+
+#define SNF_RING_SIZE 512 // power of two
+#define SNF_MAX_FRAME 127
+#define SNF_WRITE_INTERVAL_MS 20
+#define SNF_PCAP_FILES 4
+#define SNF_ZEP_HEADER_SIZE 32
+#define SNF_NTP_UNIX_OFFSET 0x83AA7E80 // seconds from Jan 1, 1900 to Jan 1, 1970
+#define SNF_LINKTYPE_IEEE802_15_4_WITHFCS 195
+
+#ifdef _WIN32
+  typedef SOCKET SNF_Socket;
+  #define SNF_INVALID_SOCKET INVALID_SOCKET
+#else
+  typedef int SNF_Socket;
+  #define SNF_INVALID_SOCKET -1
+#endif
+
+/*! A received frame, written by the main thread and read by the writer thread. */
+struct SNF_Frame
+{
+    uint64_t timeUs; // unix time
+    uint8_t length;
+    uint8_t data[SNF_MAX_FRAME];
+};
+
+std::atomic<bool> snfEnabled{false};
+
+static SNF_Frame snfRing[SNF_RING_SIZE];
+static std::atomic<uint32_t> snfHead{0}; // written by main thread
+static std::atomic<uint32_t> snfTail{0}; // written by writer thread
+static std::atomic<uint8_t> snfChannel{11};
+
+static std::thread snfThread;
+static std::mutex snfMutex;
+static std::condition_variable snfCondition;
+static bool snfRunning = false;
+
+static uint16_t snfZepPort = 0;
+static uint64_t snfPcapMaxSize = 0;
+static char snfPcapPath[512];
+
+/*! State only accessed by the writer thread. */
+struct SNF_Writer
+{
+    SNF_Socket udp;
+    sockaddr_in zepAddr;
+    FILE *pcap;
+    unsigned pcapIndex;
+    uint64_t pcapSize;
+    uint32_t zepSeq;
+    uint8_t buf[SNF_ZEP_HEADER_SIZE + 32 + SNF_MAX_FRAME + 4];
+};
+
+static uint8_t *SNF_PutU16Be(uint8_t *p, uint16_t v)
+{
+    *p++ = v >> 8;
+    *p++ = v & 0xFF;
+    return p;
+}
+
+static uint8_t *SNF_PutU32Be(uint8_t *p, uint32_t v)
+{
+    p = SNF_PutU16Be(p, v >> 16);
+    return SNF_PutU16Be(p, v & 0xFFFF);
+}
+
+static uint8_t *SNF_PutU16Le(uint8_t *p, uint16_t v)
+{
+    *p++ = v & 0xFF;
+    *p++ = v >> 8;
+    return p;
+}
+
+static uint8_t *SNF_PutU32Le(uint8_t *p, uint32_t v)
+{
+    p = SNF_PutU16Le(p, v & 0xFFFF);
+    return SNF_PutU16Le(p, v >> 16);
+}
+
+/*! Writes a ZEP packet into \p buf and returns its length.
+
+    ZEP v2 Header will have the following format (if type=1/Data):
+    |Preamble|Version| Type |Channel ID|Device ID|CRC/LQI Mode|LQI Val|NTP Timestamp|Sequence#|Reserved|Length|
+    |2 bytes |1 byte |1 byte|  1 byte  | 2 bytes |   1 byte   |1 byte |   8 bytes   | 4 bytes |10 bytes|1 byte|
+
+    ZEP v2 Header will have the following format (if type=2/Ack):
+    |Preamble|Version| Type |Sequence#|
+    |2 bytes |1 byte |1 byte| 4 bytes |
+ */
+static unsigned SNF_PutZep(uint8_t *buf, const SNF_Frame &frame, uint32_t seq)
+{
+    uint8_t *p = buf;
+    const uint8_t type = frame.length > 5 ? 1 : 2;
+
+    *p++ = 'E';
+    *p++ = 'X';
+    *p++ = 2; // version
+    *p++ = type;
+
+    if (type == 1)
+    {
+        const uint32_t secs = uint32_t(frame.timeUs / 1000000) + SNF_NTP_UNIX_OFFSET;
+        const uint32_t fraction = uint32_t(((frame.timeUs % 1000000) << 32) / 1000000);
+
+        *p++ = snfChannel.load(std::memory_order_relaxed);
+        p = SNF_PutU16Be(p, 0); // device id
+        *p++ = 0; // crc/lqi mode
+        *p++ = 0; // lqi
+        p = SNF_PutU32Be(p, secs);
+        p = SNF_PutU32Be(p, fraction);
+        p = SNF_PutU32Be(p, seq);
+        memset(p, 0, 10); // reserved
+        p += 10;
+        *p++ = frame.length;
+        memcpy(p, frame.data, frame.length);
+        p += frame.length;
+    }
+    else
+    {
+        p = SNF_PutU32Be(p, seq);
+    }
+
+    return unsigned(p - buf);
+}
+
+static bool SNF_OpenPcap(SNF_Writer *w)
+{
+    char path[sizeof(snfPcapPath) + 16];
+    snprintf(path, sizeof(path), "%s-%u.pcapng", snfPcapPath, w->pcapIndex);
+
+    w->pcap = fopen(path, "wb");
+    w->pcapSize = 0;
+
+    if (!w->pcap)
+    {
+        DBG_Printf(DBG_ERROR, "SNF failed to open %s\n", path);
+        return false;
+    }
+
+    uint8_t hdr[28 + 20];
+    uint8_t *p = hdr;
+
+    // section header block
+    p = SNF_PutU32Le(p, 0x0A0D0D0A);
+    p = SNF_PutU32Le(p, 28);
+    p = SNF_PutU32Le(p, 0x1A2B3C4D); // byte order magic
+    p = SNF_PutU16Le(p, 1); // major
+    p = SNF_PutU16Le(p, 0); // minor
+    p = SNF_PutU32Le(p, 0xFFFFFFFF); // section length unknown
+    p = SNF_PutU32Le(p, 0xFFFFFFFF);
+    p = SNF_PutU32Le(p, 28);
+
+    // interface description block, timestamps in µs (default)
+    p = SNF_PutU32Le(p, 1);
+    p = SNF_PutU32Le(p, 20);
+    p = SNF_PutU16Le(p, SNF_LINKTYPE_IEEE802_15_4_WITHFCS);
+    p = SNF_PutU16Le(p, 0);
+    p = SNF_PutU32Le(p, SNF_MAX_FRAME);
+    p = SNF_PutU32Le(p, 20);
+
+    w->pcapSize = fwrite(hdr, 1, sizeof(hdr), w->pcap);
+    DBG_Printf(DBG_INFO, "SNF write PHY frames to %s\n", path);
+    return true;
+}
+
+/*! Appends an enhanced packet block, switches to the next file if the size limit is reached. */
+static void SNF_WritePcap(SNF_Writer *w, const SNF_Frame &frame)
+{
+    if (w->pcap && w->pcapSize >= snfPcapMaxSize)
+    {
+        fclose(w->pcap);
+        w->pcap = nullptr;
+        w->pcapIndex = (w->pcapIndex + 1) % SNF_PCAP_FILES;
+    }
+
+    if (!w->pcap && !SNF_OpenPcap(w))
+    {
+        return;
+    }
+
+    const unsigned padded = (frame.length + 3U) & ~3U;
+    const unsigned total = 32 + padded;
+    uint8_t *p = w->buf;
+
+    p = SNF_PutU32Le(p, 6);
+    p = SNF_PutU32Le(p, total);
+    p = SNF_PutU32Le(p, 0); // interface id
+    p = SNF_PutU32Le(p, uint32_t(frame.timeUs >> 32));
+    p = SNF_PutU32Le(p, uint32_t(frame.timeUs & 0xFFFFFFFF));
+    p = SNF_PutU32Le(p, frame.length); // captured
+    p = SNF_PutU32Le(p, frame.length); // original
+    memcpy(p, frame.data, frame.length);
+    memset(p + frame.length, 0, padded - frame.length);
+    p += padded;
+    p = SNF_PutU32Le(p, total);
+
+    w->pcapSize += fwrite(w->buf, 1, total, w->pcap);
+}
+
+/*! Opens the UDP socket to send ZEP packets to localhost.
+
+    A plain socket is used since the writer thread has no Qt event loop.
+ */
+static void SNF_OpenUdp(SNF_Writer *w)
+{
+    w->udp = SNF_INVALID_SOCKET;
+
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        DBG_Printf(DBG_ERROR, "SNF failed to init winsock\n");
+        return;
+    }
+#endif
+
+    w->udp = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (w->udp == SNF_INVALID_SOCKET)
+    {
+        DBG_Printf(DBG_ERROR, "SNF failed to create UDP socket\n");
+#ifdef _WIN32
+        WSACleanup();
+#endif
+        return;
+    }
+
+    memset(&w->zepAddr, 0, sizeof(w->zepAddr));
+    w->zepAddr.sin_family = AF_INET;
+    w->zepAddr.sin_port = htons(snfZepPort);
+    w->zepAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+}
+
+static void SNF_CloseUdp(SNF_Writer *w)
+{
+    if (w->udp == SNF_INVALID_SOCKET)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    closesocket(w->udp);
+    WSACleanup();
+#else
+    close(w->udp);
+#endif
+    w->udp = SNF_INVALID_SOCKET;
+}
+
+/*! Drains the ring every SNF_WRITE_INTERVAL_MS, file and socket I/O only happen in this thread. */
+static void SNF_ThreadFunc()
+{
+    SNF_Writer w{};
+    w.udp = SNF_INVALID_SOCKET;
+
+    if (snfZepPort > 0)
+    {
+        SNF_OpenUdp(&w);
+    }
+
+    std::unique_lock<std::mutex> lock(snfMutex);
+
+    while (snfRunning)
+    {
+        snfCondition.wait_for(lock, std::chrono::milliseconds(SNF_WRITE_INTERVAL_MS));
+
+        const uint32_t head = snfHead.load(std::memory_order_acquire);
+        uint32_t tail = snfTail.load(std::memory_order_relaxed);
+
+        if (tail == head)
+        {
+            continue;
+        }
+
+        lock.unlock();
+
+        for (; tail != head; tail++)
+        {
+            const SNF_Frame &frame = snfRing[tail % SNF_RING_SIZE];
+
+            if (w.udp != SNF_INVALID_SOCKET)
+            {
+                const unsigned len = SNF_PutZep(w.buf, frame, w.zepSeq++);
+                // best effort, frames are dropped when nobody listens
+                sendto(w.udp, reinterpret_cast<const char*>(w.buf), int(len), 0,
+                       reinterpret_cast<const sockaddr*>(&w.zepAddr), sizeof(w.zepAddr));
+            }
+
+            if (snfPcapMaxSize > 0)
+            {
+                SNF_WritePcap(&w, frame);
+            }
+
+            snfTail.store(tail + 1, std::memory_order_release);
+        }
+
+        if (w.pcap)
+        {
+            fflush(w.pcap);
+        }
+
+        lock.lock();
+    }
+
+    if (w.pcap)
+    {
+        fclose(w.pcap);
+    }
+
+    SNF_CloseUdp(&w);
+}
+
+/*! Starts the writer thread if any output is configured.
+
+    \param zepPort - UDP port on localhost for ZEP packets, 0 disables
+    \param pcapSizeMb - max. size per pcapng file, 0 disables
+ */
+void SNF_Init(unsigned zepPort, unsigned pcapSizeMb)
+{
+    if (snfRunning || (zepPort == 0 && pcapSizeMb == 0))
+    {
+        return;
+    }
+
+    snfZepPort = uint16_t(zepPort);
+    snfPcapMaxSize = uint64_t(pcapSizeMb) * 1024 * 1024;
+
+    const QByteArray dataPath = deCONZ::getStorageLocation(deCONZ::ApplicationsDataLocation).toUtf8();
+    snprintf(snfPcapPath, sizeof(snfPcapPath), "%s/phy", dataPath.constData());
+
+    if (snfZepPort > 0)
+    {
+        DBG_Printf(DBG_INFO, "SNF send ZEP packets to 127.0.0.1:%u\n", snfZepPort);
+    }
+
+    snfRunning = true;
+    snfThread = std::thread(SNF_ThreadFunc);
+    snfEnabled = true;
+}
+
+void SNF_Exit()
+{
+    if (!snfRunning)
+    {
+        return;
+    }
+
+    snfEnabled = false;
+
+    {
+        std::lock_guard<std::mutex> lock(snfMutex);
+        snfRunning = false;
+    }
+
+    snfCondition.notify_one();
+    snfThread.join();
+}
+
+/*! Sets the channel reported in ZEP packets. */
+void SNF_SetChannel(uint8_t channel)
+{
+    snfChannel.store(channel, std::memory_order_relaxed);
+}
+
+/*! Queues a frame for output, drops it if the ring is full. Main thread only. */
+void SNF_PhyFrame(const uint8_t *data, unsigned length)
+{
+    if (!SNF_IsEnabled() || length == 0)
+    {
+        return;
+    }
+
+    const uint32_t head = snfHead.load(std::memory_order_relaxed);
+
+    if (head - snfTail.load(std::memory_order_acquire) >= SNF_RING_SIZE)
+    {
+        MET_Inc(MET_PhyFramesDropped);
+        return;
+    }
+
+    SNF_Frame &frame = snfRing[head % SNF_RING_SIZE];
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+
+    frame.timeUs = uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(now).count());
+    frame.length = uint8_t(length < SNF_MAX_FRAME ? length : SNF_MAX_FRAME);
+    memcpy(frame.data, data, frame.length);
+
+    snfHead.store(head + 1, std::memory_order_release);
+    MET_Inc(MET_PhyFrames);
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef PHY_SNIFFER_H
+#define PHY_SNIFFER_H
+
+#include <atomic>
+#include <stdint.h>
+
+/*
+ * Output of IEEE 802.15.4 frames received via ZM_CMD_PHY_FRAME.
+ *
+ * The main thread only copies each frame into a preallocated ring, a writer
+ * thread streams them as ZEP v2 over UDP to localhost and/or into rotating
+ * pcapng files. If the writer can't keep up the ring overflows and frames are
+ * dropped (counted in deconz_phy_frames_dropped_total), the main thread never
+ * waits for the writer.
+ *
+ * Options: --zep-port=<port> (e.g. 17754, 0 disables UDP output)
+ *          --phy-pcap=<MB> (max. size per pcapng file, 0 disables file output)
+ */
+
+extern std::atomic<bool> snfEnabled;
+
+void SNF_Init(unsigned zepPort, unsigned pcapSizeMb);
+void SNF_Exit();
+void SNF_SetChannel(uint8_t channel);
+void SNF_PhyFrame(const uint8_t *data, unsigned length);
+inline bool SNF_IsEnabled() { return snfEnabled.load(std::memory_order_relaxed); }
+
+#endif // PHY_SNIFFER_H
@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <QCoreApplication>
+#include <QTimer>
+#include "deconz/aps.h"
+#include "deconz/dbg_trace.h"
+#include "deconz/util.h"
+#include "common/zm_protocol.h"
+#include "metrics.h"
+#include "serial_capture.h"
+#include "zm_controller.h"
+#include "zm_master.h"
+
+#define CAP_FILE_VERSION 3
+#define CAP_REPLAY_START_DELAY 3000 // let plugins and database settle
+#define CAP_REPLAY_BATCH 256 // frames per event loop iteration at max. speed
+
+struct CAP_FileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+};
+
+/*! A received frame of a loaded capture, offset into capData. */
+struct CAP_ReplayFrame
+{
+    uint64_t timeUs;
+    size_t offset;
+    uint16_t length;
+};
+
+std::atomic<bool> capEnabled{false};
+
+static std::mutex capMutex;
+static FILE *capFile = nullptr;
+static uint64_t capStartUs = 0;
+
+static std::vector<uint8_t> capData;
+static std::vector<CAP_ReplayFrame> capFrames;
+static std::vector<CAP_Result> capExpectedResults;
+static std::vector<CAP_Result> capResults;
+static size_t capPos = 0;
+static unsigned capSpeed = 1;
+static bool capExitWhenDone = false;
+static uint64_t capReplayStartUs = 0;
+static unsigned capIndications = 0;
+static QTimer *capTimer = nullptr;
+
+/*! Opens <data>/serial-capture.bin if \p enabled, an existing capture is overwritten. */
+void CAP_Init(bool enabled)
+{
+    if (!enabled || capFile)
+    {
+        return;
+    }
+
+    char path[512];
+    const QByteArray dataPath = deCONZ::getStorageLocation(deCONZ::ApplicationsDataLocation).toUtf8();
+    snprintf(path, sizeof(path), "%s/serial-capture.bin", dataPath.constData());
+
+    capFile = fopen(path, "wb");
+    if (!capFile)
+    {
+        DBG_Printf(DBG_ERROR, "CAP failed to open %s\n", path);
+        return;
+    }
+
+    CAP_FileHeader hdr = { {'S','E','R','C','A','P','\0','\0'}, CAP_FILE_VERSION, sizeof(CAP_RecordHeader) };
+    fwrite(&hdr, sizeof(hdr), 1, capFile);
+
+    capStartUs = MET_TimeUs();
+    capEnabled = true;
+    DBG_Printf(DBG_INFO, "CAP capture serial frames to %s\n", path);
+}
+
+void CAP_Exit()
+{
+    std::lock_guard<std::mutex> lock(capMutex);
+
+    capEnabled = false;
+
+    if (capFile)
+    {
+        fclose(capFile);
+        capFile = nullptr;
+    }
+}
+
+/*! Appends a frame, the stdio buffer keeps this to a memcpy most of the time. */
+void CAP_RecordFrame(CAP_Direction direction, const uint8_t *data, unsigned length)
+{
+    if (!CAP_IsEnabled() || !data || length == 0 || length > UINT16_MAX)
+    {
+        return;
+    }
+
+    CAP_RecordHeader rec{};
+    rec.timeUs = MET_TimeUs() - capStartUs;
+    rec.length = uint16_t(length);
+    rec.direction = uint8_t(direction);
+
+    std::lock_guard<std::mutex> lock(capMutex);
+
+    if (capFile)
+    {
+        fwrite(&rec, sizeof(rec), 1, capFile);
+        fwrite(data, 1, length, capFile);
+    }
+}
+
+/*! Records how the controller handled a firmware response, during replay it's collected for comparison.
+
+    \param match - number of queued requests which matched
+    \param state - deCONZ::CommonState of the matched request, -1 if none
+ */
+void CAP_RecordResult(CAP_ResultType type, uint8_t id, uint8_t status, unsigned match, int state)
+{
+    if (!CAP_IsEnabled() && !capTimer)
+    {
+        return;
+    }
+
+    CAP_Result res{};
+    res.type = uint8_t(type);
+    res.id = id;
+    res.status = status;
+    res.match = uint8_t(match < UINT8_MAX ? match : UINT8_MAX);
+    res.state = uint8_t(state >= 0 ? state : UINT8_MAX);
+
+    if (capTimer)
+    {
+        capResults.push_back(res);
+    }
+    else
+    {
+        CAP_RecordFrame(CAP_DirResult, reinterpret_cast<const uint8_t*>(&res), sizeof(res));
+    }
+}
+
+static bool CAP_Load(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        DBG_Printf(DBG_ERROR, "CAP failed to open %s\n", path);
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    const long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    capData.resize(size > 0 ? size_t(size) : 0);
+    const bool ok = !capData.empty() && fread(capData.data(), 1, capData.size(), f) == capData.size();
+    fclose(f);
+
+    CAP_FileHeader hdr;
+    if (!ok || capData.size() < sizeof(hdr))
+    {
+        DBG_Printf(DBG_ERROR, "CAP failed to read %s\n", path);
+        return false;
+    }
+
+    memcpy(&hdr, capData.data(), sizeof(hdr));
+    if (memcmp(hdr.magic, "SERCAP", 6) != 0 || hdr.version != CAP_FILE_VERSION || hdr.recordSize != sizeof(CAP_RecordHeader))
+    {
+        DBG_Printf(DBG_ERROR, "CAP %s is not a supported capture\n", path);
+        return false;
+    }
+
+    size_t pos = sizeof(hdr);
+    while (pos + sizeof(CAP_RecordHeader) <= capData.size())
+    {
+        CAP_RecordHeader rec;
+        memcpy(&rec, &capData[pos], sizeof(rec));
+        pos += sizeof(rec);
+
+        if (pos + rec.length > capData.size())
+        {
+            break; // truncated by crash
+        }
+
+        if (rec.direction == CAP_DirRx)
+        {
+            capFrames.push_back({rec.timeUs, pos, rec.length});
+        }
+        else if (rec.direction == CAP_DirResult && rec.length == sizeof(CAP_Result))
+        {
+            CAP_Result res;
+            memcpy(&res, &capData[pos], sizeof(res));
+            capExpectedResults.push_back(res);
+        }
+
+        pos += rec.length;
+    }
+
+    return !capFrames.empty();
+}
+
+static void CAP_ReplayDone()
+{
+    capTimer->stop();
+
+    const uint64_t dt = MET_TimeUs() - capReplayStartUs;
+    const double secs = double(dt) / 1e6;
+
+    size_t i = 0;
+    for (; i < capResults.size() && i < capExpectedResults.size(); i++)
+    {
+        if (memcmp(&capResults[i], &capExpectedResults[i], sizeof(CAP_Result)) != 0)
+        {
+            const CAP_Result &a = capResults[i];
+            const CAP_Result &e = capExpectedResults[i];
+            DBG_Printf(DBG_INFO, "CAP replay result %u differs, expected type: %u, id: %u, status: 0x%02X, match: %u, state: %u, got type: %u, id: %u, status: 0x%02X, match: %u, state: %u\n",
+                       unsigned(i), e.type, e.id, e.status, e.match, e.state, a.type, a.id, a.status, a.match, a.state);
+            break;
+        }
+    }
+
+    const bool ok = i == capResults.size() && i == capExpectedResults.size();
+
+    DBG_Printf(DBG_INFO, "CAP replay %s: %u frames in %.3f s, %u indications (%.0f/s), %u controller results, %u recorded\n",
+               ok ? "passed" : "FAILED", unsigned(capFrames.size()), secs, capIndications,
+               secs > 0 ? capIndications / secs : 0.0, unsigned(capResults.size()), unsigned(capExpectedResults.size()));
+
+    if (capExitWhenDone)
+    {
+        QCoreApplication::exit(ok ? 0 : 1);
+    }
+}
+
+/*! Feeds all frames which are due, at most CAP_REPLAY_BATCH per call to keep the event loop running. */
+static void CAP_ReplayTimerFired()
+{
+    const uint64_t elapsed = MET_TimeUs() - capReplayStartUs;
+    const uint64_t base = capFrames.front().timeUs;
+    zmMaster *master = deCONZ::master();
+
+    for (unsigned n = 0; capPos < capFrames.size() && n < CAP_REPLAY_BATCH; capPos++, n++)
+    {
+        const CAP_ReplayFrame &frame = capFrames[capPos];
+
+        if (capSpeed > 0 && (frame.timeUs - base) / capSpeed > elapsed)
+        {
+            capTimer->start(int(((frame.timeUs - base) / capSpeed - elapsed) / 1000));
+            return;
+        }
+
+        struct zm_command cmd;
+        if (zm_protocol_buffer2command(&capData[frame.offset], frame.length, &cmd) != ZM_PARSE_OK)
+        {
+            continue;
+        }
+
+        master->processPacked(&cmd);
+    }
+
+    if (capPos < capFrames.size())
+    {
+        capTimer->start(0);
+    }
+    else
+    {
+        CAP_ReplayDone();
+    }
+}
+
+static void CAP_ReplayBegin()
+{
+    zmController *ctrl = deCONZ::controller();
+
+    QObject::connect(ctrl, &zmController::apsdeDataIndication, ctrl, [](const deCONZ::ApsDataIndication &) { capIndications++; });
+
+    deCONZ::master()->beginReplay();
+
+    DBG_Printf(DBG_INFO, "CAP replay %u frames, speed: %u, data directory: %s\n", unsigned(capFrames.size()), capSpeed,
+               qPrintable(deCONZ::getStorageLocation(deCONZ::ApplicationsDataLocation)));
+    capReplayStartUs = MET_TimeUs();
+    CAP_ReplayTimerFired();
+}
+
+/*! Starts replaying the received frames of capture \p path, must be called from the main thread.
+
+    The device connection is blocked from now on, see CAP_IsReplay().
+    \param speed - time scale of the capture, 0 replays as fast as possible
+    \param exitWhenDone - quit the application when done, the exit code is 1 if the controller results differ
+    \returns 0 if the replay was scheduled
+ */
+int CAP_StartReplay(const char *path, unsigned speed, bool exitWhenDone)
+{
+    if (capTimer || !CAP_Load(path))
+    {
+        return -1;
+    }
+
+    if (CAP_IsEnabled())
+    {
+        DBG_Printf(DBG_INFO, "CAP capture disabled during replay\n");
+        CAP_Exit();
+    }
+
+    capSpeed = speed;
+    capExitWhenDone = exitWhenDone;
+    capTimer = new QTimer;
+    capTimer->setSingleShot(true);
+    QObject::connect(capTimer, &QTimer::timeout, CAP_ReplayTimerFired);
+    QTimer::singleShot(CAP_REPLAY_START_DELAY, capTimer, CAP_ReplayBegin);
+
+    return 0;
+}
+
+/*! Returns true if a replay was started, the device must not be opened then. */
+bool CAP_IsReplay()
+{
+    return capTimer != nullptr;
+}
+
+/*! Drops the replay state, called before the application object is destroyed. */
+void CAP_ResetReplay()
+{
+    delete capTimer;
+    capTimer = nullptr;
+    capData.clear();
+    capFrames.clear();
+    capExpectedResults.clear();
+    capResults.clear();
+    capPos = 0;
+    capIndications = 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef SERIAL_CAPTURE_H
+#define SERIAL_CAPTURE_H
+
+#include <atomic>
+#include <stdint.h>
+
+/*
+ * Capture and replay of serial protocol frames.
+ *
+ * With --serial-capture=1 every frame exchanged with the firmware is appended
+ * to <data>/serial-capture.bin as is (without SLIP framing and CRC).
+ *
+ * The controller records how it handled each APS confirm and APS request
+ * status of the firmware (matched requests and resulting request state),
+ * they are the expected outcome of a replay. Confirms the controller
+ * synthesizes itself (timeouts, expired deadlines) depend on timing and
+ * aren't recorded.
+ *
+ * --serial-replay=<file> feeds the received frames of a capture into
+ * zmMaster::processPacked() without a device, at the recorded speed multiplied
+ * by --replay-speed=<n> (0 as fast as possible). Afterwards the indication
+ * throughput is reported and the controller results are compared in order
+ * with the recorded ones. With --replay-exit=1 the application quits, the
+ * exit code is 0 if they match.
+ *
+ * During a replay no device is connected, APS requests are taken as sent so
+ * the replayed confirms can match them. Plugins run normally on the regular
+ * data directory and may modify the node database, so a replay should run
+ * with a copy of the data directory (e.g. a scratch HOME).
+ */
+
+enum CAP_Direction
+{
+    CAP_DirRx = 0,
+    CAP_DirTx = 1,
+    CAP_DirResult = 2 // CAP_Result of the controller
+};
+
+enum CAP_ResultType
+{
+    CAP_ResultConfirm = 0, // APSDE-DATA.confirm of the firmware
+    CAP_ResultRequestDone = 1 // APSDE-DATA.request status of the firmware
+};
+
+/*! How the controller handled a firmware response, compared during replay. */
+struct CAP_Result
+{
+    uint8_t type; // CAP_ResultType
+    uint8_t id;
+    uint8_t status;
+    uint8_t match; // number of queued requests matched
+    uint8_t state; // deCONZ::CommonState of the matched request
+    uint8_t reserved[3];
+};
+
+static_assert (sizeof(CAP_Result) == 8, "unexpected CAP_Result size");
+
+/*! Header of a captured frame, followed by length bytes (little endian). */
+struct CAP_RecordHeader
+{
+    uint64_t timeUs; // since start of the capture
+    uint16_t length;
+    uint8_t direction; // CAP_Direction
+    uint8_t reserved[5];
+};
+
+static_assert (sizeof(CAP_RecordHeader) == 16, "unexpected CAP_RecordHeader size");
+
+extern std::atomic<bool> capEnabled;
+
+void CAP_Init(bool enabled);
+void CAP_Exit();
+void CAP_RecordFrame(CAP_Direction direction, const uint8_t *data, unsigned length);
+void CAP_RecordResult(CAP_ResultType type, uint8_t id, uint8_t status, unsigned match, int state);
+inline bool CAP_IsEnabled() { return capEnabled.load(std::memory_order_relaxed); }
+int CAP_StartReplay(const char *path, unsigned speed, bool exitWhenDone);
+bool CAP_IsReplay();
+void CAP_ResetReplay();
+
+#endif // SERIAL_CAPTURE_H
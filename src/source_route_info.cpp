@@ -41,9 +41,31 @@ SourceRouteInfo::SourceRouteInfo(QWidget *parent) :
 
     connect(ui->minLqiDisplay, SIGNAL(valueChanged(int)),
             deCONZ::controller(), SLOT(setMinLqiDisplay(int)));
+
+    connect(ui->topologyScan, &QPushButton::clicked, this, [this]() {
+        deCONZ::controller()->startTopologyScan(ui->fastDiscovery->isChecked());
+    });
+
+    connect(deCONZ::controller(), &zmController::topologyScanChanged,
+            this, &SourceRouteInfo::topologyScanChanged);
 }
 
 SourceRouteInfo::~SourceRouteInfo()
 {
     delete ui;
 }
+
+void SourceRouteInfo::topologyScanChanged()
+{
+    const TopologyScan &scan = deCONZ::controller()->topologyScan();
+
+    if (scan.active)
+    {
+        ui->topologyScanStatus->setText(tr("%1 / %2 routers").arg(scan.done).arg(scan.routers));
+    }
+    else if (scan.routers > 0)
+    {
+        const deCONZ::TimeMs dt = scan.finished - scan.started;
+        ui->topologyScanStatus->setText(tr("%1 routers in %2 s, %3 failed").arg(scan.routers).arg(dt.val / 1000).arg(scan.failed));
+    }
+}
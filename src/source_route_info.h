@@ -25,6 +25,9 @@ public:
     explicit SourceRouteInfo(QWidget *parent = nullptr);
     ~SourceRouteInfo();
 
+private Q_SLOTS:
+    void topologyScanChanged();
+
 private:
     Ui::SourceRouteInfo *ui;
 };
@@ -244,7 +244,7 @@ static void selectBestSourceRouteForNode(const NodeInfo &node, std::vector<Sourc
             if (i != node.data->sourceRoutes().end())
             {
                 const auto uuid = i->uuid();
-                node.data->removeSourceRoute(i->uuidHash());
+                CoreNode_RemoveSourceRoute(node.data, i->uuidHash());
                 emit deCONZ::controller()->sourceRouteDeleted(uuid);
                 continue;
             }
@@ -252,7 +252,7 @@ static void selectBestSourceRouteForNode(const NodeInfo &node, std::vector<Sourc
             break;
         }
 
-        node.data->addSourceRoute(route);
+        CoreNode_AddSourceRoute(node.data, route);
         emit deCONZ::controller()->sourceRouteChanged(route);
     }
 }
@@ -328,7 +328,7 @@ static void calculateRouteForNode(const NodeInfo &node, const std::vector<NodeIn
                     {
                         addTrashRoute(route);
                     }
-                    node.data->removeSourceRoute(route.uuidHash());
+                    CoreNode_RemoveSourceRoute(node.data, route.uuidHash());
                     routes.erase(routes.begin() + routeIter);
                     emit deCONZ::controller()->sourceRouteDeleted(uuid);
                 }
@@ -465,7 +465,7 @@ static void calculateRouteForNode(const NodeInfo &node, const std::vector<NodeIn
 
         if (node1->sourceRoutes().empty())
         {
-            node.data->addSourceRoute(route1);
+            CoreNode_AddSourceRoute(node.data, route1);
             emit deCONZ::controller()->sourceRouteChanged(route1);
         }
     }
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef VFS_BATCH_H
+#define VFS_BATCH_H
+
+/*
+ * Batched and conditional reads of VFS entries, supported by the core_aps
+ * actor.
+ *
+ * The mtime of an entry is the time of its last change in ms since epoch.
+ * It is unique and increasing, 0 means the entry isn't tracked and has to be
+ * read every time. A conditional read with since >= mtime is answered with
+ * VFS_RESPONSE_STATUS_NOT_MODIFIED and no value, since = 0 reads always.
+ *
+ * VFS_M_ID_READ_ENTRIES_REQ
+ *   u16 tag
+ *   u16 count (max. VFS_READ_ENTRIES_MAX)
+ *   count * { str url, u64 since }
+ *
+ * VFS_M_ID_READ_ENTRIES_RSP
+ *   u16 tag
+ *   u8  status
+ *   u16 count, less than requested if the message is full
+ *   count * { u8 status, [if OK: str type, u32 mode, u64 mtime, value] }
+ *
+ * Entries are returned in request order, the ones not returned must be
+ * requested again.
+ *
+ * VFS_M_ID_READ_ENTRY_IF_MODIFIED_REQ
+ *   u16 tag
+ *   str url
+ *   u64 since
+ *
+ * The response is a regular VFS_M_ID_READ_ENTRY_RSP.
+ */
+
+#define VFS_M_ID_READ_ENTRIES_REQ AM_MESSAGE_ID_SPECIFIC_REQUEST(16)
+#define VFS_M_ID_READ_ENTRIES_RSP AM_MESSAGE_ID_MAKE_RESPONSE(VFS_M_ID_READ_ENTRIES_REQ)
+#define VFS_M_ID_READ_ENTRY_IF_MODIFIED_REQ AM_MESSAGE_ID_SPECIFIC_REQUEST(17)
+
+#define VFS_RESPONSE_STATUS_NOT_MODIFIED 0x40 // not part of AM_RESPONSE_STATUS_*
+
+#define VFS_READ_ENTRIES_MAX 16
+
+#endif // VFS_BATCH_H
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#include "zcl_tlv.h"
+
+#define ZCL_MAX_NESTING 4
+
+#define ZCL_STATUS_SUCCESS 0x00
+
+static int ZCL_ValueLength2(uint8_t dataType, const uint8_t *data, unsigned size, int depth);
+
+/*! Returns the fixed length of a data type, 0 for no data and -1 for variable or unknown types. */
+static int ZCL_FixedLength(uint8_t dataType)
+{
+    switch (dataType)
+    {
+    case 0x00: return 0; // no data
+    case 0x10: return 1; // boolean
+    case 0x30: return 1; // enum8
+    case 0x31: return 2; // enum16
+    case 0x38: return 2; // semi precision
+    case 0x39: return 4; // single precision
+    case 0x3a: return 8; // double precision
+    case 0xe0: return 4; // time of day
+    case 0xe1: return 4; // date
+    case 0xe2: return 4; // UTC time
+    case 0xe8: return 2; // cluster id
+    case 0xe9: return 2; // attribute id
+    case 0xea: return 4; // BACnet OID
+    case 0xf0: return 8; // IEEE address
+    case 0xf1: return 16; // security key
+    default:
+        break;
+    }
+
+    // data8..data64, bitmap8..bitmap64, uint8..uint64, int8..int64
+    if ((dataType >= 0x08 && dataType <= 0x0f) ||
+        (dataType >= 0x18 && dataType <= 0x1f) ||
+        (dataType >= 0x20 && dataType <= 0x27) ||
+        (dataType >= 0x28 && dataType <= 0x2f))
+    {
+        return (dataType & 0x07) + 1;
+    }
+
+    return -1;
+}
+
+/*! Array, set and bag: element type (1), count (2), elements. */
+static int ZCL_ArrayLength(const uint8_t *data, unsigned size, int depth)
+{
+    if (size < 3)
+    {
+        return -1;
+    }
+
+    const uint8_t elemType = data[0];
+    const unsigned count = data[1] | (data[2] << 8);
+    unsigned len = 3;
+
+    if (count == 0xFFFF) // invalid value, no elements
+    {
+        return int(len);
+    }
+
+    const int fixed = ZCL_FixedLength(elemType);
+    if (fixed >= 0)
+    {
+        if (size - len < count * unsigned(fixed))
+        {
+            return -1;
+        }
+        return int(len + count * unsigned(fixed));
+    }
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        const int n = ZCL_ValueLength2(elemType, data + len, size - len, depth + 1);
+        if (n < 0)
+        {
+            return -1;
+        }
+        len += unsigned(n);
+    }
+
+    return int(len);
+}
+
+/*! Structure: count (2), {element type (1), value}. */
+static int ZCL_StructLength(const uint8_t *data, unsigned size, int depth)
+{
+    if (size < 2)
+    {
+        return -1;
+    }
+
+    const unsigned count = data[0] | (data[1] << 8);
+    unsigned len = 2;
+
+    if (count == 0xFFFF)
+    {
+        return int(len);
+    }
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (len >= size)
+        {
+            return -1;
+        }
+
+        const uint8_t elemType = data[len++];
+        const int n = ZCL_ValueLength2(elemType, data + len, size - len, depth + 1);
+        if (n < 0)
+        {
+            return -1;
+        }
+        len += unsigned(n);
+    }
+
+    return int(len);
+}
+
+static int ZCL_ValueLength2(uint8_t dataType, const uint8_t *data, unsigned size, int depth)
+{
+    if (depth > ZCL_MAX_NESTING)
+    {
+        return -1;
+    }
+
+    const int fixed = ZCL_FixedLength(dataType);
+    if (fixed >= 0)
+    {
+        return unsigned(fixed) <= size ? fixed : -1;
+    }
+
+    unsigned len;
+
+    switch (dataType)
+    {
+    case 0x41: // octet string
+    case 0x42: // character string
+        if (size < 1)
+        {
+            return -1;
+        }
+        len = data[0] == 0xFF ? 1 : 1 + data[0];
+        break;
+
+    case 0x43: // long octet string
+    case 0x44: // long character string
+        if (size < 2)
+        {
+            return -1;
+        }
+        len = data[0] | (data[1] << 8);
+        len = len == 0xFFFF ? 2 : 2 + len;
+        break;
+
+    case 0x48: // array
+    case 0x50: // set
+    case 0x51: // bag
+        return ZCL_ArrayLength(data, size, depth);
+
+    case 0x4c: // structure
+        return ZCL_StructLength(data, size, depth);
+
+    default:
+        return -1; // unknown, can't be skipped
+    }
+
+    return len <= size ? int(len) : -1;
+}
+
+void ZCL_InitReader(ZCL_AttrReader *r, const uint8_t *data, unsigned size)
+{
+    r->data = data;
+    r->size = size;
+    r->pos = 0;
+    r->error = 0;
+}
+
+/*! Returns the length of a value of \p dataType at \p data, or -1 if it's malformed or exceeds \p size. */
+int ZCL_ValueLength(uint8_t dataType, const uint8_t *data, unsigned size)
+{
+    return ZCL_ValueLength2(dataType, data, size, 0);
+}
+
+/*! Reads the next record of a Report Attributes command: id (2), type (1), value.
+    \returns false at the end of the payload or on error (r->error is set)
+ */
+bool ZCL_NextReportRecord(ZCL_AttrReader *r, ZCL_AttrRecord *rec)
+{
+    if (r->error || r->pos >= r->size)
+    {
+        return false;
+    }
+
+    if (r->size - r->pos < 3)
+    {
+        r->error = 1;
+        return false;
+    }
+
+    const uint8_t *p = r->data + r->pos;
+    rec->id = p[0] | (p[1] << 8);
+    rec->status = ZCL_STATUS_SUCCESS;
+    rec->dataType = p[2];
+    rec->offset = r->pos + 3;
+
+    const int n = ZCL_ValueLength(rec->dataType, r->data + rec->offset, r->size - rec->offset);
+    if (n < 0)
+    {
+        r->error = 1;
+        return false;
+    }
+
+    rec->length = unsigned(n);
+    r->pos = rec->offset + rec->length;
+    return true;
+}
+
+/*! Reads the next record of a Read Attributes Response: id (2), status (1), [type (1), value].
+    \returns false at the end of the payload or on error (r->error is set)
+ */
+bool ZCL_NextReadResponseRecord(ZCL_AttrReader *r, ZCL_AttrRecord *rec)
+{
+    if (r->error || r->pos >= r->size)
+    {
+        return false;
+    }
+
+    if (r->size - r->pos < 3)
+    {
+        r->error = 1;
+        return false;
+    }
+
+    const uint8_t *p = r->data + r->pos;
+    rec->id = p[0] | (p[1] << 8);
+    rec->status = p[2];
+
+    if (rec->status != ZCL_STATUS_SUCCESS)
+    {
+        rec->dataType = 0x00;
+        rec->offset = r->pos + 3;
+        rec->length = 0;
+        r->pos = rec->offset;
+        return true;
+    }
+
+    if (r->size - r->pos < 4)
+    {
+        r->error = 1;
+        return false;
+    }
+
+    rec->dataType = p[3];
+    rec->offset = r->pos + 4;
+
+    const int n = ZCL_ValueLength(rec->dataType, r->data + rec->offset, r->size - rec->offset);
+    if (n < 0)
+    {
+        r->error = 1;
+        return false;
+    }
+
+    rec->length = unsigned(n);
+    r->pos = rec->offset + rec->length;
+    return true;
+}
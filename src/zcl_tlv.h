@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2026 dresden elektronik ingenieurtechnik gmbh.
+ * All rights reserved.
+ *
+ * The software in this package is published under the terms of the BSD
+ * style license a copy of which has been included with this distribution in
+ * the LICENSE.txt file.
+ *
+ */
+
+#ifndef ZCL_TLV_H
+#define ZCL_TLV_H
+
+#include <stdint.h>
+
+/*
+ * Allocation free decoder for ZCL attribute records.
+ *
+ * The reader walks over a payload and returns spans of the attribute values,
+ * all lengths are validated for every ZCL data type before anything is read.
+ */
+
+struct ZCL_AttrRecord
+{
+    uint16_t id;
+    uint8_t status;
+    uint8_t dataType;
+    unsigned offset; // value offset in payload
+    unsigned length; // value length incl. length prefixes
+};
+
+struct ZCL_AttrReader
+{
+    const uint8_t *data;
+    unsigned size;
+    unsigned pos;
+    int error; // set when a record is malformed
+};
+
+void ZCL_InitReader(ZCL_AttrReader *r, const uint8_t *data, unsigned size);
+int ZCL_ValueLength(uint8_t dataType, const uint8_t *data, unsigned size);
+bool ZCL_NextReportRecord(ZCL_AttrReader *r, ZCL_AttrRecord *rec);
+bool ZCL_NextReadResponseRecord(ZCL_AttrReader *r, ZCL_AttrRecord *rec);
+
+#endif // ZCL_TLV_H
@@ -9,6 +9,7 @@
  */
 
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QGraphicsScene>
 #include <QTimer>
 #include <QFile>
@@ -43,7 +44,13 @@
 #include "deconz/u_timer.h"
 #include "source_routing.h"
 #include "db_nodes.h"
+#include "event_monitor.h"
+#include "metrics.h"
+#include "param_cache.h"
+#include "serial_capture.h"
+#include "vfs_batch.h"
 #include "zcl_private.h"
+#include "zcl_tlv.h"
 #include "zm_app.h"
 #include "zm_binddropbox.h"
 #include "zm_controller.h"
@@ -69,6 +76,10 @@
 #define DEVICE_TTL_RESET (60 * 120) // 120 minutes
 #define DEVICE_TTL_RESET_THRESHOLD 600 // reset watchdog if all ok and ttl below threshold
 
+#define PARAM_REFRESH_INTERVAL (10 * 1000) // granularity of the parameter TTLs
+#define PARAM_TTL_NETWORK (180 * 1000) // values which change without ZM_STATUS_CONFIG_CHANGED
+#define PARAM_TTL_CONFIG (30 * 60 * 1000)
+
 #define DEVICE_ZDP_LOOPBACK_OK     0x0001
 #define DEVICE_RX_NETWORK_OK       0x0002
 #define DEVICE_CONFIG_NETWORK_OK   0x0004
@@ -98,9 +109,6 @@ static struct am_actor am_actor_core_net;
 static struct am_actor am_actor_core_dev;
 static struct am_actor am_actor_core_aps;
 static struct am_actor am_actor_core_node;
-
-static uint64_t aps_frames_tx = 0;
-static uint64_t aps_frames_rx = 0;
 #endif
 
 // manufacturer codes
@@ -137,9 +145,34 @@ namespace {
     constexpr deCONZ::TimeSeconds ZombieDiscoveryEmptyInterval{60}; // 60 s
     constexpr deCONZ::TimeSeconds ZombieDiscoveryInterval{60}; // 60 s
     constexpr deCONZ::TimeSeconds MaxZombieDiscoveryInterval{60 * 30}; // 30 min
+    constexpr deCONZ::TimeSeconds SubscriberStatsInterval{60};
+    constexpr deCONZ::TimeSeconds ApsQueueStatsInterval{60};
+    // requests per class which can be sent in one scheduling round, see sendNextApsdeDataRequest()
+    const std::array<int, ApsPrioMax> ApsPrioBudget = { 8, 4, 4, 2 };
+    const char *ApsPrioNames[ApsPrioMax] = { "interactive", "ota", "reporting", "discovery" };
+    const float MaxApsWindowRouter = 4;
+    const float MaxApsWindowEndDevice = 2;
+    const int MaxApsSpacingMs = 2000;
+    const int MinApsSpacingMs = 100;
+    const size_t MaxSubscribers = 32;
+    const int MaxDiscoveryTasksPerTick = 8;
+    const int64_t MinLqiDeferMs = 250;
+    constexpr deCONZ::TimeMs DiscoveryBusyDelay{1000};
+    constexpr deCONZ::TimeMs DiscoveryWaitDelay{60 * 1000};
+    constexpr deCONZ::TimeMs DiscoveryResponseTimeout{10 * 1000};
+    constexpr deCONZ::TimeMs ZombieCheckInterval{60 * 1000};
+    constexpr deCONZ::TimeSeconds BindingRefreshInterval{60};
+    constexpr deCONZ::TimeSeconds DiscoveryStatsInterval{60};
+    constexpr deCONZ::TimeSeconds MaxTopologyScanDuration{60 * 60};
+    const int MaxTopologyScanTries = 3;
 }
 
 static bool ZCL_IsDefaultResponse(const deCONZ::ApsDataRequest &req);
+static void NI_SetVisible(NodeInfo *node, bool visible);
+static unsigned NI_ApsWindow(const NodeInfo *node, unsigned defaultWindow);
+static void NI_ApsConfirmed(NodeInfo *node, int64_t rttMs, uint8_t status, unsigned defaultWindow);
+static deCONZ::ZclCluster *NI_GetCluster(NodeInfo *node, uint8_t endpoint, uint16_t clusterId, deCONZ::ZclClusterSide side);
+static bool NI_BindingRefreshDue(NodeInfo *node, const deCONZ::ApsDataIndication &ind, deCONZ::SteadyTimeRef now);
 bool ZDP_SendNwkAddrRequest(zmController *apsCtrl, const deCONZ::Address &dst);
 bool ZDP_SendIeeeAddrRequest(zmController *apsCtrl, const deCONZ::Address &dst);
 
@@ -173,6 +206,37 @@ QString createUuid(const QString &prefix)
     return prefix + QUuid::createUuid().toString().remove('{').remove('}');
 }
 
+/*! Forwards fetch state changes of nodes to the discovery scheduler. */
+static void NI_FetchChanged(deCONZ::zmNode *node, deCONZ::RequestId item)
+{
+    if (_apsCtrl)
+    {
+        _apsCtrl->fetchStateChanged(node, item);
+    }
+}
+
+/*! Returns the scheduling class of a request. */
+static ApsPriorityClass APS_PriorityClass(const deCONZ::ApsDataRequest &req)
+{
+    if (req.profileId() == ZDP_PROFILE_ID)
+    {
+        return ApsPrioDiscovery;
+    }
+
+    if (req.clusterId() == 0x0019)
+    {
+        return ApsPrioOta;
+    }
+
+    const QByteArray &asdu = req.asdu();
+    if (asdu.size() >= 3 && (asdu.at(0) & 0x03) == deCONZ::ZclFCClusterCommand)
+    {
+        return ApsPrioInteractive;
+    }
+
+    return ApsPrioReporting;
+}
+
 int APS_RequestsBusyCount(const std::vector<deCONZ::ApsDataRequest> &queue)
 {
     int result = 0;
@@ -520,7 +584,7 @@ static void CoreAps_ListDevicesNodeDirectoryRequest(struct am_message *m, am_ls_
 
 
         am->msg_put_u32(m, 0); /* dummy next index */
-        am->msg_put_u32(m, 6); /* dummy count */
+        am->msg_put_u32(m, 9); /* dummy count */
 
         /*******************************************/
 
@@ -544,6 +608,18 @@ static void CoreAps_ListDevicesNodeDirectoryRequest(struct am_message *m, am_ls_
         am->msg_put_u16(m, 0); /* flags */
         am->msg_put_u16(m, 1); /* icon */
 
+        am->msg_put_cstring(m, "aps_window");
+        am->msg_put_u16(m, 0); /* flags */
+        am->msg_put_u16(m, 1); /* icon */
+
+        am->msg_put_cstring(m, "aps_rtt");
+        am->msg_put_u16(m, 0); /* flags */
+        am->msg_put_u16(m, 1); /* icon */
+
+        am->msg_put_cstring(m, "aps_spacing");
+        am->msg_put_u16(m, 0); /* flags */
+        am->msg_put_u16(m, 1); /* icon */
+
         am->msg_put_cstring(m, "endpoints");
         am->msg_put_u16(m, VFS_LS_DIR_ENTRY_FLAGS_IS_DIR); /* flags */
         am->msg_put_u16(m, 1); /* icon */
@@ -716,6 +792,52 @@ static void CoreAps_ListComDirectoryRequest(struct am_message *m, am_ls_dir_req
     }
 }
 
+static void CoreAps_ListMetricsDirectoryRequest(struct am_message *m, am_ls_dir_req *req)
+{
+    if (req->url_parse.element_count == 1) // metrics
+    {
+        am->msg_put_u8(m, AM_RESPONSE_STATUS_OK);
+        am->msg_put_u32(m, req->req_index);
+
+        am_u32 next_index = req->req_index;
+        am_u32 count = 0;
+        unsigned hdr_pos = m->pos;
+
+        am->msg_put_u32(m, 0); /* dummy next index */
+        am->msg_put_u32(m, 0); /* dummy count */
+
+        /*******************************************/
+
+        unsigned i = req->req_index;
+
+        for (; i < MET_IdCount && count < req->max_count; i++)
+        {
+            next_index++;
+            count++;
+
+            am->msg_put_cstring(m, MET_Name(MET_Id(i)));
+            am->msg_put_u16(m, 0); /* flags */
+            am->msg_put_u16(m, 1); /* icon */
+        }
+
+        if (i == MET_IdCount)
+            next_index = 0;
+
+        // fill in real header data
+        unsigned pos1 = m->pos;
+        m->pos = hdr_pos;
+
+        am->msg_put_u32(m, next_index);
+        am->msg_put_u32(m, count); /* count */
+
+        m->pos = pos1;
+    }
+    else
+    {
+        am->msg_put_u8(m, AM_RESPONSE_STATUS_NOT_FOUND);
+    }
+}
+
 static int CoreAps_ListDirectoryRequest(struct am_message *msg)
 {
     struct am_message *m;
@@ -747,7 +869,7 @@ static int CoreAps_ListDirectoryRequest(struct am_message *msg)
         am->msg_put_u32(m, req.req_index);
         am->msg_put_u32(m, 0); /* no next index */
 
-        am->msg_put_u32(m, 5); /* count */
+        am->msg_put_u32(m, 6); /* count */
         /*************************************/
         am->msg_put_cstring(m, ".actor");
         am->msg_put_u16(m, VFS_LS_DIR_ENTRY_FLAGS_IS_DIR); /* flags */
@@ -768,6 +890,10 @@ static int CoreAps_ListDirectoryRequest(struct am_message *msg)
         am->msg_put_cstring(m, "frames_tx");
         am->msg_put_u16(m, 0); /* flags */
         am->msg_put_u16(m, 1); /* icon */
+
+        am->msg_put_cstring(m, "metrics");
+        am->msg_put_u16(m, VFS_LS_DIR_ENTRY_FLAGS_IS_DIR); /* flags */
+        am->msg_put_u16(m, 0); /* icon */
     }
     else if (req.url_parse.element_count >= 1)
     {
@@ -780,6 +906,10 @@ static int CoreAps_ListDirectoryRequest(struct am_message *msg)
         {
             CoreAps_ListComDirectoryRequest(m, &req);
         }
+        else if (elem1 == "metrics")
+        {
+            CoreAps_ListMetricsDirectoryRequest(m, &req);
+        }
         else if (req.url_parse.url == ".actor" && req.req_index == 0 && req.url_parse.element_count == 1)
         {
             /*
@@ -811,7 +941,26 @@ static int CoreAps_ListDirectoryRequest(struct am_message *msg)
     return AM_CB_STATUS_OK;
 }
 
-static void Core_ReadEntryDevicesReq(struct am_message *m, am_read_entry_req *req)
+/*
+ * VFS entries which are covered by change notifications carry the time of
+ * their last change as mtime, others have mtime 0 and must always be read.
+ * The mtime is unique and increasing so it can be used as version.
+ */
+static uint64_t coreVfsMtime = 0;
+static uint64_t coreComStateMtime = 0;
+
+/*! Returns a new modification time in ms since epoch. */
+static uint64_t Core_NextMtime()
+{
+    const uint64_t now = uint64_t(QDateTime::currentMSecsSinceEpoch());
+    coreVfsMtime = now > coreVfsMtime ? now : coreVfsMtime + 1;
+    return coreVfsMtime;
+}
+
+/*! Puts the devices/<mac>/.. entry.
+    \returns 1 if it wasn't modified after \p since, nothing is put then
+ */
+static int Core_ReadEntryDevicesReq(struct am_message *m, am_read_entry_req *req, uint64_t since)
 {
 
     uint64_t mac;
@@ -828,13 +977,28 @@ static void Core_ReadEntryDevicesReq(struct am_message *m, am_read_entry_req *re
         mac = U_sstream_get_mac_address(&ss);
 
         if (ss.status != U_SSTREAM_OK)
-            return;
+            return 0;
 
         ni = _apsCtrl->nodeWithMac(mac);
         if (!ni.data)
-            return;
+            return 0;
+    }
+
+    if (req->url_parse.element_count == 3)
+    {
+        am_string prop = AM_UrlElementAt(&req->url_parse, 2);
+        // state isn't listed: wait states are entered and left in zmNode without notify
+        if (prop == "zombie" || prop == "has_source_routes" || prop == "node_desc")
+            mtime = ni.vfsMtime;
+    }
+    else if (req->url_parse.element_count >= 4)
+    {
+        mtime = ni.vfsEndpointsMtime;
     }
 
+    if (mtime != 0 && mtime <= since)
+        return 1;
+
     if (req->url_parse.element_count == 3)
     {
         am_string prop = AM_UrlElementAt(&req->url_parse, 2);
@@ -875,6 +1039,27 @@ static void Core_ReadEntryDevicesReq(struct am_message *m, am_read_entry_req *re
             am->msg_put_u64(m, mtime);
             am->msg_put_u8(m, !ni.data->sourceRoutes().empty() ? 1 : 0);
         }
+        else if (prop == "aps_window")
+        {
+            am->msg_put_cstring(m, "u8");
+            am->msg_put_u32(m, mode);
+            am->msg_put_u64(m, mtime);
+            am->msg_put_u8(m, static_cast<uint8_t>(NI_ApsWindow(&ni, 0)));
+        }
+        else if (prop == "aps_rtt")
+        {
+            am->msg_put_cstring(m, "u16");
+            am->msg_put_u32(m, mode);
+            am->msg_put_u64(m, mtime);
+            am->msg_put_u16(m, ni.aps.srttMs);
+        }
+        else if (prop == "aps_spacing")
+        {
+            am->msg_put_cstring(m, "u16");
+            am->msg_put_u32(m, mode);
+            am->msg_put_u64(m, mtime);
+            am->msg_put_u16(m, ni.aps.spacingMs);
+        }
     }
     else if (req->url_parse.element_count >= 4)
     {
@@ -906,30 +1091,19 @@ static void Core_ReadEntryDevicesReq(struct am_message *m, am_read_entry_req *re
             }
         }
     }
+
+    return 0;
 }
 
-static int CoreAps_ReadEntryRequest(struct am_message *msg)
+/*! Puts type, mode, mtime and value of the entry, nothing if not found.
+    \returns 1 if it wasn't modified after \p since, nothing is put then
+ */
+static int CoreAps_PutEntry(struct am_message *m, am_read_entry_req &req, uint64_t since)
 {
-    struct am_message *m;
-    am_read_entry_req req;
-
-    if (AM_ParseReadEntryRequest(am, msg, &req) != AM_MSG_STATUS_OK)
-        return AM_CB_STATUS_INVALID;
-
     uint32_t mode = VFS_ENTRY_MODE_WRITEABLE;
     uint64_t mtime = 0;
 
-    if (msg->status != AM_MSG_STATUS_OK)
-        return AM_CB_STATUS_INVALID;
-
-    m = am->msg_alloc();
-    if (!m)
-        return AM_CB_STATUS_MESSAGE_ALLOC_FAILED;
-
-    am->msg_put_u16(m, req.tag);
-    am->msg_put_u8(m, AM_RESPONSE_STATUS_OK);
-
-    unsigned empty_pos = m->pos; // to check if entry was put into message
+    MET_Inc(MET_VfsReadEntries);
 
     am_string elem0 = AM_UrlElementAt(&req.url_parse, 0);
 
@@ -940,26 +1114,30 @@ static int CoreAps_ReadEntryRequest(struct am_message *msg)
             am->msg_put_cstring(m, "u64");
             am->msg_put_u32(m, mode);
             am->msg_put_u64(m, mtime);
-            am->msg_put_u64(m, aps_frames_rx);
+            am->msg_put_u64(m, MET_Value(MET_ApsFramesRx));
         }
         else if (elem0 == "frames_tx")
         {
             am->msg_put_cstring(m, "u64");
             am->msg_put_u32(m, mode);
             am->msg_put_u64(m, mtime);
-            am->msg_put_u64(m, aps_frames_tx);
+            am->msg_put_u64(m, MET_Value(MET_ApsFramesTx));
         }
     }
     else if (req.url_parse.element_count >= 2)
     {
         if (elem0 == "devices")
         {
-            Core_ReadEntryDevicesReq(m, &req);
+            return Core_ReadEntryDevicesReq(m, &req, since);
         }
         else if (elem0 == "com")
         {
             if (AM_UrlElementAt(&req.url_parse, 1) == "state")
             {
+                mtime = coreComStateMtime;
+                if (mtime != 0 && mtime <= since)
+                    return 1;
+
                 am->msg_put_cstring(m, "str");
                 am->msg_put_u32(m, VFS_ENTRY_MODE_READONLY);
                 am->msg_put_u64(m, mtime);
@@ -985,6 +1163,22 @@ static int CoreAps_ReadEntryRequest(struct am_message *msg)
                 }
             }
         }
+        else if (elem0 == "metrics")
+        {
+            am_string name = AM_UrlElementAt(&req.url_parse, 1);
+            for (unsigned i = 0; i < MET_IdCount; i++)
+            {
+                const char *metName = MET_Name(MET_Id(i));
+                if (strlen(metName) == name.size && memcmp(metName, name.data, name.size) == 0)
+                {
+                    am->msg_put_cstring(m, "u64");
+                    am->msg_put_u32(m, VFS_ENTRY_MODE_READONLY);
+                    am->msg_put_u64(m, mtime);
+                    am->msg_put_u64(m, MET_Value(MET_Id(i)));
+                    break;
+                }
+            }
+        }
         else if (elem0 == ".actor")
         {
             if (AM_UrlElementAt(&req.url_parse, 1) == "name")
@@ -997,7 +1191,50 @@ static int CoreAps_ReadEntryRequest(struct am_message *msg)
         }
     }
 
-    if (m->pos == empty_pos)
+    return 0;
+}
+
+/*! Handles VFS_M_ID_READ_ENTRY_REQ and VFS_M_ID_READ_ENTRY_IF_MODIFIED_REQ. */
+static int CoreAps_ReadEntryRequest(struct am_message *msg)
+{
+    struct am_message *m;
+    am_read_entry_req req = {};
+    uint64_t since = 0;
+
+    if (msg->id == VFS_M_ID_READ_ENTRY_IF_MODIFIED_REQ)
+    {
+        req.tag = am->msg_get_u16(msg);
+        req.url_parse.url = am->msg_get_string(msg);
+        since = am->msg_get_u64(msg);
+        AM_ParseUrl(&req.url_parse);
+    }
+    else if (AM_ParseReadEntryRequest(am, msg, &req) != AM_MSG_STATUS_OK)
+    {
+        return AM_CB_STATUS_INVALID;
+    }
+
+    if (msg->status != AM_MSG_STATUS_OK)
+        return AM_CB_STATUS_INVALID;
+
+    m = am->msg_alloc();
+    if (!m)
+        return AM_CB_STATUS_MESSAGE_ALLOC_FAILED;
+
+    MET_Inc(MET_VfsReadRequests);
+
+    am->msg_put_u16(m, req.tag);
+    am->msg_put_u8(m, AM_RESPONSE_STATUS_OK);
+
+    unsigned empty_pos = m->pos; // to check if entry was put into message
+
+    if (CoreAps_PutEntry(m, req, since) == 1)
+    {
+        m->pos = 0;
+        am->msg_put_u16(m, req.tag);
+        am->msg_put_u8(m, VFS_RESPONSE_STATUS_NOT_MODIFIED);
+        MET_Inc(MET_VfsNotModified);
+    }
+    else if (m->pos == empty_pos)
     {
         m->pos = 0;
         am->msg_put_u16(m, req.tag);
@@ -1012,6 +1249,77 @@ static int CoreAps_ReadEntryRequest(struct am_message *msg)
     return AM_CB_STATUS_OK;
 }
 
+/*! Batched read of up to VFS_READ_ENTRIES_MAX entries, see vfs_batch.h. */
+static int CoreAps_ReadEntriesRequest(struct am_message *msg)
+{
+    struct am_message *m;
+    am_read_entry_req req = {};
+    unsigned count;
+    unsigned i;
+
+    req.tag = am->msg_get_u16(msg);
+    count = am->msg_get_u16(msg);
+
+    if (msg->status != AM_MSG_STATUS_OK || count > VFS_READ_ENTRIES_MAX)
+        return AM_CB_STATUS_INVALID;
+
+    m = am->msg_alloc();
+    if (!m)
+        return AM_CB_STATUS_MESSAGE_ALLOC_FAILED;
+
+    MET_Inc(MET_VfsReadRequests);
+
+    am->msg_put_u16(m, req.tag);
+    am->msg_put_u8(m, AM_RESPONSE_STATUS_OK);
+    const unsigned count_pos = m->pos;
+    am->msg_put_u16(m, 0); // updated below
+
+    for (i = 0; i < count; i++)
+    {
+        req.url_parse.url = am->msg_get_string(msg);
+        const uint64_t since = am->msg_get_u64(msg);
+        if (msg->status != AM_MSG_STATUS_OK)
+            break;
+
+        AM_ParseUrl(&req.url_parse);
+
+        const unsigned entry_pos = m->pos;
+        am->msg_put_u8(m, AM_RESPONSE_STATUS_OK);
+        const unsigned empty_pos = m->pos;
+
+        if (CoreAps_PutEntry(m, req, since) == 1)
+        {
+            m->pos = entry_pos;
+            am->msg_put_u8(m, VFS_RESPONSE_STATUS_NOT_MODIFIED);
+            MET_Inc(MET_VfsNotModified);
+        }
+        else if (m->pos == empty_pos)
+        {
+            m->pos = entry_pos;
+            am->msg_put_u8(m, AM_RESPONSE_STATUS_NOT_FOUND);
+        }
+
+        if (m->status != AM_MSG_STATUS_OK) // message full, requester asks again for the rest
+        {
+            m->pos = entry_pos;
+            m->status = AM_MSG_STATUS_OK;
+            break;
+        }
+    }
+
+    const unsigned end_pos = m->pos;
+    m->pos = count_pos;
+    am->msg_put_u16(m, i);
+    m->pos = end_pos;
+
+    m->src = msg->dst;
+    m->dst = msg->src;
+    m->id = VFS_M_ID_READ_ENTRIES_RSP;
+    am->send_message(m);
+
+    return AM_CB_STATUS_OK;
+}
+
 // Device notification helpers
 static void Dev_SendNotification(am_msg_id id)
 {
@@ -1073,9 +1381,12 @@ static int CoreNet_MessageCallback(struct am_message *msg)
 
 static int CoreAps_MessageCallback(struct am_message *msg)
 {
-    if (msg->id == VFS_M_ID_READ_ENTRY_REQ)
+    if (msg->id == VFS_M_ID_READ_ENTRY_REQ || msg->id == VFS_M_ID_READ_ENTRY_IF_MODIFIED_REQ)
         return CoreAps_ReadEntryRequest(msg);
 
+    if (msg->id == VFS_M_ID_READ_ENTRIES_REQ)
+        return CoreAps_ReadEntriesRequest(msg);
+
     if (msg->id == VFS_M_ID_LIST_DIR_REQ)
         return CoreAps_ListDirectoryRequest(msg);
 
@@ -1283,18 +1594,24 @@ static int CoreDev_MessageCallback(struct am_message *msg)
     }
 }
 
-void CoreAps_NotifyPathChanged(const char *path)
-{
-    if (!am || !path)
-        return;
-
-    char url[VFS_MAX_URL_LENGTH];
+/*
+ * Change notifications are coalesced per URL and sent with the next main loop
+ * tick, a burst of reports for the same device results in one notification.
+ */
+#define CORE_NOTIFY_MAX_PENDING 64
+#define CORE_NOTIFY_MAX_PATH    48
 
-    U_SStream ss;
-    U_sstream_init(&ss, url, VFS_MAX_URL_LENGTH);
+struct CoreNotifyPending
+{
+    uint64_t mac; // 0 for core_aps paths
+    char path[CORE_NOTIFY_MAX_PATH];
+};
 
-    U_sstream_put_str(&ss, path);
+static CoreNotifyPending coreNotifyPending[CORE_NOTIFY_MAX_PENDING];
+static unsigned coreNotifyPendingCount = 0;
 
+static void CoreAps_SendPathChanged(const char *url)
+{
     struct am_message *m = am->msg_alloc();
     U_ASSERT(m);
     if (!m)
@@ -1307,50 +1624,143 @@ void CoreAps_NotifyPathChanged(const char *path)
     am->msg_put_cstring(m, url);
     am->msg_put_u32(m, flags);
 
+    MET_Inc(MET_VfsNotifySent);
     am->send_message(m);
 }
 
-void CoreNode_NotifyDeviceChanged(uint64_t mac, const char *path)
+static void CoreNode_SendDeviceChanged(uint64_t mac, const char *path)
 {
-    if (!am || !mac || !path)
-        return;
-
     char url[VFS_MAX_URL_LENGTH];
 
     U_SStream ss;
     U_sstream_init(&ss, url, VFS_MAX_URL_LENGTH);
 
-    U_sstream_put_str(&ss, "devices/");
-    U_sstream_put_mac_address(&ss, mac);
-    U_sstream_put_str(&ss, "/");
+    if (mac)
+    {
+        U_sstream_put_str(&ss, "devices/");
+        U_sstream_put_mac_address(&ss, mac);
+        U_sstream_put_str(&ss, "/");
+    }
     U_sstream_put_str(&ss, path);
 
-    CoreAps_NotifyPathChanged(url);
+    CoreAps_SendPathChanged(url);
 }
 
-
-zmController::zmController(zmMaster *master,
-                           zmNetDescriptorModel *networks,
-                           QGraphicsScene *scene,
-                           zmGraphicsView *graph,
-                           QObject *parent) :
-    deCONZ::ApsController(parent),
-    m_master(master),
-    m_scene(scene),
-    m_graph(graph)
+static void Core_FlushChangedNotify()
 {
-    am = AM_ApiFunctions();
-    AM_INIT_ACTOR(&am_actor_core_net, AM_ACTOR_ID_CORE_NET, CoreNet_MessageCallback);
-    AM_INIT_ACTOR(&am_actor_core_aps, AM_ACTOR_ID_CORE_APS, CoreAps_MessageCallback);
-    AM_INIT_ACTOR(&am_actor_core_node, AM_ACTOR_ID_CORE_NODE, CoreNode_MessageCallback);
-    AM_INIT_ACTOR(&am_actor_core_dev, AM_ACTOR_ID_CORE_DEV, CoreDev_MessageCallback);
+    for (unsigned i = 0; i < coreNotifyPendingCount; i++)
+    {
+        CoreNode_SendDeviceChanged(coreNotifyPending[i].mac, coreNotifyPending[i].path);
+    }
 
-    am->register_actor(&am_actor_core_net);
-    am->register_actor(&am_actor_core_aps);
-    am->register_actor(&am_actor_core_node);
-    am->register_actor(&am_actor_core_dev);
+    coreNotifyPendingCount = 0;
+}
 
-    am->subscribe(AM_ACTOR_ID_GUI_NODE, AM_ACTOR_ID_CORE_NODE);
+static void Core_QueueChangedNotify(uint64_t mac, const char *path)
+{
+    const size_t len = strlen(path);
+
+    if (len >= CORE_NOTIFY_MAX_PATH)
+    {
+        CoreNode_SendDeviceChanged(mac, path);
+        return;
+    }
+
+    for (unsigned i = 0; i < coreNotifyPendingCount; i++)
+    {
+        const CoreNotifyPending &p = coreNotifyPending[i];
+        if (p.mac == mac && memcmp(p.path, path, len + 1) == 0)
+        {
+            MET_Inc(MET_VfsNotifyCoalesced);
+            return;
+        }
+    }
+
+    if (coreNotifyPendingCount == CORE_NOTIFY_MAX_PENDING)
+    {
+        Core_FlushChangedNotify();
+    }
+
+    CoreNotifyPending &p = coreNotifyPending[coreNotifyPendingCount];
+    p.mac = mac;
+    memcpy(p.path, path, len + 1);
+    coreNotifyPendingCount++;
+}
+
+void CoreAps_NotifyPathChanged(const char *path)
+{
+    if (!am || !path)
+        return;
+
+    if (strcmp(path, "com/state") == 0)
+        coreComStateMtime = Core_NextMtime();
+
+    Core_QueueChangedNotify(0, path);
+}
+
+void CoreNode_NotifyDeviceChanged(uint64_t mac, const char *path)
+{
+    if (!am || !mac || !path)
+        return;
+
+    if (_apsCtrl)
+        _apsCtrl->nodeModified(mac, path, Core_NextMtime());
+
+    Core_QueueChangedNotify(mac, path);
+}
+
+/*! Adds or updates a source route of \p node.
+
+    All source route changes go through CoreNode_AddSourceRoute() and CoreNode_RemoveSourceRoute()
+    so the has_source_routes mtime is stamped, conditional VFS reads rely on it.
+    \returns the result of zmNode::addSourceRoute(), 0 added, 1 updated
+ */
+int CoreNode_AddSourceRoute(deCONZ::zmNode *node, const deCONZ::SourceRoute &sourceRoute)
+{
+    const int ret = node->addSourceRoute(sourceRoute);
+    if (ret == 0 || ret == 1)
+    {
+        CoreNode_NotifyDeviceChanged(node->address().ext(), "has_source_routes");
+    }
+    return ret;
+}
+
+/*! Removes a source route of \p node, see CoreNode_AddSourceRoute().
+    \returns the result of zmNode::removeSourceRoute(), 0 removed
+ */
+int CoreNode_RemoveSourceRoute(deCONZ::zmNode *node, uint uuidHash)
+{
+    const int ret = node->removeSourceRoute(uuidHash);
+    if (ret == 0)
+    {
+        CoreNode_NotifyDeviceChanged(node->address().ext(), "has_source_routes");
+    }
+    return ret;
+}
+
+
+zmController::zmController(zmMaster *master,
+                           zmNetDescriptorModel *networks,
+                           QGraphicsScene *scene,
+                           zmGraphicsView *graph,
+                           QObject *parent) :
+    deCONZ::ApsController(parent),
+    m_master(master),
+    m_scene(scene),
+    m_graph(graph)
+{
+    am = AM_ApiFunctions();
+    AM_INIT_ACTOR(&am_actor_core_net, AM_ACTOR_ID_CORE_NET, CoreNet_MessageCallback);
+    AM_INIT_ACTOR(&am_actor_core_aps, AM_ACTOR_ID_CORE_APS, CoreAps_MessageCallback);
+    AM_INIT_ACTOR(&am_actor_core_node, AM_ACTOR_ID_CORE_NODE, CoreNode_MessageCallback);
+    AM_INIT_ACTOR(&am_actor_core_dev, AM_ACTOR_ID_CORE_DEV, CoreDev_MessageCallback);
+
+    am->register_actor(&am_actor_core_net);
+    am->register_actor(&am_actor_core_aps);
+    am->register_actor(&am_actor_core_node);
+    am->register_actor(&am_actor_core_dev);
+
+    am->subscribe(AM_ACTOR_ID_GUI_NODE, AM_ACTOR_ID_CORE_NODE);
     am->subscribe(AM_ACTOR_ID_CORE_DEV, AM_ACTOR_ID_GUI_MAINWINDOW);
 
 #if 0
@@ -1411,7 +1821,6 @@ zmController::zmController(zmMaster *master,
     deCONZ::ZclDataBase *zclDb = deCONZ::zclDataBase();
     Q_UNUSED(zclDb);
 
-    m_fetchCurNode = 0;
     m_linkViewMode = LinkShowLqi;
 
     m_netConfigTimer = new QTimer(this);
@@ -1453,13 +1862,16 @@ zmController::zmController(zmMaster *master,
             this, SLOT(sendNext()));
 
     m_readParamTimer = new QTimer(this);
-    m_readParamTimer->setInterval(60 * 1000);
+    m_readParamTimer->setInterval(PARAM_REFRESH_INTERVAL);
     m_readParamTimer->setSingleShot(false);
     connect(m_readParamTimer, SIGNAL(timeout()),
             this, SLOT(readParamTimerFired()));
     m_readParamTimer->start();
 
     m_maxBusyApsPerNode = 2;
+    m_apsInteractiveDeadline = deCONZ::TimeMs{deCONZ::appArgumentNumeric("--aps-interactive-deadline", 0)};
+    m_discoveryRate = qMax(1, int(deCONZ::appArgumentNumeric("--discovery-rate", m_discoveryRate)));
+    m_topologyParallel = qMax(1, int(deCONZ::appArgumentNumeric("--topology-parallel", m_topologyParallel)));
 
     m_autoFetch = true;
     m_autoFetchFFD = true;
@@ -1468,7 +1880,6 @@ zmController::zmController(zmMaster *master,
     m_genSequenceNumber = 0;
     m_linkIter = 0;
     m_neibIter = 0;
-    m_nodeZombieIter = 0;
     m_zombieCount = 0;
     m_zombieDelay = 0;
     m_timer = startTimer(TickMs);
@@ -1529,10 +1940,12 @@ zmController::zmController(zmMaster *master,
             this, SLOT(appAboutToQuit()));
 
     _apsCtrl = this;
+    deCONZ::setFetchChangedCallback(NI_FetchChanged);
 }
 
 zmController::~zmController()
 {
+    deCONZ::setFetchChangedCallback(nullptr);
     closeDb();
 
     deCONZ::ZclDataBase *zclDb = deCONZ::zclDataBase();
@@ -1578,6 +1991,24 @@ NodeInfo zmController::nodeWithMac(uint64_t mac)
     return {};
 }
 
+/*! Sets the VFS mtime of node entries, an empty \p path means all entries. */
+void zmController::nodeModified(uint64_t mac, const char *path, uint64_t mtime)
+{
+    deCONZ::Address addr;
+    addr.setExt(mac);
+    NodeInfo *ni = getNode(addr, deCONZ::ExtAddress);
+    if (!ni || !ni->isValid())
+        return;
+
+    const bool endpoints = strcmp(path, "endpoints") == 0;
+
+    if (endpoints || path[0] == '\0')
+        ni->vfsEndpointsMtime = mtime;
+
+    if (!endpoints)
+        ni->vfsMtime = mtime;
+}
+
 static bool isValidMacAddress(uint64_t mac)
 {
     return (mac & uint64_t(0xffffff)) != 0;
@@ -1627,7 +2058,10 @@ void zmController::setEndpointConfig(uint8_t index, const deCONZ::SimpleDescript
             m_nodes[0].data->setFetched(deCONZ::ReqSimpleDescriptor, false);
             m_nodes[0].data->resetItem(deCONZ::ReqActiveEndpoints);
             m_nodes[0].data->resetItem(deCONZ::ReqSimpleDescriptor);
-            m_nodes[0].g->updated(deCONZ::ReqSimpleDescriptor);
+            if (m_nodes[0].g)
+            {
+                m_nodes[0].g->updated(deCONZ::ReqSimpleDescriptor);
+            }
         }
     }
 }
@@ -1852,10 +2286,12 @@ void zmController::timerEvent(QTimerEvent *event)
 {
     if (event->timerId() == m_timer)
     {
+        EVM_Scope evm("zmController::tick");
         tick();
     }
     else if (event->timerId() == m_timeoutTimer)
     {
+        EVM_Scope evm("zmController::timeoutTick");
         timeoutTick();
     }
 }
@@ -1978,7 +2414,7 @@ void zmController::checkBindingLink(const deCONZ::Binding &binding)
         dstNode = getNode(binding.dstAddress(), deCONZ::ExtAddress);
     }
 
-    if (!srcNode || !dstNode)
+    if (!srcNode || !dstNode || !srcNode->g || !dstNode->g)
     {
         return;
     }
@@ -2037,13 +2473,13 @@ void zmController::removeBindingLink(const Binding &binding)
                 addr.setExt(binding.srcAddress());
 
                 NodeInfo *node1 = getNode(addr, deCONZ::ExtAddress);
-                if (node1)
+                if (node1 && node1->g)
                 {
                     node1->g->remLink(i->link);
                 }
 
                 node1 = getNode(binding.dstAddress(), deCONZ::ExtAddress);
-                if (node1)
+                if (node1 && node1->g)
                 {
                     node1->g->remLink(i->link);
                 }
@@ -2389,12 +2825,15 @@ void zmController::readParameterResponse(ZM_State_t status, ZM_DataId_t id, cons
                 node->data->setFetched(deCONZ::ReqActiveEndpoints, false);
                 node->data->setFetched(deCONZ::ReqSimpleDescriptor, false);
                 node->data->touch(m_steadyTimeRef);
-                node->g->setLastSeen(m_steadyTimeRef.ref);
                 checkAddressChange(node->data->address());
 
-                node->g->setAddress(addr2.nwk(), addr2.ext());
-                node->g->setDeviceType(node->data->deviceType());
-                node->g->requestUpdate();
+                if (node->g)
+                {
+                    node->g->setLastSeen(m_steadyTimeRef.ref);
+                    node->g->setAddress(addr2.nwk(), addr2.ext());
+                    node->g->setDeviceType(node->data->deviceType());
+                    node->g->requestUpdate();
+                }
 
                 if (node != &m_nodes[0])
                 {
@@ -2405,20 +2844,23 @@ void zmController::readParameterResponse(ZM_State_t status, ZM_DataId_t id, cons
 
                 if (macAddrChanged)
                 {
-                    emit nodeEvent(NodeEvent(NodeEvent::UpdatedNodeAddress, node->data));
+                    dispatchNodeEvent(NodeEvent(NodeEvent::UpdatedNodeAddress, node->data));
                 }
             }
 
-            m_graph->fitInView(m_scene->itemsBoundingRect().adjusted(-20, -20, 20, 20), Qt::KeepAspectRatio);
+            if (!gHeadlessVersion)
+            {
+                m_graph->fitInView(m_scene->itemsBoundingRect().adjusted(-20, -20, 20, 20), Qt::KeepAspectRatio);
+            }
 
             for (auto &node2 : m_nodes) // hide other coordinator nodes if present
             {
-                if (node2.data && node2.g &&
+                if (node2.data &&
                     node2.data->address().nwk() == 0x0000 &&
                     node2.data->nodeDescriptor().deviceType() == deCONZ::Coordinator &&
                     node2.data->address().ext() != u64)
                 {
-                    node2.g->hide();
+                    NI_SetVisible(&node2, false);
                     deleteNode(&node2, NodeRemoveZombie);
                 }
             }
@@ -2500,7 +2942,7 @@ void zmController::readParameterResponse(ZM_State_t status, ZM_DataId_t id, cons
         {
             auto *node = getNode(net.ownAddress(), deCONZ::ExtAddress);
 
-            if (node && node->data && node->g)
+            if (node && node->data)
             {
                 if (net.deviceType() == deCONZ::Coordinator && node->data->address().nwk() != 0x0000)
                 {
@@ -2509,8 +2951,11 @@ void zmController::readParameterResponse(ZM_State_t status, ZM_DataId_t id, cons
                     {
                         addr.setNwk(0x0000);
                         node->data->setAddress(addr);
-                        node->g->setAddress(addr.nwk(), addr.ext());
-                        node->g->requestUpdate();
+                        if (node->g)
+                        {
+                            node->g->setAddress(addr.nwk(), addr.ext());
+                            node->g->requestUpdate();
+                        }
                     }
                 }
             }
@@ -3545,6 +3990,7 @@ QVariantMap zmController::getParameter(VariantMapParameter parameter, int index)
 void zmController::addSourceRoute(const std::vector<zmgNode *> gnodes)
 {
     Q_ASSERT(gnodes.size() >= 3);
+    Q_ASSERT(m_nodes.front().g);
     Q_ASSERT(gnodes.front() == m_nodes.front().g);
 
     std::vector<Address> hops;
@@ -3560,31 +4006,27 @@ void zmController::addSourceRoute(const std::vector<zmgNode *> gnodes)
     while (!dest->data()->sourceRoutes().empty())
     {
         const auto sr = dest->data()->sourceRoutes().back();
-        dest->data()->removeSourceRoute(sr.uuidHash());
+        CoreNode_RemoveSourceRoute(dest->data(), sr.uuidHash());
         emit sourceRouteDeleted(sr.uuid());
     }
 
-    CoreNode_NotifyDeviceChanged(dest->data()->address().ext(), "has_source_routes");
-
     SourceRoute sr(createUuid(QLatin1String("user-")), 0, hops);
     for (size_t i = 0; i < sr.hops().size(); i++)
     {
         sr.m_hopLqi[i] = 200; // initial to work
     }
-    const auto ret = dest->data()->addSourceRoute(sr);
+    const auto ret = CoreNode_AddSourceRoute(dest->data(), sr);
 
     if (ret == 0)
     {
         DBG_Printf(DBG_INFO, "source route added to %s\n", dest->data()->extAddressString().c_str());
         m_routes.push_back(sr);
         emit sourceRouteChanged(sr);
-        CoreNode_NotifyDeviceChanged(dest->data()->address().ext(), "has_source_routes");
     }
     else if (ret == 1)
     {
         DBG_Printf(DBG_INFO, "source route updated for %s\n", dest->data()->extAddressString().c_str());
         emit sourceRouteChanged(sr);
-        CoreNode_NotifyDeviceChanged(dest->data()->address().ext(), "has_source_routes");
     }
     else
     {
@@ -3594,7 +4036,6 @@ void zmController::addSourceRoute(const std::vector<zmgNode *> gnodes)
     if (ret == 0 || ret == 1)
     {
         emit sourceRouteCreated(sr);
-        CoreNode_NotifyDeviceChanged(dest->data()->address().ext(), "has_source_routes");
     }
 }
 
@@ -3613,10 +4054,9 @@ void zmController::removeSourceRoute(zmgNode *gnode)
     QString uuid = gnode->data()->sourceRoutes().front().uuid();
     uint srHash = gnode->data()->sourceRoutes().front().uuidHash();
 
-    if (gnode->data()->removeSourceRoute(srHash) == 0)
+    if (CoreNode_RemoveSourceRoute(gnode->data(), srHash) == 0)
     {
         emit sourceRouteDeleted(uuid);
-        CoreNode_NotifyDeviceChanged(gnode->data()->address().ext(), "has_source_routes");
     }
     else
     {
@@ -3650,7 +4090,7 @@ void zmController::activateSourceRoute(const SourceRoute &sourceRoute)
 
         if (dest->data->sourceRoutes().empty())
         {
-           dest->data->addSourceRoute(*sr);
+           CoreNode_AddSourceRoute(dest->data, *sr);
            emit sourceRouteChanged(*sr);
         }
     }
@@ -3667,6 +4107,8 @@ void zmController::addBinding(const Binding &binding)
     {
         if (node->data->bindingTable().add(binding))
         {
+            node->bindingRefresh = {}; // confirm the new binding with the next report, see NI_BindingRefreshDue()
+
             if (binding.dstAddress().hasExt())
             {
                 const auto i = std::find(m_bindLinkQueue.cbegin(), m_bindLinkQueue.cend(), addr);
@@ -4254,8 +4696,18 @@ int zmController::apsdeDataRequest(const deCONZ::ApsDataRequest &req)
     {
         m_steadyTimeRef = deCONZ::steadyTimeRef();
         m_apsRequestQueue.push_back(req);
+        m_apsRequestMeta.emplace_back();
         auto &req2 = m_apsRequestQueue.back();
 
+        ApsRequestMeta &meta = m_apsRequestMeta.back();
+        meta.prio = APS_PriorityClass(req2);
+        meta.enqueued = m_steadyTimeRef;
+
+        if (meta.prio == ApsPrioInteractive && m_apsInteractiveDeadline.val > 0)
+        {
+            meta.deadline = m_steadyTimeRef + m_apsInteractiveDeadline;
+        }
+
         if (req.clusterId() == 0x0019 && req.asdu().length() > 3 && req.asdu().at(2) == 0x05) // treat OTA img block response as high priority
         {
             m_otauActivity = (3000 / TickMs);
@@ -4292,6 +4744,35 @@ int zmController::apsdeDataRequest(const deCONZ::ApsDataRequest &req)
     return deCONZ::ErrorNotConnected;
 }
 
+/*! Sets the maximum time a queued request may wait before it is sent.
+
+    If it isn't sent until then, it is dropped and confirmed with MAC transaction expired status.
+    \returns false if no request with \p id is waiting in the queue
+ */
+bool zmController::setApsRequestDeadline(uint8_t id, deCONZ::TimeMs maxDelay)
+{
+    const auto i = std::find_if(m_apsRequestQueue.cbegin(), m_apsRequestQueue.cend(), [id](const deCONZ::ApsDataRequest &x) {
+        return x.id() == id && x.state() == deCONZ::IdleState;
+    });
+
+    if (i == m_apsRequestQueue.cend())
+    {
+        return false;
+    }
+
+    ApsRequestMeta &meta = apsRequestMeta(i);
+    meta.deadline = maxDelay.val > 0 ? meta.enqueued + maxDelay : deCONZ::SteadyTimeRef{};
+    return true;
+}
+
+/*! Removes a request and its scheduling data from the queue. */
+std::vector<deCONZ::ApsDataRequest>::iterator zmController::eraseApsRequest(std::vector<deCONZ::ApsDataRequest>::iterator i)
+{
+    U_ASSERT(m_apsRequestMeta.size() == m_apsRequestQueue.size());
+    m_apsRequestMeta.erase(m_apsRequestMeta.begin() + (i - m_apsRequestQueue.begin()));
+    return m_apsRequestQueue.erase(i);
+}
+
 int zmController::checkIdOverFlowApsDataRequest(const deCONZ::ApsDataRequest &req)
 {
     auto i = std::find_if(m_apsRequestQueue.cbegin(), m_apsRequestQueue.cend(), [req](const deCONZ::ApsDataRequest &x) {
@@ -4306,6 +4787,8 @@ int zmController::checkIdOverFlowApsDataRequest(const deCONZ::ApsDataRequest &re
  */
 void zmController::apsdeDataRequestDone(uint8_t id, uint8_t status)
 {
+    unsigned match = 0;
+
     switch (status)
     {
     case ZM_STATE_SUCCESS:
@@ -4317,6 +4800,7 @@ void zmController::apsdeDataRequestDone(uint8_t id, uint8_t status)
     {
         if (status == ZM_STATE_BUSY)
         {
+            MET_Inc(MET_ApsBusyStatus);
             m_apsBusyCounter++;
             DBG_Printf(DBG_APS, "APS-DATA.request id: %u, status: BUSY (counter: %d)\n", id, m_apsBusyCounter);
 
@@ -4341,11 +4825,14 @@ void zmController::apsdeDataRequestDone(uint8_t id, uint8_t status)
 
         if (apsdeDataRequestQueueSetStatus(id, deCONZ::FailureState))
         {
+            match = 1;
             emitApsDataConfirm(id, deCONZ::ApsTableFullStatus);
         }
     }
         break;
     }
+
+    CAP_RecordResult(CAP_ResultRequestDone, id, status, match, match ? deCONZ::FailureState : -1);
 }
 
 bool zmController::apsdeDataRequestQueueSetStatus(int id, deCONZ::CommonState state)
@@ -4371,6 +4858,7 @@ bool zmController::apsdeDataRequestQueueSetStatus(int id, deCONZ::CommonState st
  */
 void zmController::onApsdeDataConfirm(const deCONZ::ApsDataConfirm &confirm)
 {
+    EVM_Scope evm("zmController::onApsdeDataConfirm");
     m_steadyTimeRef = deCONZ::steadyTimeRef();
     emit apsdeDataConfirm(confirm);
 
@@ -4386,8 +4874,19 @@ void zmController::onApsdeDataConfirm(const deCONZ::ApsDataConfirm &confirm)
     m_nodes[0].data->touch(m_steadyTimeRef);
 
     uint match = 0;
+    int matchState = -1;
     DBG_Printf(DBG_APS, "APS-DATA.confirm id: %u, status: 0x%02X %s\n", confirm.id(), confirm.status(), deCONZ::ApsStatusToString(confirm.status()));
 
+    MET_Inc(MET_ApsConfirms);
+    if (confirm.status() == deCONZ::ApsNoAckStatus)
+    {
+        MET_Inc(MET_ApsNoAck);
+    }
+    else if (confirm.status() == deCONZ::MacNoAckStatus)
+    {
+        MET_Inc(MET_MacNoAck);
+    }
+
     if (confirm.status() != deCONZ::ZdpSuccess && confirm.dstEndpoint() == ZDO_ENDPOINT)
     {
         for (FastDiscover &fd : m_fastDiscover)
@@ -4439,6 +4938,12 @@ void zmController::onApsdeDataConfirm(const deCONZ::ApsDataConfirm &confirm)
                 match++;
                 i->setConfirmed(true);
 
+                const uint64_t sentUs = apsRequestMeta(i).sentUs;
+                if (sentUs != 0)
+                {
+                    MET_Observe(MET_ApsConfirmLatency, MET_TimeUs() - sentUs);
+                }
+
                 if (confirm.dstAddress().isNwkBroadcast() &&
                     i->profileId() == ZDP_PROFILE_ID && (i->clusterId() == ZDP_NWK_ADDR_CLID))
                 {
@@ -4452,6 +4957,8 @@ void zmController::onApsdeDataConfirm(const deCONZ::ApsDataConfirm &confirm)
 
                 if (node && node->data)
                 {
+                    NI_ApsConfirmed(node, (m_steadyTimeRef - i->timeout()).val, confirm.status(), m_maxBusyApsPerNode);
+
                     switch (confirm.status())
                     {
                     case deCONZ::ApsSuccessStatus:
@@ -4460,7 +4967,10 @@ void zmController::onApsdeDataConfirm(const deCONZ::ApsDataConfirm &confirm)
 
                         if (i->txOptions() & ApsTxAcknowledgedTransmission)
                         {
-                            node->g->setLastSeen(m_steadyTimeRef.ref);
+                            if (node->g)
+                            {
+                                node->g->setLastSeen(m_steadyTimeRef.ref);
+                            }
                             node->data->touch(m_steadyTimeRef);
                             node->data->resetRecErrors();
                         }
@@ -4574,12 +5084,13 @@ void zmController::onApsdeDataConfirm(const deCONZ::ApsDataConfirm &confirm)
 
                 if (confirm.status() != deCONZ::ApsSuccessStatus)
                 {
-                    m_apsRequestQueue.erase(i);
+                    eraseApsRequest(i);
+                    matchState = deCONZ::FailureState;
                     indication = deCONZ::IndicateError;
                 }
                 else
                 {
-                    aps_frames_tx++;
+                    MET_Inc(MET_ApsFramesTx);
 
                     if (i->dstAddress().isNwkBroadcast() || i->dstAddress().hasGroup())
                     {
@@ -4620,6 +5131,7 @@ void zmController::onApsdeDataConfirm(const deCONZ::ApsDataConfirm &confirm)
                         DBG_Printf(DBG_APS, "APS-DATA.confirm request id: %d -> erase from queue\n", i->id());
                         i->setState(FinishState);
                     }
+                    matchState = i->state();
                     indication = deCONZ::IndicateSendDone;
                 }
                 break;
@@ -4632,6 +5144,8 @@ void zmController::onApsdeDataConfirm(const deCONZ::ApsDataConfirm &confirm)
         DBG_Printf(DBG_APS, "APS-DATA.confirm id: %u, status: 0x%02X, match: %u\n", confirm.id(), confirm.status(), match);
     }
 
+    CAP_RecordResult(CAP_ResultConfirm, confirm.id(), confirm.status(), match, matchState);
+
     sendNext();
 
     visualizeNodeIndication(node, indication);
@@ -4757,7 +5271,7 @@ static deCONZ::ZclCluster *addMissingCluster(NodeInfo *node, SimpleDescriptor *s
     auto *ctrl = deCONZ::controller();
 
     NodeEvent event(NodeEvent::UpdatedSimpleDescriptor, node->data, sd->endpoint());
-    emit ctrl->nodeEvent(event);
+    ctrl->dispatchNodeEvent(event);
 
     return result;
 }
@@ -4768,8 +5282,9 @@ static deCONZ::ZclCluster *addMissingCluster(NodeInfo *node, SimpleDescriptor *s
 void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
 {
     using namespace deCONZ;
+    EVM_Scope evm("zmController::onApsdeDataIndication");
 
-    aps_frames_rx++;
+    MET_Inc(MET_ApsFramesRx);
 
     if (m_nodes.empty())
     {
@@ -4908,7 +5423,7 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                         sourceRoute->incrementTxOk();
                         if (sourceRoute->txOk() == 1)
                         {
-                            node->data->addSourceRoute(*sourceRoute);
+                            CoreNode_AddSourceRoute(node->data, *sourceRoute);
                             onSourceRouteChanged(*sourceRoute);
                         }
 
@@ -5063,7 +5578,7 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
             else
             {
                 DBG_Printf(DBG_APS, "APS-DATA.request id: %d erase from queue\n", i->id());
-                i = m_apsRequestQueue.erase(i);
+                i = eraseApsRequest(i);
             }
         }
         else
@@ -5184,7 +5699,7 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
 
                 checkDeviceAnnce(addr, cap);
 
-                if (node && node->data && node->g)
+                if (node && node->data)
                 {
                     node->data->setMacCapabilities(cap);
                     node->data->touch(m_steadyTimeRef);
@@ -5336,12 +5851,15 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                         node->data->setNodeDescriptor(nd);
                         node->data->setMacCapabilities(nd.macCapabilities());
                         node->data->setFetched(ReqNodeDescriptor, true);
-                        node->g->setDeviceType(node->data->deviceType());
-                        node->g->requestUpdate(); // redraw
+                        if (node->g)
+                        {
+                            node->g->setDeviceType(node->data->deviceType());
+                            node->g->requestUpdate(); // redraw
+                        }
                         CoreNode_NotifyDeviceChanged(node->data->address().ext(), "node_desc");
 
                         NodeEvent event(NodeEvent::UpdatedNodeDescriptor, node->data);
-                        emit nodeEvent(event);
+                        dispatchNodeEvent(event);
                     }
                 }
             }
@@ -5370,10 +5888,13 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                     arr.remove(0, 4); // seq, status, nwk
                     node->data->setPowerDescriptor(arr);
                     node->data->setFetched(deCONZ::ReqPowerDescriptor, true);
-                    node->g->requestUpdate(); // redraw
+                    if (node->g)
+                    {
+                        node->g->requestUpdate(); // redraw
+                    }
 
                     NodeEvent event(NodeEvent::UpdatedPowerDescriptor, node->data);
-                    emit nodeEvent(event);
+                    dispatchNodeEvent(event);
                 }
             }
             else
@@ -5423,7 +5944,10 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
 
                 if (sd.isValid() && node->data->setSimpleDescriptor(sd))
                 {
-                    node->g->updated(deCONZ::ReqSimpleDescriptor);
+                    if (node->g)
+                    {
+                        node->g->updated(deCONZ::ReqSimpleDescriptor);
+                    }
                     queueSaveNodesState();
                 }
                 if (node->data->getNextUnfetchedEndpoint() == -1)
@@ -5434,7 +5958,7 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                 if (sd.isValid())
                 {
                     NodeEvent event(NodeEvent::UpdatedSimpleDescriptor, node->data, sd.endpoint(), ind.profileId(), ind.clusterId());
-                    emit nodeEvent(event);
+                    dispatchNodeEvent(event);
                 }
             }
             else if (status == deCONZ::ZdpNotActive)
@@ -5511,9 +6035,12 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                             }
                         }
 
-                        node->g->updated(deCONZ::ReqSimpleDescriptor);
+                        if (node->g)
+                        {
+                            node->g->updated(deCONZ::ReqSimpleDescriptor);
+                        }
                         NodeEvent event(NodeEvent::UpdatedClusterData, node->data, ind);
-                        emit nodeEvent(event);
+                        dispatchNodeEvent(event);
                     }
 
                     node->data->setActiveEndpoints(activeEndpoints);
@@ -5543,6 +6070,10 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
         {
             if (status != deCONZ::ZdpSuccess)
             {
+                if (node && node->data)
+                {
+                    topologyScanPage(node, TopoScanRtg, true); // likely not supported
+                }
                 return;
             }
 
@@ -5561,7 +6092,7 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
 
             DBG_Printf(DBG_ZDP, "ZDP Mgmt_Rtg_rsp zdpSeq: %u from %s total: %u, startIndex: %u, listCount: %u\n", seqNum, srcAddrStr, rtgEntries, startIndex, rtgListCount);
 
-            if (!node || !node->g || !node->data)
+            if (!node || !node->data)
             {
                 DBG_Printf(DBG_ZDP, "\tno NodeInfo found, abort\n");
                 return;
@@ -5606,9 +6137,9 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                 deCONZ::Address dstAddr;
                 dstAddr.setNwk(e.nextHopAddress);
                 NodeInfo *nextHop = getNode(dstAddr, deCONZ::NwkAddress);
-                if (!nextHop || !nextHop->g)
+                if (!nextHop || !nextHop->g || !node->g)
                 {
-                    continue; // node not known
+                    continue; // node not known or no graphics in headless mode
                 }
 
                 NodeSocket *nodeSock = node->g->socket(zmgNode::NeighborSocket);
@@ -5649,9 +6180,14 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                 }
             }
 
-            if ((startIndex + rtgListCount) < rtgEntries)
+            if ((startIndex + rtgListCount) < rtgEntries && rtgListCount > 0)
             {
                 sendMgtmRtgRequest(node, startIndex + rtgListCount);
+                topologyScanPage(node, TopoScanRtg, false);
+            }
+            else
+            {
+                topologyScanPage(node, TopoScanRtg, true);
             }
         }
             break;
@@ -5682,6 +6218,7 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                     // finish
                     node->data->setFetched(deCONZ::ReqMgmtLqi, true);
                     node->data->setMgmtLqiStartIndex(0x00);
+                    topologyScanPage(node, TopoScanLqi, true);
 
                     if (permitJoin == 0)
                     {
@@ -5692,11 +6229,8 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                 {
                     // next entries
                     node->data->setMgmtLqiStartIndex(node->data->mgmtLqiStartIndex() + listCount);
-                    node->data->setFetched(deCONZ::ReqMgmtLqi, false);
-                    if (m_lqiIter > 0)
-                    {
-                        m_lqiIter--; // select same node again
-                    }
+                    node->data->setFetched(deCONZ::ReqMgmtLqi, false); // select same node again
+                    topologyScanPage(node, TopoScanLqi, false);
                     // fast query of next items
                     if (permitJoin == 0)
                     {
@@ -5895,7 +6429,7 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                 }
 
                 NodeEvent event(NodeEvent::UpdatedClusterData, node->data, ind);
-                emit nodeEvent(event);
+                dispatchNodeEvent(event);
             }
             else
             {
@@ -5973,6 +6507,8 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                     bindingTable.clearOldBindings();
                 }
 
+                node->bindingRefresh = {}; // the table changed, see NI_BindingRefreshDue()
+
                 node->data->setFetched(deCONZ::ReqMgmtBind, true);
             }
         }
@@ -6061,9 +6597,12 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
 
                         node->data->setUserDescriptor(buf);
                         node->data->setFetched(deCONZ::ReqUserDescriptor, true);
-                        node->g->requestUpdate(); // redraw
+                        if (node->g)
+                        {
+                            node->g->requestUpdate(); // redraw
+                        }
                         NodeEvent event(NodeEvent::UpdatedUserDescriptor, node->data);
-                        emit nodeEvent(event);
+                        dispatchNodeEvent(event);
                     }
                 }
             }
@@ -6090,7 +6629,10 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                 if (status == deCONZ::ZdpSuccess)
                 {
                     node->data->setFetched(deCONZ::ReqUserDescriptor, false);
-                    node->g->updated(deCONZ::ReqUserDescriptor);
+                    if (node->g)
+                    {
+                        node->g->updated(deCONZ::ReqUserDescriptor);
+                    }
                 }
             }
         }
@@ -6171,7 +6713,7 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
 
                     deCONZ::bindDropBox()->bindCallback(bindReq);
                     NodeEvent event(NodeEvent::UpdatedClusterData, node->data, ind);
-                    emit nodeEvent(event);
+                    dispatchNodeEvent(event);
                 }
                 */
             }
@@ -6286,7 +6828,7 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                 zclReadAttributesResponse(node, ind, zclFrame, event);
                 deCONZ::clusterInfo()->zclCommandResponse(ind, zclFrame);
                 indication = deCONZ::IndicateDataUpdate;
-                emit nodeEvent(event);
+                dispatchNodeEvent(event);
             }
             break;
 
@@ -6298,7 +6840,7 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
                     zclReportAttributesIndication(node, ind, zclFrame, event);
                     deCONZ::clusterInfo()->zclCommandResponse(ind, zclFrame);
                     indication = deCONZ::IndicateDataUpdate;
-                    emit nodeEvent(event);
+                    dispatchNodeEvent(event);
                 }
             }
             break;
@@ -6362,7 +6904,7 @@ void zmController::onApsdeDataIndication(const deCONZ::ApsDataIndication &ind)
     }
 
     visualizeNodeIndication(node, indication);
-    emit apsdeDataIndication(ind);
+    dispatchApsIndication(ind);
 
     if (!sendNextApsdeDataRequest(node))
     {
@@ -6388,7 +6930,7 @@ void zmController::onRestNodeUpdated(quint64 extAddress, const QString &item, co
     deCONZ::Address addr;
     addr.setExt(extAddress);
     NodeInfo *node = getNode(addr, deCONZ::ExtAddress);
-    if (!node || !node->data || !node->g)
+    if (!node || !node->data)
     {
         return;
     }
@@ -6397,7 +6939,11 @@ void zmController::onRestNodeUpdated(quint64 extAddress, const QString &item, co
 
     if (item == QLatin1String("name"))
     {
-        if (node->g->name() != value)
+        if (!node->g)
+        {
+            deCONZ::nodeModel()->setData(extAddress, NodeModel::NameColumn, value);
+        }
+        else if (node->g->name() != value)
         {
             node->g->setName(value);
             deCONZ::nodeModel()->setData(extAddress, NodeModel::NameColumn, value);
@@ -6441,7 +6987,10 @@ void zmController::onRestNodeUpdated(quint64 extAddress, const QString &item, co
         if (ok && bat >= 0 && bat <= 100 && node->data->battery() != bat)
         {
             node->data->setBattery(bat);
-            node->g->setBattery(bat);
+            if (node->g)
+            {
+                node->g->setBattery(bat);
+            }
             needRedraw = true;
         }
     }
@@ -6449,7 +6998,10 @@ void zmController::onRestNodeUpdated(quint64 extAddress, const QString &item, co
     if (needRedraw)
     {
         node->data->setNeedRedraw(false);
-        node->g->requestUpdate();
+        if (node->g)
+        {
+            node->g->requestUpdate();
+        }
     }
 }
 
@@ -6526,7 +7078,6 @@ NodeInfo zmController::createNode(const Address &addr, deCONZ::MacCapabilities m
     }
 
     info.data = new deCONZ::zmNode(macCapabilities);
-    info.g = new zmgNode(info.data, nullptr);
 
     info.id = m_nodes.size() + 1;
 
@@ -6537,13 +7088,24 @@ NodeInfo zmController::createNode(const Address &addr, deCONZ::MacCapabilities m
     p.setX((r & 1) ? r : -r);
     r = (r0 % 140);
     p.setY((r & 1) ? r : -r);
-    info.g->setPos(p);
-    info.g->setNeedSaveToDatabase(true);
-    queueSaveNodesState();
+    info.pos = p;
 
     info.data->setAddress(addr);
-    info.g->setAddress(addr.nwk(), addr.ext());
-    info.g->setDeviceType(info.data->deviceType());
+
+    if (!gHeadlessVersion)
+    {
+        info.g = new zmgNode(info.data, nullptr);
+        info.g->setPos(p);
+        info.g->setNeedSaveToDatabase(true);
+        info.g->setAddress(addr.nwk(), addr.ext());
+        info.g->setDeviceType(info.data->deviceType());
+    }
+    else
+    {
+        info.needSaveToDatabase = true;
+    }
+
+    queueSaveNodesState();
 
     // XBees don't provide a user descriptor, at least we could show a human readable "XBee"
     if ((info.data->address().ext() & 0x0013a20000000000LLU) == 0x0013a20000000000LLU)
@@ -6551,14 +7113,19 @@ NodeInfo zmController::createNode(const Address &addr, deCONZ::MacCapabilities m
         info.data->setUserDescriptor("XBee");
     }
 
-    info.g->updated(deCONZ::ReqSimpleDescriptor);
-    m_nodes.push_back(info);
-    if (!info.g->scene())
+    if (info.g)
     {
-        m_scene->addItem(info.g);
+        info.g->updated(deCONZ::ReqSimpleDescriptor);
+        if (!info.g->scene())
+        {
+            m_scene->addItem(info.g);
+        }
+        info.g->show();
+        info.g->requestUpdate();
     }
-    info.g->show();
-    info.g->requestUpdate();
+
+    m_nodes.push_back(info);
+    scheduleNodeDiscovery(&m_nodes.back());
 
     if (addr.hasExt() && (addr.ext() != 0))
     {
@@ -6575,18 +7142,18 @@ NodeInfo zmController::createNode(const Address &addr, deCONZ::MacCapabilities m
     info.id = m_nodes.size();
     deCONZ::nodeModel()->addNode(addr.ext(), addr.nwk());
     NodeEvent event(NodeEvent::NodeAdded, info.data);
-    emit nodeEvent(event);
+    dispatchNodeEvent(event);
 
     if (!info.data->nodeDescriptor().isNull())
     {
         NodeEvent event(NodeEvent::UpdatedNodeDescriptor, info.data, ZDO_ENDPOINT, ZDP_PROFILE_ID, ZDP_NODE_DESCRIPTOR_CLID);
-        emit nodeEvent(event);
+        dispatchNodeEvent(event);
     }
 
     if (info.data->powerDescriptor().isValid())
     {
         NodeEvent event(NodeEvent::UpdatedPowerDescriptor, info.data, ZDO_ENDPOINT, ZDP_PROFILE_ID, ZDP_POWER_DESCRIPTOR_CLID);
-        emit nodeEvent(event);
+        dispatchNodeEvent(event);
     }
 
     if (!info.data->simpleDescriptors().empty())
@@ -6594,11 +7161,11 @@ NodeInfo zmController::createNode(const Address &addr, deCONZ::MacCapabilities m
         for (const auto &sd : info.data->simpleDescriptors())
         {
             NodeEvent event(NodeEvent::UpdatedSimpleDescriptor, info.data, sd.endpoint());
-            emit nodeEvent(event);
+            dispatchNodeEvent(event);
         }
     }
 
-    if (m_nodes.size() == 1)
+    if (m_nodes.size() == 1 && info.g)
     {
         m_graph->ensureVisible(info.g, 250, 250);
     }
@@ -6677,15 +7244,12 @@ void zmController::deleteNode(NodeInfo *node, NodeRemoveMode finally)
                     }
                 }
 
-                if (cpy.g)
-                {
-                    cpy.g->hide();
-                }
+                NI_SetVisible(&*i, false);
 
                 deleteSourcesRouteWith(node->data->address());
 
                 NodeEvent event(NodeEvent::NodeRemoved, cpy.data);
-                emit nodeEvent(event);
+                dispatchNodeEvent(event);
                 m_nodesDead.push_back(*i);
                 m_nodes.erase(i);
 
@@ -6697,11 +7261,8 @@ void zmController::deleteNode(NodeInfo *node, NodeRemoveMode finally)
             {
                 if (finally == NodeRemoveHide)
                 {
-                    if (cpy.g)
-                    {
-                        DBG_Printf(DBG_INFO, "hide node: 0x%04X\n", cpy.data->address().nwk());
-                        cpy.g->hide();
-                    }
+                    DBG_Printf(DBG_INFO, "hide node: 0x%04X\n", cpy.data->address().nwk());
+                    NI_SetVisible(&*i, false);
                 }
             }
 
@@ -6710,7 +7271,7 @@ void zmController::deleteNode(NodeInfo *node, NodeRemoveMode finally)
 
             for (; il != endl; ++il)
             {
-                if ((il->a == cpy.g) || (il->b == cpy.g))
+                if (cpy.g && ((il->a == cpy.g) || (il->b == cpy.g)))
                 {
 
                     if (il->link)
@@ -7188,9 +7749,14 @@ void zmController::zclReadAttributesResponse(NodeInfo *node, const deCONZ::ApsDa
         return;
     }
 
-    QDataStream stream(zclFrame.payload());
+    const QByteArray &payload = zclFrame.payload();
+    QDataStream stream(payload);
     stream.setByteOrder(QDataStream::LittleEndian);
 
+    ZCL_AttrReader reader;
+    ZCL_AttrRecord rec;
+    ZCL_InitReader(&reader, reinterpret_cast<const uint8_t*>(payload.constData()), unsigned(payload.size()));
+
     uint16_t id;
     uint8_t status;
     uint8_t dataType = deCONZ::ZclNoData;
@@ -7203,7 +7769,7 @@ void zmController::zclReadAttributesResponse(NodeInfo *node, const deCONZ::ApsDa
     simpleDescr = node->data->getSimpleDescriptor(ind.srcEndpoint());
     if (simpleDescr)
     {
-        cluster = simpleDescr->cluster(ind.clusterId(), clusterSide);
+        cluster = NI_GetCluster(node, ind.srcEndpoint(), ind.clusterId(), clusterSide);
     }
 
     // when a response from a network node is received mark watchdog ok
@@ -7212,10 +7778,11 @@ void zmController::zclReadAttributesResponse(NodeInfo *node, const deCONZ::ApsDa
         m_deviceWatchdogOk |= DEVICE_RX_NETWORK_OK;
     }
 
-    while (!stream.atEnd())
+    // record boundaries are validated by the reader, values are only decoded for known attributes
+    while (ZCL_NextReadResponseRecord(&reader, &rec))
     {
-        stream >> id;
-        stream >> status;
+        id = rec.id;
+        status = rec.status;
 
         // search the attribute
         deCONZ::ZclAttribute *attr = nullptr;
@@ -7225,7 +7792,7 @@ void zmController::zclReadAttributesResponse(NodeInfo *node, const deCONZ::ApsDa
             clusterSide = (clusterSide == deCONZ::ClientCluster)
                     ? deCONZ::ServerCluster : deCONZ::ClientCluster;
             // this is more a hack to get the cluster for wrong ZCL implementations
-            cluster = simpleDescr->cluster(ind.clusterId(), clusterSide);
+            cluster = NI_GetCluster(node, ind.srcEndpoint(), ind.clusterId(), clusterSide);
 
             // try to append unknown cluster
             if (!cluster && zclFrame.frameControl() & deCONZ::ZclFCDirectionServerToClient)
@@ -7247,7 +7814,7 @@ void zmController::zclReadAttributesResponse(NodeInfo *node, const deCONZ::ApsDa
                         node->g->updated(deCONZ::ReqSimpleDescriptor);
                     }
                     NodeEvent event(NodeEvent::UpdatedSimpleDescriptor, node->data, simpleDescr->endpoint());
-                    emit nodeEvent(event);
+                    dispatchNodeEvent(event);
                     queueSaveNodesState();
                 }
             }
@@ -7276,7 +7843,7 @@ void zmController::zclReadAttributesResponse(NodeInfo *node, const deCONZ::ApsDa
         if (status == deCONZ::ZclSuccessStatus)
         {
             attr->setAvailable(true);
-            stream >> dataType;
+            dataType = rec.dataType;
 
             if (dataType != attr->dataType())
             {
@@ -7306,6 +7873,8 @@ void zmController::zclReadAttributesResponse(NodeInfo *node, const deCONZ::ApsDa
                 }
             }
 
+            stream.device()->seek(rec.offset);
+
             if (!attr->readFromStream(stream))
             {
                 const deCONZ::ZclDataType &type = deCONZ::zclDataBase()->dataType(attr->dataType());
@@ -7318,16 +7887,10 @@ void zmController::zclReadAttributesResponse(NodeInfo *node, const deCONZ::ApsDa
                     break;
                 }
 
+                // no handler, discard, the reader already skipped the value
                 DBG_Printf(DBG_ZCL, "ZCL Read Attributes Datatype 0x%02X %s"
                        " discard not supported data\n",
                        type.id(), qPrintable(type.name()));
-
-                // no handler, discard
-                uint8_t byte;
-                for (int i = 0; i < type.length() && !stream.atEnd(); i++)
-                {
-                    stream >> byte;
-                }
             }
             else if (cluster)
             {
@@ -7353,6 +7916,11 @@ void zmController::zclReadAttributesResponse(NodeInfo *node, const deCONZ::ApsDa
                attr->id(), attr->manufacturerCode(), status, dataType);
     }
 
+    if (reader.error)
+    {
+        DBG_Printf(DBG_ZCL, "ZCL Read Attributes response from 0x%04X malformed at offset %u, abort\n", node->data->address().nwk(), reader.pos);
+    }
+
     DBG_Assert(node && node->data && cluster);
     if (node && node->data && cluster)
     {
@@ -7546,19 +8114,34 @@ NodeInfo *zmController::getNode(const Address &addr, deCONZ::AddressMode mode)
 {
     if (mode == deCONZ::ExtAddress || ((mode == deCONZ::NoAddress) && addr.hasExt()))
     {
-        auto i = m_nodes.begin();
-        auto end = m_nodes.end();
+        // m_nodes is modified in many places, a cached index is only a hint
+        const uint64_t mac = addr.ext();
+        const auto cached = m_nodeIndexByMac.constFind(mac);
+        if (cached != m_nodeIndexByMac.cend() && cached.value() < m_nodes.size())
+        {
+            NodeInfo &node = m_nodes[cached.value()];
+            if (node.data && node.data->address().hasExt() && node.data->address().ext() == mac)
+            {
+                return &node;
+            }
+        }
 
-        for (; i != end; ++i)
+        for (size_t i = 0; i < m_nodes.size(); i++)
         {
-            if (i->data->address().hasExt())
+            if (m_nodes[i].data->address().hasExt())
             {
-                if (i->data->address().ext() == addr.ext())
+                if (m_nodes[i].data->address().ext() == mac)
                 {
-                    return &(*i);
+                    m_nodeIndexByMac.insert(mac, i);
+                    return &m_nodes[i];
                 }
             }
         }
+
+        if (cached != m_nodeIndexByMac.cend())
+        {
+            m_nodeIndexByMac.remove(mac);
+        }
     }
 
     if ((mode == deCONZ::NwkAddress) || ((mode == deCONZ::NoAddress) && addr.hasNwk()))
@@ -7583,6 +8166,15 @@ NodeInfo *zmController::getNode(const Address &addr, deCONZ::AddressMode mode)
 
 NodeInfo *zmController::getNode(deCONZ::zmNode *dnode)
 {
+    if (dnode && dnode->address().hasExt())
+    {
+        NodeInfo *node = getNode(dnode->address(), deCONZ::ExtAddress);
+        if (node && node->data == dnode)
+        {
+            return node;
+        }
+    }
+
     if (dnode)
     {
         for (size_t i = 0; i < m_nodes.size(); i++)
@@ -7615,6 +8207,18 @@ void zmController::tick()
     static int slice = 0;
     tickCounter++;
 
+    const uint64_t tickUs = MET_TimeUs();
+    if (m_tickTimeUs != 0)
+    {
+        const uint64_t dt = tickUs - m_tickTimeUs;
+        MET_Observe(MET_TickLag, dt > MainTickMs * 1000 ? dt - MainTickMs * 1000 : 0);
+    }
+    m_tickTimeUs = tickUs;
+    EVM_Heartbeat();
+    Core_FlushChangedNotify();
+    MET_Set(MET_ApsQueueDepth, m_apsRequestQueue.size());
+    MET_Set(MET_ApsRequestsBusy, unsigned(APS_RequestsBusyCount(m_apsRequestQueue)));
+
     if (slice > 5)
     {
         m_steadyTimeRef = deCONZ::steadyTimeRef();
@@ -7623,7 +8227,7 @@ void zmController::tick()
 
     if (m_devState == deCONZ::InNetwork)
     {
-        fetchZdpTick();
+        discoveryTick();
         bindTick();
     }
     else
@@ -7673,10 +8277,7 @@ void zmController::tick()
             }
         }
 
-        if (slice == 1)
-            zombieTick();
-
-        else if (slice == 2)
+        if (slice == 2)
             linkTick();
 
         else if (slice == 3)
@@ -7691,6 +8292,33 @@ void zmController::tick()
         slice++;
     }
 
+    if (m_steadyTimeRef - m_apsQueueStatsTime > ApsQueueStatsInterval)
+    {
+        m_apsQueueStatsTime = m_steadyTimeRef;
+        if (DBG_IsEnabled(DBG_MEASURE))
+        {
+            printApsQueueStats();
+        }
+    }
+
+    if (m_steadyTimeRef - m_discoveryStatsTime > DiscoveryStatsInterval)
+    {
+        m_discoveryStatsTime = m_steadyTimeRef;
+        if (DBG_IsEnabled(DBG_MEASURE))
+        {
+            printDiscoveryStats();
+        }
+    }
+
+    if (!m_subscribers.empty() && m_steadyTimeRef - m_subscriberStatsTime > SubscriberStatsInterval)
+    {
+        m_subscriberStatsTime = m_steadyTimeRef;
+        if (DBG_IsEnabled(DBG_MEASURE))
+        {
+            printSubscriberStats();
+        }
+    }
+
     DBG_FlushLazy();
 }
 
@@ -7822,9 +8450,6 @@ static bool ZCL_IsDefaultResponse(const deCONZ::ApsDataRequest &req)
 
 bool zmController::sendNextApsdeDataRequest(NodeInfo *dst)
 {
-    int ret = 0;
-    NodeInfo *node = 0;
-
     if (m_apsRequestQueue.empty())
     {
         return false;
@@ -7840,41 +8465,83 @@ bool zmController::sendNextApsdeDataRequest(NodeInfo *dst)
         return false;
     }
 
-    auto i = m_apsRequestQueue.begin();
-    const auto end = m_apsRequestQueue.end();
-
+    // While an OTA transfer is active image blocks preempt all classes, the client
+    // aborts the transfer if blocks are late. As before the destination filter is ignored.
     if (m_otauActivity > 0)
     {
-        i = std::find_if(m_apsRequestQueue.begin(), m_apsRequestQueue.end(),
-                     [](const deCONZ::ApsDataRequest &req) {
-                         return req.clusterId() == 0x0019 && req.state() == deCONZ::IdleState;
-                     });
-        if (i == m_apsRequestQueue.end())
+        const int ret = sendNextApsdeDataRequestOfClass(nullptr, ApsPrioOta);
+
+        if (ret == 1)
         {
-            i = m_apsRequestQueue.begin();
+            return true;
         }
-        else
+        else if (ret < 0)
         {
-            dst = nullptr;
+            return false;
         }
     }
 
-    for (; i != end; ++i)
+    // Classes are served in priority order, each with a budget per round so that
+    // lower classes don't starve. When no class with budget left has a request
+    // ready to send, a new round starts.
+    for (int pass = 0; pass < 2; pass++)
     {
-        if (!(i->state() == deCONZ::IdleState))
-            continue;
-
-        node = nullptr; // reset
-        ApsDataRequest &apsReq = *i;
-
-        // get node
-        if (apsReq.dstAddress().isNwkUnicast() || (apsReq.dstAddressMode() == deCONZ::ApsExtAddress))
+        for (int prio = 0; prio < ApsPrioMax; prio++)
         {
-            if (!node)
+            if (m_apsPrioCredits[prio] <= 0)
             {
-                node = getNode(apsReq.dstAddress(), deCONZ::NoAddress);
+                continue;
             }
-        }
+
+            const int ret = sendNextApsdeDataRequestOfClass(dst, prio);
+
+            if (ret == 1)
+            {
+                m_apsPrioCredits[prio]--;
+                return true;
+            }
+            else if (ret < 0)
+            {
+                return false;
+            }
+        }
+
+        m_apsPrioCredits = ApsPrioBudget;
+    }
+
+    return false;
+}
+
+/*! Sends the first ready request of a priority class.
+    \returns 1 if a request was sent, 0 if none was ready, -1 if sending failed
+ */
+int zmController::sendNextApsdeDataRequestOfClass(NodeInfo *dst, int prio)
+{
+    int ret = 0;
+    NodeInfo *node = nullptr;
+
+    auto i = m_apsRequestQueue.begin();
+    const auto end = m_apsRequestQueue.end();
+
+    for (; i != end; ++i)
+    {
+        if (!(i->state() == deCONZ::IdleState))
+            continue;
+
+        if (apsRequestMeta(i).prio != prio)
+            continue;
+
+        node = nullptr; // reset
+        ApsDataRequest &apsReq = *i;
+
+        // get node
+        if (apsReq.dstAddress().isNwkUnicast() || (apsReq.dstAddressMode() == deCONZ::ApsExtAddress))
+        {
+            if (!node)
+            {
+                node = getNode(apsReq.dstAddress(), deCONZ::NoAddress);
+            }
+        }
 
         if (dst && dst != node)
         {
@@ -7940,7 +8607,7 @@ bool zmController::sendNextApsdeDataRequest(NodeInfo *dst)
             {
 
             }
-            else if (busy >= m_maxBusyApsPerNode)
+            else if (busy >= (node ? NI_ApsWindow(node, m_maxBusyApsPerNode) : m_maxBusyApsPerNode))
             {
                 DBG_Printf(DBG_APS_L2, "Delay APS request id: %u to 0x%04X, profile: 0x%04X cluster: 0x%04X node already has busy %u\n",
                            apsReq.id(), apsReq.dstAddress().nwk(), apsReq.profileId(), apsReq.clusterId(), busy);
@@ -7950,6 +8617,10 @@ bool zmController::sendNextApsdeDataRequest(NodeInfo *dst)
             {
                 continue;
             }
+            else if (node && node->aps.spacingMs > 0 && m_steadyTimeRef - node->aps.lastSend < deCONZ::TimeMs{node->aps.spacingMs})
+            {
+                continue; // backed off after failures
+            }
             else if (busy > 0 && node && !(node->data->macCapabilities() & deCONZ::MacReceiverOnWhenIdle) && getParameter(deCONZ::ParamPermitJoin) == 0)
             {
                 continue;
@@ -7987,6 +8658,8 @@ bool zmController::sendNextApsdeDataRequest(NodeInfo *dst)
 
             if (ret == 0)
             {
+                apsRequestMeta(i).sentUs = MET_TimeUs();
+
                 if (dst && DBG_IsEnabled(DBG_APS))
                 {
                     DBG_Printf(DBG_APS, "APS-DATA.request id: %u, addr: " FMT_MAC " profile: 0x%04X, cluster: 0x%04X, ep: 0x%02X/0x%02X queue: %d len: %d (send, fast lane)\n", apsReq.id(), FMT_MAC_CAST(apsReq.dstAddress().ext()), apsReq.profileId(), apsReq.clusterId(), apsReq.srcEndpoint(), apsReq.dstEndpoint(), (int)m_apsRequestQueue.size(), (int)apsReq.asdu().size());
@@ -7996,12 +8669,19 @@ bool zmController::sendNextApsdeDataRequest(NodeInfo *dst)
                 if (node)
                 {
                     node->data->setLastApsRequestTime(m_steadyTimeRef);
+                    node->aps.lastSend = m_steadyTimeRef;
                 }
                 else if (apsReq.dstAddress().isNwkBroadcast() || apsReq.dstAddressMode() == deCONZ::ApsGroupAddress)
                 {
                     m_apsGroupIndicationTimeRef = deCONZ::steadyTimeRef();
                 }
-                return true;
+
+                ApsQueueStats &stats = m_apsQueueStats[prio];
+                const int64_t delay = (m_steadyTimeRef - apsRequestMeta(i).enqueued).val;
+                stats.delaySumMs += delay;
+                stats.delayMaxMs = std::max(stats.delayMaxMs, delay);
+                stats.sent++;
+                return 1;
             }
             else if (ret == -1)
             {
@@ -8025,11 +8705,28 @@ bool zmController::sendNextApsdeDataRequest(NodeInfo *dst)
                 apsReq.setState(deCONZ::FinishState);
             }
 
-            break;
+            return -1;
 
     }
 
-    return false;
+    return 0;
+}
+
+void zmController::printApsQueueStats()
+{
+    for (int prio = 0; prio < ApsPrioMax; prio++)
+    {
+        ApsQueueStats &stats = m_apsQueueStats[prio];
+
+        if (stats.sent > 0 || stats.expired > 0)
+        {
+            DBG_Printf(DBG_MEASURE, "APS queue %s: sent %u, expired %u, delay avg %d ms, max %d ms\n",
+                       ApsPrioNames[prio], stats.sent, stats.expired,
+                       int(stats.sent ? stats.delaySumMs / stats.sent : 0), int(stats.delayMaxMs));
+        }
+
+        stats = {};
+    }
 }
 
 /*! Emits a APSDE-DATA.confirm.
@@ -8107,7 +8804,7 @@ void zmController::onNodeSelected(uint64_t mac)
     if (node && node->data)
     {
         deCONZ::NodeEvent event(deCONZ::NodeEvent::NodeSelected, node->data);
-        emit nodeEvent(event);
+        dispatchNodeEvent(event);
     }
 }
 
@@ -8120,7 +8817,7 @@ void zmController::onNodeDeselected(uint64_t mac)
     if (node && node->data)
     {
         deCONZ::NodeEvent event(deCONZ::NodeEvent::NodeDeselected, node->data);
-        emit nodeEvent(event);
+        dispatchNodeEvent(event);
     }
 }
 
@@ -8128,6 +8825,11 @@ void zmController::onSourceRouteChanged(const SourceRoute &sourceRoute)
 {
     Q_ASSERT(!m_nodes.empty());
 
+    if (gHeadlessVersion) // no graphic source routes here
+    {
+        return;
+    }
+
     const Address &destAddress = sourceRoute.hops().back();
 
     auto i = std::find_if(m_gsourceRoutes.begin(), m_gsourceRoutes.end(), [&sourceRoute](const zmgSourceRoute *sr)
@@ -8212,7 +8914,7 @@ void zmController::onSourceRouteDeleted(const QString &uuid)
             auto *node = getNode(i2->hops().back(), deCONZ::ExtAddress);
             if (node && node->isValid())
             {
-                node->data->removeSourceRoute(i2->uuidHash());
+                CoreNode_RemoveSourceRoute(node->data, i2->uuidHash());
             }
         }
         m_routes.erase(i2);
@@ -8271,7 +8973,7 @@ void zmController::deleteSourcesRouteWith(const Address &addr)
             {
                 if (n.isValid())
                 {
-                    n.data->removeSourceRoute(i->uuidHash());
+                    CoreNode_RemoveSourceRoute(n.data, i->uuidHash());
                 }
             }
 
@@ -8299,7 +9001,7 @@ void zmController::onMacPoll(const Address &address, uint32_t lifeTime)
 
     visualizeNodeIndication(node, deCONZ::IndicateReceive);
 
-    emit nodeEvent(NodeEvent(NodeEvent::NodeMacDataRequest, node->data));
+    dispatchNodeEvent(NodeEvent(NodeEvent::NodeMacDataRequest, node->data));
 
     // try to query missing ZDP pieces
 
@@ -8381,7 +9083,22 @@ void zmController::timeoutTick()
 
     for (; i != end; ++i)
     {
-        if (i->state() == deCONZ::BusyState || i->state() == deCONZ::ConfirmedState)
+        if (i->state() == deCONZ::IdleState)
+        {
+            const ApsRequestMeta &meta = apsRequestMeta(i);
+
+            if (isValid(meta.deadline) && meta.deadline <= m_steadyTimeRef)
+            {
+                DBG_Printf(DBG_APS, "aps request id: %d prf: 0x%04X cl: 0x%04X deadline expired, drop\n", i->id(), i->profileId(), i->clusterId());
+                m_apsQueueStats[meta.prio].expired++;
+                i->setConfirmed(true);
+                i->setState(deCONZ::FinishState);
+                deCONZ::ApsDataConfirm conf(*i, deCONZ::MacTransactionExpiredStatus);
+                emit apsdeDataConfirm(conf);
+                return; // erased in next tick
+            }
+        }
+        else if (i->state() == deCONZ::BusyState || i->state() == deCONZ::ConfirmedState)
         {
             const deCONZ::SteadyTimeRef t = i->timeout() + (i->state() == deCONZ::ConfirmedState ? MaxConfirmedTimeOut : MaxTimeOut);
 
@@ -8429,7 +9146,7 @@ void zmController::timeoutTick()
                 i->setConfirmed(true);
                 return;
             }
-            m_apsRequestQueue.erase(i);
+            eraseApsRequest(i);
             return; // don't proceed since queue might be modified now
         }
         else if (i->state() == deCONZ::FailureState)
@@ -8442,27 +9159,283 @@ void zmController::timeoutTick()
                 i->setConfirmed(true);
                 return;
             }
-            m_apsRequestQueue.erase(i);
+            eraseApsRequest(i);
             return; // don't proceed since queue might be modified now
         }
     }
 }
 
-void zmController::fetchZdpTick()
+/*! Compare function for the min heap of discovery tasks. */
+static bool DiscoveryTaskLater(const DiscoveryTask &a, const DiscoveryTask &b)
 {
-    if (!m_master->connected())
+    if (a.due.ref != b.due.ref)
+    {
+        return a.due.ref > b.due.ref;
+    }
+
+    return static_cast<int32_t>(a.seq - b.seq) > 0;
+}
+
+/*! Removes the earliest task of \p heap into \p task if it is due at \p now. */
+static bool DiscoveryTaskPopDue(std::vector<DiscoveryTask> &heap, deCONZ::SteadyTimeRef now, DiscoveryTask *task)
+{
+    if (heap.empty() || now < heap.front().due)
+    {
+        return false;
+    }
+
+    std::pop_heap(heap.begin(), heap.end(), DiscoveryTaskLater);
+    *task = heap.back();
+    heap.pop_back();
+    return true;
+}
+
+/*! Schedules the discovery task \p item of \p node at \p due time.
+
+    Only the earliest task per node and item is kept, superseded entries stay in the
+    heap and are dropped when they are popped.
+ */
+void zmController::scheduleDiscovery(NodeInfo *node, deCONZ::RequestId item, deCONZ::SteadyTimeRef due)
+{
+    if (!node || !node->data || !node->data->address().hasExt())
+    {
         return;
+    }
 
-    if (m_nodes.empty())
+    if (item < deCONZ::ReqUnknown || item >= deCONZ::ReqMaxItems || !isValid(due))
+    {
         return;
+    }
 
-    if (!deCONZ::master()->hasFreeApsRequest())
+    deCONZ::SteadyTimeRef &scheduled = node->discoveryDue[item];
+
+    if (isValid(scheduled) && scheduled.ref <= due.ref)
+    {
+        return; // already scheduled earlier
+    }
+
+    scheduled = due;
+
+    DiscoveryTask task;
+    task.due = due;
+    task.extAddress = node->data->address().ext();
+    task.seq = m_discoverySeq++;
+    task.item = item;
+
+    std::vector<DiscoveryTask> &heap = item == deCONZ::ReqUnknown ? m_zombieTasks : m_discoveryTasks;
+    heap.push_back(task);
+    std::push_heap(heap.begin(), heap.end(), DiscoveryTaskLater);
+}
+
+/*! Schedules all discovery tasks of a node which was added to m_nodes. */
+void zmController::scheduleNodeDiscovery(NodeInfo *node)
+{
+    if (!node || !node->data)
+    {
         return;
+    }
 
-    // only fetch if we know who we are
-    if (!m_nodes[0].data->address().hasExt() || !m_nodes[0].data->address().hasNwk())
+    for (int i = deCONZ::ReqUnknown + 1; i < deCONZ::ReqMaxItems; i++)
+    {
+        const auto item = static_cast<deCONZ::RequestId>(i);
+        scheduleDiscovery(node, item, node->data->fetchDue(item));
+    }
+
+    scheduleDiscovery(node, deCONZ::ReqUnknown, m_steadyTimeRef + ZombieCheckInterval);
+}
+
+/*! Called by zmNode when the fetch state of \p item has changed. */
+void zmController::fetchStateChanged(deCONZ::zmNode *node, deCONZ::RequestId item)
+{
+    NodeInfo *info = getNode(node);
+
+    if (info)
+    {
+        scheduleDiscovery(info, item, node->fetchDue(item));
+    }
+}
+
+/*! Processes the due discovery tasks.
+
+    Replaces the former round-robin iteration over all nodes, only nodes with due
+    ZDP requests, neighbor table queries and zombie checks are touched. The requests
+    are limited by an airtime budget of m_discoveryRate requests per second, zombie
+    checks are kept in a separate heap since they don't send anything.
+
+    Once a Mgmt_Lqi_req is deferred by its spacing, all further neighbor table tasks
+    of the tick are moved to m_lqiNextSlot without counting against
+    MaxDiscoveryTasksPerTick, so a backlog of overdue routers can't block other tasks.
+ */
+void zmController::discoveryTick()
+{
+    if (m_nodes.empty())
+    {
         return;
+    }
+
+    if (isValid(m_discoveryBudgetTime))
+    {
+        const deCONZ::TimeMs dt = m_steadyTimeRef - m_discoveryBudgetTime;
+        m_discoveryBudget = qMin(double(m_discoveryRate), m_discoveryBudget + double(dt.val) * m_discoveryRate / 1000);
+    }
+    m_discoveryBudgetTime = m_steadyTimeRef;
+
+    if (m_topologyScan.active && MaxTopologyScanDuration < m_steadyTimeRef - m_topologyScan.started)
+    {
+        finishTopologyScan();
+    }
+
+    if (m_discoveryBudget >= 1)
+    {
+        const int result = fetchFastDiscover();
+        if (result == DiscoverySent)
+        {
+            m_discoveryBudget -= 1;
+            m_discoveryStats.sent++;
+            return;
+        }
+        else if (result == DiscoveryStop)
+        {
+            return;
+        }
+    }
+
+    const auto taskNode = [this](const DiscoveryTask &task) -> NodeInfo*
+    {
+        deCONZ::Address addr;
+        addr.setExt(task.extAddress);
+        NodeInfo *node = getNode(addr, deCONZ::ExtAddress);
+
+        if (!node || !node->data || node->discoveryDue[task.item].ref != task.due.ref)
+        {
+            m_discoveryStats.stale++;
+            return nullptr;
+        }
+
+        node->discoveryDue[task.item] = {};
+        return node;
+    };
+
+    int n = 0;
+    DiscoveryTask task;
+
+    while (n < MaxDiscoveryTasksPerTick && DiscoveryTaskPopDue(m_zombieTasks, m_steadyTimeRef, &task))
+    {
+        NodeInfo *node = taskNode(task);
+
+        if (node)
+        {
+            n++;
+            if (checkZombie(node) == DiscoveryWait)
+            {
+                scheduleDiscovery(node, task.item, m_steadyTimeRef + DiscoveryWaitDelay);
+            }
+        }
+    }
+
+    bool stop = false;
+    bool deferLqi = false;
+    n = 0;
+
+    while (n < MaxDiscoveryTasksPerTick && !stop && m_discoveryBudget >= 1 &&
+           DiscoveryTaskPopDue(m_discoveryTasks, m_steadyTimeRef, &task))
+    {
+        NodeInfo *node = taskNode(task);
+
+        if (!node)
+        {
+            continue;
+        }
+
+        if (deferLqi && task.item == deCONZ::ReqMgmtLqi)
+        {
+            scheduleDiscovery(node, task.item, m_lqiNextSlot);
+            continue;
+        }
+
+        n++;
+
+        int result;
+        if (task.item == deCONZ::ReqMgmtLqi) { result = fetchMgmtLqi(node); }
+        else                                 { result = fetchZdp(node->data, task.item, nullptr); }
+
+        switch (result)
+        {
+        case DiscoverySent:
+            m_discoveryBudget -= 1;
+            m_discoveryStats.sent++;
+            // check again if the response doesn't change the fetch state
+            scheduleDiscovery(node, task.item, m_steadyTimeRef + DiscoveryResponseTimeout);
+            break;
+
+        case DiscoveryBusy:
+            m_discoveryStats.busy++;
+            scheduleDiscovery(node, task.item, m_steadyTimeRef + DiscoveryBusyDelay);
+            break;
+
+        case DiscoveryWait:
+            scheduleDiscovery(node, task.item, m_steadyTimeRef + DiscoveryWaitDelay);
+            break;
+
+        case DiscoveryDefer:
+            deferLqi = true;
+            if (!(m_steadyTimeRef < m_lqiNextSlot))
+            {
+                m_lqiNextSlot = m_steadyTimeRef + deCONZ::TimeMs{MinLqiDeferMs};
+            }
+            scheduleDiscovery(node, task.item, m_lqiNextSlot);
+            break;
+
+        case DiscoveryDone:
+        {
+            // next periodic check, otherwise rescheduled by fetchStateChanged()
+            const deCONZ::SteadyTimeRef due = node->data->fetchDue(task.item);
+            if (isValid(due) && m_steadyTimeRef < due)
+            {
+                scheduleDiscovery(node, task.item, due);
+            }
+        }
+            break;
+
+        case DiscoveryStop:
+            // keep due time and order
+            stop = true;
+            node->discoveryDue[task.item] = task.due;
+            m_discoveryTasks.push_back(task);
+            std::push_heap(m_discoveryTasks.begin(), m_discoveryTasks.end(), DiscoveryTaskLater);
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+void zmController::printDiscoveryStats()
+{
+    int due = 0;
+    for (const auto *heap : { &m_discoveryTasks, &m_zombieTasks })
+    {
+        for (const DiscoveryTask &task : *heap)
+        {
+            if (task.due < m_steadyTimeRef)
+            {
+                due++;
+            }
+        }
+    }
+
+    DBG_Printf(DBG_MEASURE, "ZDP discovery: tasks %d, due %d, sent %u, busy %u, stale %u\n",
+               int(m_discoveryTasks.size() + m_zombieTasks.size()), due, m_discoveryStats.sent, m_discoveryStats.busy, m_discoveryStats.stale);
+
+    m_discoveryStats = {};
+}
 
+/*! Fetches the ZDP descriptors of nodes which announced themselves, ahead of scheduled tasks.
+    \returns DiscoveryResult
+ */
+int zmController::fetchFastDiscover()
+{
     deCONZ::zmNode *node = nullptr;
     FastDiscover *fastDiscoverNode = nullptr;
 
@@ -8476,7 +9449,7 @@ void zmController::fetchZdpTick()
                 m_fastDiscover.front() = m_fastDiscover.back();
             }
             m_fastDiscover.pop_back();
-            return;
+            return DiscoveryDone;
         }
 
         for (FastDiscover &fd : m_fastDiscover)
@@ -8553,25 +9526,32 @@ void zmController::fetchZdpTick()
         if (done == fastDiscoverNode->clusterCount)
         {
             fastDiscoverNode->done = 1;
-            return;
+            return DiscoveryDone;
         }
     }
 
-    if (m_fetchCurNode >= (int)m_nodes.size())
+    if (fastFetchItem == deCONZ::ReqUnknown)
     {
-        m_fetchCurNode = 0;
+        return DiscoveryDone;
     }
 
-    if (!node)
-    {
-        node = m_nodes[m_fetchCurNode].data;
-    }
+    return fetchZdp(node, fastFetchItem, fastDiscoverNode);
+}
 
-    if (!node)
-    {
-        m_fetchCurNode++;
-        return;
-    }
+/*! Sends the ZDP request for \p item to \p node if it needs to be fetched.
+    \returns DiscoveryResult
+ */
+int zmController::fetchZdp(deCONZ::zmNode *node, deCONZ::RequestId item, FastDiscover *fastDiscoverNode)
+{
+    if (!m_master->connected())
+        return DiscoveryStop;
+
+    if (!deCONZ::master()->hasFreeApsRequest())
+        return DiscoveryStop;
+
+    // only fetch if we know who we are
+    if (!m_nodes[0].data->address().hasExt() || !m_nodes[0].data->address().hasNwk())
+        return DiscoveryStop;
 
     if (!(node->macCapabilities() & deCONZ::MacReceiverOnWhenIdle))
     {
@@ -8588,13 +9568,12 @@ void zmController::fetchZdpTick()
                 nd.setMacCapabilities(nd.macCapabilities() | deCONZ::MacReceiverOnWhenIdle);
                 node->setMacCapabilities(nd.macCapabilities());
                 NodeEvent event(NodeEvent::UpdatedNodeDescriptor, node);
-                emit nodeEvent(event);
+                dispatchNodeEvent(event);
             }
         }
 #endif
 
-        m_fetchCurNode++;
-        return;
+        return DiscoveryDone; // sleeping nodes are only queried by fast discover
     }
 
     // check if we are too busy for any new requests
@@ -8608,7 +9587,7 @@ void zmController::fetchZdpTick()
             busyCount++;
             if (busyCount > MaxApsBusyRequests)
             {
-                return;
+                return DiscoveryStop;
             }
         }
 
@@ -8618,8 +9597,7 @@ void zmController::fetchZdpTick()
             {
                 DBG_Printf(DBG_ZDP, "ZDP skip fetch, node " FMT_MAC " has unconfirmed requests [1]\n", FMT_MAC_CAST(node->address().ext()));
             }
-            m_fetchCurNode++;
-            return;
+            return DiscoveryBusy;
         }
 
         if (req.profileId() == ZDP_PROFILE_ID && !req.confirmed())
@@ -8630,7 +9608,7 @@ void zmController::fetchZdpTick()
         if (zdpCount >= MaxApsRequestsZdp)
         {
             // DBG_Printf(DBG_ZDP, "ZDP skip fetch, node 0x%0llX total unconfirmed zdp request count %d [2]\n", node->address().ext(), zdpCount);
-            return;
+            return DiscoveryStop;
         }
     }
 
@@ -8638,47 +9616,22 @@ void zmController::fetchZdpTick()
 
     if (node->isZombie())
     {
-        m_fetchCurNode++;
-        return;
+        return DiscoveryWait;
     }
 
     if (node->state() != deCONZ::IdleState)
     {
-        m_fetchCurNode++;
-        return;
+        return DiscoveryBusy;
     }
 
-
-    deCONZ::RequestId curItem = fastFetchItem;
-
-    if (curItem == deCONZ::ReqUnknown)
+    if (!fastDiscoverNode && !node->needFetch(item))
     {
-        curItem = node->curFetchItem();
-
-        if (!node->needFetch(curItem))
-        {
-            curItem = node->nextCurFetchItem();
-
-
-            // end
-            if (curItem == deCONZ::ReqUnknown)
-            {
-                m_fetchCurNode++;
-                return;
-            }
-
-            if (!node->needFetch(curItem))
-            {
-                return;
-            }
-        }
+        return DiscoveryDone;
     }
 
-    m_fetchCurNode++;
-
     if (!fastDiscoverNode && !isValid(node->lastSeen()))
     {
-        return;
+        return DiscoveryWait;
     }
 
     {
@@ -8686,7 +9639,7 @@ void zmController::fetchZdpTick()
         if (!fastDiscoverNode && deCONZ::TimeSeconds{600} < dt)
         {
             DBG_Printf(DBG_ZDP, "ZDP skip fetch " FMT_MAC ", diff last seen: %d ms [4]\n", FMT_MAC_CAST(node->address().ext()), int(dt.val));
-            return;
+            return DiscoveryWait;
         }
     }
 
@@ -8699,7 +9652,7 @@ void zmController::fetchZdpTick()
         if (sendMgmtLeaveRequest(node, removeChildren, rejoin))
         {
             node->setNeedRejoin(false);
-            return;
+            return DiscoverySent;
         }
     }
 
@@ -8727,7 +9680,7 @@ void zmController::fetchZdpTick()
     apsReq.setState(deCONZ::BusyState); // means ok, do process and send
     stream << genSequenceNumber();
 
-    switch (curItem)
+    switch (item)
     {
     case deCONZ::ReqIeeeAddr:
     {
@@ -8798,12 +9751,6 @@ void zmController::fetchZdpTick()
     }
         break;
 
-    case deCONZ::ReqMgmtLqi:
-    {
-        curItem = node->nextCurFetchItem();
-    }
-        return;
-
     case deCONZ::ReqMgmtBind:
     {
         apsReq.setClusterId(ZDP_MGMT_BIND_REQ_CLID);
@@ -8965,56 +9912,40 @@ void zmController::fetchZdpTick()
 
     if (sendDone)
     {
-        if (node)
+        if (!apsReq.dstAddress().isNwkBroadcast())
         {
-            if (!apsReq.dstAddress().isNwkBroadcast())
-            {
-                node->setWaitState(1);
-            }
-        }
-    }
-    else
-    {
-        if (node)
-        {
-            curItem = node->nextCurFetchItem();
+            node->setWaitState(1);
         }
+
+        return DiscoverySent;
     }
+
+    // still busy state if a ZDP request to the node is already queued
+    return apsReq.state() == deCONZ::BusyState ? DiscoveryBusy : DiscoveryWait;
 }
 
 /*!
-    Checks one node per call for zombie timeout.
+    Checks a node for zombie timeout, the next check is scheduled every ZombieCheckInterval.
+    \returns DiscoveryResult
  */
-void zmController::zombieTick()
+int zmController::checkZombie(NodeInfo *info)
 {
     if (!autoFetchFFD())
     {
-        return;
+        return DiscoveryWait;
     }
 
-    if (m_nodes.size() <= 1) // dont kill coord
-        return;
+    if (info->data == m_nodes[0].data) // dont kill coord
+        return DiscoveryDone;
 
     if (m_zombieDelay > 0)
     {
-        return;
+        return DiscoveryWait;
     }
 
-    // check for zombies
-    if (m_nodeZombieIter >= (int)m_nodes.size())
-    {
-        m_nodeZombieIter = 1;       
-    }
+    scheduleDiscovery(info, deCONZ::ReqUnknown, m_steadyTimeRef + ZombieCheckInterval);
 
-    NodeInfo &info = m_nodes[m_nodeZombieIter];
-    m_nodeZombieIter++;
-
-    if (!info.data || !info.g)
-    {
-        return;
-    }
-
-    deCONZ::zmNode *node = info.data;
+    deCONZ::zmNode *node = info->data;
 
     deCONZ::SteadyTimeRef minSeenTime = node->lastSeen();
     deCONZ::TimeSeconds delta = ZombieDelta;
@@ -9091,13 +10022,13 @@ void zmController::zombieTick()
         if (!node->isZombie() && (node->address().nwk() != ownNwk) && node->nodeDescriptor().receiverOnWhenIdle() && node->recvErrors() > MaxRecvErrors)
         {
             DBG_Printf(DBG_INFO, "%s seems to be a zombie recv errors %d\n", node->extAddressString().c_str(), node->recvErrors());
-            deleteNode(&info, NodeRemoveZombie);
+            deleteNode(info, NodeRemoveZombie);
             NodeEvent event(NodeEvent::NodeZombieChanged, node);
-            emit nodeEvent(event);
+            dispatchNodeEvent(event);
             zombieCount++;
-            if (info.g)
+            if (info->g)
             {
-                info.g->requestUpdate(); // redraw
+                info->g->requestUpdate(); // redraw
             }
         }
     }
@@ -9106,14 +10037,15 @@ void zmController::zombieTick()
         if (node->isZombie())
         {
             DBG_Printf(DBG_INFO, "%s is alive again\n", node->extAddressString().c_str());
-            wakeNode(&info);
+            wakeNode(info);
             NodeEvent event(NodeEvent::NodeZombieChanged, node);
-            emit nodeEvent(event);
+            dispatchNodeEvent(event);
             zombieCount--;
         }
     }
 
     m_zombieCount = zombieCount;
+    return DiscoveryDone;
 }
 
 /*!
@@ -9460,20 +10392,37 @@ void zmController::bindTick()
     }
 }
 
-/*! Device discovery handler checks for address changes and will
-    send unicast ZDP IEEE_addr_req to nodes which are marked as zombie but
-    have been seen by other nodes via ZDP Mgmt_Lqi_req neighbor table.
+/*! Sends a ZDP Mgmt_Lqi_req to a router, the neighbor table is fetched again after
+    MgmtLqiCheckInterval or immediately if more entries are available.
+    Requests are spaced by fetchAfter over all routers.
+
+    During a topology scan the routing table is read after the neighbor table and
+    up to m_topologyParallel routers are queried at once, see startTopologyScan().
+    \returns DiscoveryResult
  */
-void zmController::deviceDiscoverTick()
+int zmController::fetchMgmtLqi(NodeInfo *node)
 {
-    if (m_nodes.empty())
+    const bool scan = m_topologyScan.active && (node->topologyScan & TopoScanPending);
+
+    // an explicit topology scan runs without auto fetching too
+    if (!autoFetchFFD() && !scan)
     {
-        return;
+        return DiscoveryWait;
     }
 
-    if (!autoFetchFFD())
+    if (node->data->isEndDevice())
     {
-        return;
+        return DiscoveryDone;
+    }
+
+    if (node->data->isInWaitState())
+    {
+        return DiscoveryBusy;
+    }
+
+    if (!node->data->address().hasNwk())
+    {
+        return DiscoveryWait;
     }
 
     int fetchAfter = 20000;
@@ -9481,8 +10430,8 @@ void zmController::deviceDiscoverTick()
     if (m_steadyTimeRef - m_lastEndDeviceAnnounce < deCONZ::TimeSeconds{2 * 60} && getParameter(deCONZ::ParamPermitJoin) > 0)
     {
         // skip while end-device search is active
-        DBG_Printf(DBG_ZDP, "skip device discovery while end devices is added\n");
-        return;
+        m_lqiNextSlot = m_steadyTimeRef + DiscoveryBusyDelay;
+        return DiscoveryDefer;
     }
     else if (m_fastDiscovery)
     {
@@ -9498,13 +10447,14 @@ void zmController::deviceDiscoverTick()
     else if (m_nodes.size() < 50) { fetchAfter = 3000; }
     else                          { fetchAfter = 3500; }
 
-    if (m_nodes.front().data->neighbors().empty())
+    int maxLqiRequests = 1;
+    if (scan)
     {
-        m_lqiIter = 0; // always fetch coordinator first
+        maxLqiRequests = m_topologyScan.fast ? 2 * m_topologyParallel : m_topologyParallel;
+        fetchAfter = m_topologyScan.fast ? 0 : fetchAfter / maxLqiRequests;
     }
 
     int busyCount = 0;
-    int ieeeReqCount = 0;
     int lqiReqCount = 0;
     for (const deCONZ::ApsDataRequest &req : m_apsRequestQueue)
     {
@@ -9513,98 +10463,138 @@ void zmController::deviceDiscoverTick()
             busyCount++;
         }
 
-        if (req.profileId() == ZDP_PROFILE_ID)
+        if (req.profileId() == ZDP_PROFILE_ID &&
+            (req.clusterId() == ZDP_MGMT_LQI_REQ_CLID || req.clusterId() == ZDP_MGMT_RTG_REQ_CLID))
         {
-            if      (req.clusterId() == ZDP_IEEE_ADDR_CLID) { ieeeReqCount++;  }
-            else if (req.clusterId() == ZDP_MGMT_LQI_REQ_CLID) { lqiReqCount++;  }
+            lqiReqCount++;
         }
     }
 
-    if (!m_fetchLqiTickMsCounter.isValid() ||
+    if (!(!m_fetchLqiTickMsCounter.isValid() ||
         (m_fetchLqiTickMsCounter.elapsed() > 60000) ||
-        (busyCount <  5 && m_fetchLqiTickMsCounter.elapsed() > fetchAfter) /*||
-        (busyCount == 0 && m_fetchLqiTickMsCounter.elapsed() > 2000 && m_otauActivity == 0)*/) // nothing else in queue
+        (busyCount <  5 && m_fetchLqiTickMsCounter.elapsed() > fetchAfter)))
     {
-        if (m_lqiIter >= m_nodes.size())
-        {
-            m_lqiIter = 0;
-        }
+        const int64_t wait = busyCount < 5 ? fetchAfter - m_fetchLqiTickMsCounter.elapsed() : DiscoveryBusyDelay.val;
+        m_lqiNextSlot = m_steadyTimeRef + deCONZ::TimeMs{qMax(wait, MinLqiDeferMs)};
+        return DiscoveryDefer;
+    }
+
+    if (node->data->isZombie() || 2 < node->data->recvErrors())
+    {
+        AddressPair addressPair;
+        addressPair.bAddr = node->data->address();
+        addressPair.bMacCapabilities = node->data->nodeDescriptor().macCapabilities();
 
-        NodeInfo &node = m_nodes[m_lqiIter];
+        addDeviceDiscover(addressPair);
 
-        if (!node.data || node.data->isEndDevice() ||
-             node.data->isInWaitState() || !node.data->address().hasNwk())
+        if (scan)
         {
-            m_lqiIter++;
+            topologyScanNodeDone(node, false);
         }
-        else if (node.data->isZombie() || 2 < node.data->recvErrors())
+        return DiscoveryWait;
+    }
+    else if (isValid(node->data->lastSeen()) || node->data->lastSeenByNeighbor() < 9000 ||
+             (!node->data->sourceRoutes().empty() && node->data->sourceRoutes().front().errors() < 1))
+    {
+        for (const deCONZ::ApsDataRequest &req : m_apsRequestQueue)
         {
-            m_lqiIter++;
-
-            AddressPair addressPair;
-            addressPair.bAddr = node.data->address();
-            addressPair.bMacCapabilities = node.data->nodeDescriptor().macCapabilities();
+            if (req.state() == deCONZ::FinishState)
+            {
+                continue;
+            }
 
-            addDeviceDiscover(addressPair);
+            if (deCONZ::TimeSeconds{600} < node->data->lastDiscoveryTryMs(m_steadyTimeRef)) // > 10 min.
+            {
+                // ok, don't wait too long
+            }
+            else if (req.dstAddress().hasNwk() &&
+                     req.dstAddress().nwk() == node->data->address().nwk() && req.dstAddress().nwk() != 0x0000)
+            {
+                return DiscoveryBusy;
+            }
         }
-        else if (isValid(node.data->lastSeen()) || node.data->lastSeenByNeighbor() < 9000 ||
-                 (!node.data->sourceRoutes().empty() && node.data->sourceRoutes().front().errors() < 1))
+
+        if (lqiReqCount >= maxLqiRequests)
         {
-            for (const deCONZ::ApsDataRequest &req : m_apsRequestQueue)
-            {
-                if (req.state() == deCONZ::FinishState)
-                {
-                    continue;
-                }
+            m_lqiNextSlot = m_steadyTimeRef + DiscoveryBusyDelay;
+            return DiscoveryDefer;
+        }
 
-                if (deCONZ::TimeSeconds{600} < node.data->lastDiscoveryTryMs(m_steadyTimeRef)) // > 10 min.
-                {
-                    // ok, don't wait too long
-                }
-                else if (req.dstAddress().hasNwk() &&
-                         req.dstAddress().nwk() == node.data->address().nwk() && req.dstAddress().nwk() != 0x0000)
-                {
-                    m_lqiIter++;
-                    return;
-                }
-            }
+        if (scan && node->topologyScanTries >= MaxTopologyScanTries)
+        {
+            topologyScanNodeDone(node, false);
+            return DiscoveryWait;
+        }
 
-            if (lqiReqCount == 0)
+        bool sent;
+        if (scan && (node->topologyScan & TopoScanLqi))
+        {
+            sent = sendMgtmRtgRequest(node, 0);
+            if (sent)
             {
-                m_lqiIter++;
-                if (sendMgtmLqiRequest(&node))
-                {
-                    node.data->discoveryTimerReset(m_steadyTimeRef);
-                    return;
-                }
+                m_fetchLqiTickMsCounter.restart();
             }
         }
         else
         {
-            m_lqiIter++;
+            sent = sendMgtmLqiRequest(node);
+        }
 
-            // try to proceed with IEEE requests to move to zombie state if none are received
-            if (node.data->recvErrors() < MaxRecvErrorsZombie && !node.data->nodeDescriptor().isNull())
+        if (sent)
+        {
+            node->data->discoveryTimerReset(m_steadyTimeRef);
+            if (scan)
             {
-                AddressPair addressPair;
-                addressPair.bAddr = node.data->address();
-                addressPair.bMacCapabilities = node.data->nodeDescriptor().macCapabilities();
-
-                addDeviceDiscover(addressPair);
+                node->topologyScanTries++;
             }
+            return DiscoverySent;
         }
+
+        return DiscoveryBusy;
     }
 
-    if (m_deviceDiscoverQueue.isEmpty())
+    if (scan)
     {
-        if (m_discoverIter >= m_nodes.size())
-        {
-            m_discoverIter = 0;
-        }
+        topologyScanNodeDone(node, false);
+    }
 
-        m_discoverIter++;
+    // try to proceed with IEEE requests to move to zombie state if none are received
+    if (node->data->recvErrors() < MaxRecvErrorsZombie && !node->data->nodeDescriptor().isNull())
+    {
+        AddressPair addressPair;
+        addressPair.bAddr = node->data->address();
+        addressPair.bMacCapabilities = node->data->nodeDescriptor().macCapabilities();
+
+        addDeviceDiscover(addressPair);
     }
-    else
+
+    return DiscoveryWait;
+}
+
+/*! Device discovery handler checks for address changes and will
+    send unicast ZDP IEEE_addr_req to nodes which are marked as zombie but
+    have been seen by other nodes via ZDP Mgmt_Lqi_req neighbor table.
+ */
+void zmController::deviceDiscoverTick()
+{
+    if (m_nodes.empty())
+    {
+        return;
+    }
+
+    if (!autoFetchFFD())
+    {
+        return;
+    }
+
+    if (m_steadyTimeRef - m_lastEndDeviceAnnounce < deCONZ::TimeSeconds{2 * 60} && getParameter(deCONZ::ParamPermitJoin) > 0)
+    {
+        // skip while end-device search is active
+        DBG_Printf(DBG_ZDP, "skip device discovery while end devices is added\n");
+        return;
+    }
+
+    if (!m_deviceDiscoverQueue.isEmpty())
     {
         NodeInfo nodeInfo; // todo cleanup
         NodeInfo *node = nullptr;
@@ -9804,7 +10794,10 @@ void zmController::deviceDiscoverTick()
 }
 
 /*!
-    Reads parameters from device.
+    Refreshes subscribed parameters whose TTL has expired.
+
+    Configuration parameters are also invalidated by ZM_STATUS_CONFIG_CHANGED,
+    their long TTL only guards against missed status flags.
 */
 void zmController::readParamTimerFired()
 {
@@ -9818,23 +10811,21 @@ void zmController::readParamTimerFired()
         return;
     }
 
-    deCONZ::master()->readParameter(ZM_DID_APS_CHANNEL_MASK);
-    deCONZ::master()->readParameter(ZM_DID_APS_TRUST_CENTER_ADDRESS);
-    deCONZ::master()->readParameter(ZM_DID_APS_USE_EXTENDED_PANID);
-    deCONZ::master()->readParameter(ZM_DID_STK_CURRENT_CHANNEL);
-    deCONZ::master()->readParameter(ZM_DID_STK_NWK_UPDATE_ID);
+    PRM_Subscribe(ZM_DID_APS_CHANNEL_MASK, PARAM_TTL_CONFIG);
+    PRM_Subscribe(ZM_DID_APS_TRUST_CENTER_ADDRESS, PARAM_TTL_CONFIG);
+    PRM_Subscribe(ZM_DID_APS_USE_EXTENDED_PANID, PARAM_TTL_CONFIG);
+    PRM_Subscribe(ZM_DID_STK_CURRENT_CHANNEL, PARAM_TTL_NETWORK);
+    PRM_Subscribe(ZM_DID_STK_NWK_UPDATE_ID, PARAM_TTL_NETWORK);
     if (deCONZ::master()->deviceFirmwareVersion() > 0x261f0500)
     {
-        deCONZ::master()->readParameter(ZM_DID_DEV_WATCHDOG_TTL);
+        PRM_Subscribe(ZM_DID_DEV_WATCHDOG_TTL, PARAM_TTL_NETWORK);
     }
     if (deCONZ::master()->deviceProtocolVersion() >= DECONZ_PROTOCOL_VERSION_1_12)
     {
-        deCONZ::master()->readParameter(ZM_DID_STK_FRAME_COUNTER);
-//        deCONZ::master()->readParameter(ZM_DID_STK_DEBUG);
+        PRM_Subscribe(ZM_DID_STK_FRAME_COUNTER, PARAM_TTL_NETWORK);
     }
 
-    m_readParamTimer->stop();
-    m_readParamTimer->start(180 * 1000);
+    deCONZ::master()->refreshParameters();
 }
 
 /*!
@@ -9970,34 +10961,37 @@ void zmController::zclReportAttributesIndication(NodeInfo *node, const deCONZ::A
         return;
     }
 
-    for (auto &bnd : node->data->bindingTable())
+    if (NI_BindingRefreshDue(node, ind, m_steadyTimeRef))
     {
-        if (bnd.clusterId() != ind.clusterId())
+        for (auto &bnd : node->data->bindingTable())
         {
-            continue;
-        }
+            if (bnd.clusterId() != ind.clusterId())
+            {
+                continue;
+            }
 
-        if (bnd.srcEndpoint() != ind.srcEndpoint())
-        {
-            continue;
-        }
+            if (bnd.srcEndpoint() != ind.srcEndpoint())
+            {
+                continue;
+            }
 
-        if (bnd.dstAddressMode() == deCONZ::ApsExtAddress && bnd.dstEndpoint() == ind.dstEndpoint())
-        {
-            bnd.setConfirmedTimeRef(m_steadyTimeRef);
-            break;
-        }
-        else if (bnd.dstAddressMode() == deCONZ::ApsGroupAddress && ind.dstAddress().hasGroup() && ind.dstAddress().group() == bnd.dstAddress().group())
-        {
-            bnd.setConfirmedTimeRef(m_steadyTimeRef);
-            break;
+            if (bnd.dstAddressMode() == deCONZ::ApsExtAddress && bnd.dstEndpoint() == ind.dstEndpoint())
+            {
+                bnd.setConfirmedTimeRef(m_steadyTimeRef);
+                break;
+            }
+            else if (bnd.dstAddressMode() == deCONZ::ApsGroupAddress && ind.dstAddress().hasGroup() && ind.dstAddress().group() == bnd.dstAddress().group())
+            {
+                bnd.setConfirmedTimeRef(m_steadyTimeRef);
+                break;
+            }
         }
     }
 
     deCONZ::ZclClusterSide side =
             // check  if this is always teh reverse case ?
             (zclFrame.frameControl() & deCONZ::ZclFCDirectionServerToClient) ? deCONZ::ServerCluster : deCONZ::ClientCluster;
-    deCONZ::ZclCluster *cluster = node->data->getCluster(ind.srcEndpoint(), ind.clusterId(), side);
+    deCONZ::ZclCluster *cluster = NI_GetCluster(node, ind.srcEndpoint(), ind.clusterId(), side);
 
     deCONZ::SimpleDescriptor *sd = node->data->getSimpleDescriptor(ind.srcEndpoint());
 
@@ -10045,7 +11039,7 @@ void zmController::zclReportAttributesIndication(NodeInfo *node, const deCONZ::A
                     node->g->updated(deCONZ::ReqSimpleDescriptor);
                 }
                 NodeEvent event(NodeEvent::UpdatedSimpleDescriptor, node->data, sd->endpoint());
-                emit nodeEvent(event);
+                dispatchNodeEvent(event);
                 queueSaveNodesState();
             }
         }
@@ -10080,29 +11074,19 @@ void zmController::zclReportAttributesIndication(NodeInfo *node, const deCONZ::A
 
     if (cluster)
     {
-        QDataStream stream(zclFrame.payload());
+        const QByteArray &payload = zclFrame.payload();
+        QDataStream stream(payload);
         stream.setByteOrder(QDataStream::LittleEndian);
 
-        uint16_t attrId;
-        uint8_t dataType;
+        ZCL_AttrReader reader;
+        ZCL_AttrRecord rec;
+        ZCL_InitReader(&reader, reinterpret_cast<const uint8_t*>(payload.constData()), unsigned(payload.size()));
 
-        while (!stream.atEnd())
+        // record boundaries are validated by the reader, unknown attributes are skipped without decoding
+        while (ZCL_NextReportRecord(&reader, &rec))
         {
-            stream >> attrId;
-
-            if (stream.atEnd())
-            {
-                return;
-            }
-
-            stream >> dataType;
-
-            if (stream.atEnd())
-            {
-                return;
-            }
-
-            bool wasRead = false;
+            const uint16_t attrId = rec.id;
+            const uint8_t dataType = rec.dataType;
 
             auto i = cluster->attributes().begin();
             auto end = cluster->attributes().end();
@@ -10126,28 +11110,24 @@ void zmController::zclReportAttributesIndication(NodeInfo *node, const deCONZ::A
                         continue;
                     }
 
+                    stream.device()->seek(rec.offset);
+
                     if (!i->readFromStream(stream))
                     {
                         return;
                     }
 
-                    wasRead = true;
-
                     i->setLastRead(m_steadyTimeRef.ref);
                     event.addAttributeId(attrId);
                     break;
                 }
             }
+        }
 
-            if (!wasRead)
-            { // strip from stream for known datatypes
-                deCONZ::ZclAttribute a(attrId, dataType, QString(), deCONZ::ZclReadWrite, true);
-
-                if (!a.readFromStream(stream))
-                {
-                    return;
-                }
-            }
+        if (reader.error)
+        {
+            DBG_Printf(DBG_ZCL, "ZCL report cluster 0x%04X from 0x%04X malformed at offset %u\n", ind.clusterId(), node->data->address().nwk(), reader.pos);
+            return;
         }
 
         DBG_Assert(node && node->data && cluster);
@@ -10293,17 +11273,20 @@ void zmController::checkAddressChange(const Address &address, NodeInfo *node)
             node = getNode(address, deCONZ::ExtAddress);
         }
 
-        if (node && node->data && node->g)
+        if (node && node->data)
         {
             if (node->data->address().nwk() != address.nwk())
             {
                 DBG_Printf(DBG_INFO, "%s 0x%04X nwk changed to 0x%04X\n",
                        node->data->extAddressString().c_str(), node->data->address().nwk(), address.nwk());
                 node->data->setAddress(address);
-                node->g->setAddress(address.nwk(), address.ext());
-                node->g->requestUpdate();
+                if (node->g)
+                {
+                    node->g->setAddress(address.nwk(), address.ext());
+                    node->g->requestUpdate();
+                }
                 NodeEvent e(NodeEvent::UpdatedNodeAddress, node->data);
-                emit nodeEvent(e);
+                dispatchNodeEvent(e);
                 visualizeNodeChanged(node, deCONZ::IndicateDataUpdate);
                 queueSaveNodesState();
                 deCONZ::nodeModel()->setData(address.ext(), NodeModel::NwkAddressColumn, address.nwk());
@@ -10320,11 +11303,11 @@ void zmController::checkAddressChange(const Address &address, NodeInfo *node)
                 visualizeNodeChanged(node, deCONZ::IndicateDataUpdate);
                 queueSaveNodesState();
                 NodeEvent e(NodeEvent::UpdatedNodeAddress, node->data);
-                emit nodeEvent(e);
+                dispatchNodeEvent(e);
             }
         }
 
-        if (node && node->data && !node->data->isZombie() && node->data->address().hasExt() && !node->g->isVisible())
+        if (node && node->data && !node->data->isZombie() && node->data->address().hasExt() && !node->visible)
         {
             wakeNode(node);
         }
@@ -10344,6 +11327,204 @@ void zmController::setDeviceState(deCONZ::State state)
     }
 }
 
+/*! Sets visibility of a node, \c NodeInfo::visible is also tracked in headless mode. */
+static void NI_SetVisible(NodeInfo *node, bool visible)
+{
+    node->visible = visible;
+
+    if (node->g)
+    {
+        node->g->setVisible(visible);
+
+        if (visible)
+        {
+            node->g->requestUpdate();
+        }
+    }
+}
+
+static float NI_MaxApsWindow(const NodeInfo *node)
+{
+    return node->data->nodeDescriptor().receiverOnWhenIdle() ? MaxApsWindowRouter : MaxApsWindowEndDevice;
+}
+
+/*! Returns the number of APS requests which may be in flight to the node. */
+static unsigned NI_ApsWindow(const NodeInfo *node, unsigned defaultWindow)
+{
+    if (node->aps.window < 1) // no confirms yet
+    {
+        return defaultWindow;
+    }
+
+    return unsigned(node->aps.window);
+}
+
+/*! Updates the congestion state of a node from an APS-DATA.confirm.
+
+    The in-flight window grows by 1/window for each success (additive increase)
+    and is halved on failures (multiplicative decrease). Failures also double the
+    spacing between requests which decays again with successful confirms.
+    \param rttMs - time between sending the request and the confirm
+ */
+static void NI_ApsConfirmed(NodeInfo *node, int64_t rttMs, uint8_t status, unsigned defaultWindow)
+{
+    ApsCongestion &cc = node->aps;
+    const float maxWindow = NI_MaxApsWindow(node);
+    const uint16_t rtt = uint16_t(qBound<int64_t>(0, rttMs, UINT16_MAX));
+
+    if (cc.window < 1)
+    {
+        cc.window = qMin(float(defaultWindow), maxWindow);
+    }
+
+    if (cc.confirms == 0 && cc.failures == 0)
+    {
+        cc.srttMs = rtt;
+        cc.rttVarMs = rtt / 2;
+    }
+    else
+    {
+        const int diff = std::abs(int(cc.srttMs) - int(rtt));
+        cc.rttVarMs = uint16_t((3 * int(cc.rttVarMs) + diff) / 4);
+        cc.srttMs = uint16_t((7 * int(cc.srttMs) + rtt) / 8);
+    }
+
+    switch (status)
+    {
+    case deCONZ::ApsSuccessStatus:
+        cc.confirms++;
+        cc.window = qMin(cc.window + 1 / cc.window, maxWindow);
+        cc.spacingMs = cc.spacingMs < MinApsSpacingMs / 2 ? 0 : uint16_t(cc.spacingMs * 3 / 4);
+        break;
+
+    case deCONZ::ApsNoAckStatus:
+    case deCONZ::MacNoAckStatus:
+    case deCONZ::MacChannelAccessFailureStatus:
+    case deCONZ::MacTransactionExpiredStatus:
+    case deCONZ::NwkRouteDiscoveryFailedStatus:
+        cc.failures++;
+        cc.window = qMax(cc.window / 2, 1.0f);
+        cc.spacingMs = uint16_t(qBound(MinApsSpacingMs, cc.spacingMs * 2, MaxApsSpacingMs));
+        break;
+
+    default:
+        break;
+    }
+}
+
+/*! Returns true if the bindings matching the report \p ind should be marked as confirmed.
+
+    Reports arrive often while the binding confirmation time is only checked in
+    minutes, the binding table is searched once per BindingRefreshInterval for
+    each (source endpoint, cluster, destination).
+ */
+static bool NI_BindingRefreshDue(NodeInfo *node, const deCONZ::ApsDataIndication &ind, deCONZ::SteadyTimeRef now)
+{
+    const uint8_t isGroup = ind.dstAddress().hasGroup() ? 1 : 0;
+    const uint16_t dst = isGroup ? ind.dstAddress().group() : ind.dstEndpoint();
+    BindingRefreshEntry *e = nullptr;
+
+    for (BindingRefreshEntry &x : node->bindingRefresh)
+    {
+        if (isValid(x.time) && x.clusterId == ind.clusterId() && x.srcEndpoint == ind.srcEndpoint() && x.dst == dst && x.isGroup == isGroup)
+        {
+            e = &x;
+            break;
+        }
+    }
+
+    if (e && now - e->time < BindingRefreshInterval)
+    {
+        return false;
+    }
+
+    if (!e)
+    {
+        e = &node->bindingRefresh[node->bindingRefreshIter % node->bindingRefresh.size()];
+        node->bindingRefreshIter++;
+        e->clusterId = ind.clusterId();
+        e->srcEndpoint = ind.srcEndpoint();
+        e->dst = dst;
+        e->isGroup = isGroup;
+    }
+
+    e->time = now;
+    return true;
+}
+
+/*! Returns the cluster of a node endpoint via a small per node cache.
+
+    Reports and read responses mostly hit the same few clusters, the cache
+    avoids searching simple descriptors and clusters for each frame.
+    Entries are indexes which are verified on each hit.
+ */
+static deCONZ::ZclCluster *NI_GetCluster(NodeInfo *node, uint8_t endpoint, uint16_t clusterId, deCONZ::ZclClusterSide side)
+{
+    auto &sds = node->data->simpleDescriptors();
+
+    for (const ClusterCacheEntry &e : node->clusterCache)
+    {
+        if (e.sdIndex == 0xFF || e.clusterId != clusterId || e.endpoint != endpoint || e.side != side)
+        {
+            continue;
+        }
+
+        if (e.sdIndex < sds.size() && sds[e.sdIndex].endpoint() == endpoint)
+        {
+            auto &clusters = side == deCONZ::ServerCluster ? sds[e.sdIndex].inClusters() : sds[e.sdIndex].outClusters();
+            if (e.clusterIndex < clusters.size() && clusters[e.clusterIndex].id() == clusterId)
+            {
+                return &clusters[e.clusterIndex];
+            }
+        }
+        break; // stale, resolve again
+    }
+
+    for (size_t i = 0; i < sds.size() && i < 0xFF; i++)
+    {
+        if (sds[i].endpoint() != endpoint)
+        {
+            continue;
+        }
+
+        auto &clusters = side == deCONZ::ServerCluster ? sds[i].inClusters() : sds[i].outClusters();
+        for (size_t j = 0; j < clusters.size(); j++)
+        {
+            if (clusters[j].id() != clusterId)
+            {
+                continue;
+            }
+
+            // replace a stale entry for the same key or the oldest
+            ClusterCacheEntry *e = nullptr;
+            for (ClusterCacheEntry &x : node->clusterCache)
+            {
+                if (x.clusterId == clusterId && x.endpoint == endpoint && x.side == side)
+                {
+                    e = &x;
+                    break;
+                }
+            }
+
+            if (!e)
+            {
+                e = &node->clusterCache[node->clusterCacheIter % node->clusterCache.size()];
+                node->clusterCacheIter++;
+            }
+
+            e->clusterId = clusterId;
+            e->clusterIndex = uint16_t(j);
+            e->endpoint = endpoint;
+            e->side = uint8_t(side);
+            e->sdIndex = uint8_t(i);
+            return &clusters[j];
+        }
+        break;
+    }
+
+    return nullptr;
+}
+
 void zmController::visualizeNodeIndication(NodeInfo *node, deCONZ::Indication indication)
 {
     if (node && node->g && indication != deCONZ::IndicateNone)
@@ -10475,7 +11656,7 @@ void zmController::fastPrope(uint64_t ext, uint16_t nwk, uint8_t macCapabilities
 
 void zmController::wakeNode(NodeInfo *node)
 {
-    if (node && node->data && node->g)
+    if (node && node->data)
     {
         node->data->setState(deCONZ::IdleState);
         CoreNode_NotifyDeviceChanged(node->data->address().ext(), "state");
@@ -10483,10 +11664,9 @@ void zmController::wakeNode(NodeInfo *node)
         CoreNode_NotifyDeviceChanged(node->data->address().ext(), "zombie");
         node->data->touch(m_steadyTimeRef);
         node->data->setFetched(deCONZ::ReqMgmtLqi, false);
-        node->g->show();
-        node->g->requestUpdate();
+        NI_SetVisible(node, true);
         NodeEvent event(NodeEvent::NodeAdded, node->data);
-        emit nodeEvent(event);
+        dispatchNodeEvent(event);
     }
 }
 
@@ -10561,6 +11741,8 @@ void zmController::appAboutToQuit()
         // force save on quit
         if (node.data && node.g)
             node.g->setNeedSaveToDatabase(true);
+        else if (node.data)
+            node.needSaveToDatabase = true;
     }
 
     queueSaveNodesState();
@@ -10618,6 +11800,123 @@ void zmController::setFastNeighborDiscovery(bool fastDiscovery)
     m_fastDiscovery = fastDiscovery;
 }
 
+/*! Starts a scan of the neighbor and routing tables of all routers.
+
+    The tables are read page by page via the discovery scheduler and merged as they
+    arrive. In \p fast mode twice as many routers are queried in parallel without
+    spacing between requests, this is meant for maintenance windows.
+ */
+void zmController::startTopologyScan(bool fast)
+{
+    if (m_topologyScan.active)
+    {
+        DBG_Printf(DBG_INFO, "topology scan already running, %u / %u routers\n", m_topologyScan.done, m_topologyScan.routers);
+        m_topologyScan.fast = fast;
+        return;
+    }
+
+    m_topologyScan = {};
+    m_topologyScan.started = m_steadyTimeRef;
+    m_topologyScan.fast = fast;
+
+    for (NodeInfo &node : m_nodes)
+    {
+        node.topologyScan = 0;
+        node.topologyScanTries = 0;
+
+        if (!node.data || node.data->isEndDevice() || node.data->isZombie() || !node.data->address().hasNwk())
+        {
+            continue;
+        }
+
+        node.topologyScan = TopoScanPending;
+        node.data->setMgmtLqiStartIndex(0x00);
+        scheduleDiscovery(&node, deCONZ::ReqMgmtLqi, m_steadyTimeRef);
+        m_topologyScan.routers++;
+    }
+
+    m_topologyScan.active = m_topologyScan.routers > 0;
+
+    DBG_Printf(DBG_INFO, "topology scan started for %u routers%s\n", m_topologyScan.routers, fast ? " (fast)" : "");
+    emit topologyScanChanged();
+}
+
+/*! Accounts a received page of the neighbor or routing \p table of a router during a topology scan. */
+void zmController::topologyScanPage(NodeInfo *node, uint8_t table, bool complete)
+{
+    if (!m_topologyScan.active || !(node->topologyScan & TopoScanPending))
+    {
+        return;
+    }
+
+    m_topologyScan.pages++;
+    node->topologyScanTries = 0;
+
+    if (!complete)
+    {
+        return;
+    }
+
+    node->topologyScan |= table;
+
+    if ((node->topologyScan & (TopoScanLqi | TopoScanRtg)) == (TopoScanLqi | TopoScanRtg))
+    {
+        topologyScanNodeDone(node, true);
+    }
+    else if (table == TopoScanLqi)
+    {
+        scheduleDiscovery(node, deCONZ::ReqMgmtLqi, m_steadyTimeRef); // continue with routing table
+    }
+}
+
+void zmController::topologyScanNodeDone(NodeInfo *node, bool success)
+{
+    if (!(node->topologyScan & TopoScanPending))
+    {
+        return;
+    }
+
+    node->topologyScan = 0;
+    m_topologyScan.done++;
+
+    if (!success)
+    {
+        m_topologyScan.failed++;
+        DBG_Printf(DBG_ZDP, "topology scan failed for %s\n", node->data->extAddressString().c_str());
+    }
+
+    if (m_topologyScan.done >= m_topologyScan.routers)
+    {
+        finishTopologyScan();
+    }
+    else
+    {
+        emit topologyScanChanged();
+    }
+}
+
+void zmController::finishTopologyScan()
+{
+    if (!m_topologyScan.active)
+    {
+        return;
+    }
+
+    for (NodeInfo &node : m_nodes)
+    {
+        node.topologyScan = 0;
+    }
+
+    m_topologyScan.active = false;
+    m_topologyScan.finished = m_steadyTimeRef;
+
+    const deCONZ::TimeMs dt = m_topologyScan.finished - m_topologyScan.started;
+    DBG_Printf(DBG_INFO, "topology scan finished, %u / %u routers (%u failed), %u pages in %d s\n",
+               m_topologyScan.done, m_topologyScan.routers, m_topologyScan.failed, m_topologyScan.pages, int(dt.val / 1000));
+
+    emit topologyScanChanged();
+}
+
 void zmController::setMinLqiDisplay(int minLqi)
 {
     if (m_minLqiDisplay == minLqi)
@@ -10660,6 +11959,262 @@ void zmController::addNodePlugin(NodeInterface *plugin)
             connect(m_restPlugin, SIGNAL(nodeUpdated(quint64,QString,QString)),
                     this, SLOT(onRestNodeUpdated(quint64,QString,QString)));
         }
+
+        addSubscriber(dynamic_cast<QObject*>(plugin));
+    }
+}
+
+/*! Moves receivers of a broadcast \p signal in the plugin object tree to filtered delivery.
+
+    Plugins often connect a private implementation object instead of the plugin
+    object itself. Every object of the tree having a slot \p slotSignature gets its
+    broadcast connections removed and becomes a subscriber, so nothing is delivered
+    to it twice. Objects without such a slot are left on the broadcast signal.
+    Returns the number of objects taken over.
+ */
+static int SUB_TakeOverReceivers(QObject *sender, const QMetaMethod &signal, const QObjectList &objects, const char *slotSignature,
+                                 QMetaMethod IndicationSubscriber::*slot, std::vector<IndicationSubscriber> &subs)
+{
+    int count = 0;
+    const QByteArray sig = QMetaObject::normalizedSignature(slotSignature);
+
+    const auto addSubscriber = [&](QObject *obj, int idx)
+    {
+        auto i = std::find_if(subs.begin(), subs.end(), [obj](const IndicationSubscriber &s) { return s.receiver == obj; });
+        if (i == subs.end())
+        {
+            subs.emplace_back();
+            i = subs.end() - 1;
+            i->receiver = obj;
+        }
+
+        (*i).*slot = obj->metaObject()->method(idx);
+        count++;
+    };
+
+    for (QObject *obj : objects)
+    {
+        const int idx = obj->metaObject()->indexOfSlot(sig.constData());
+        if (idx >= 0 && QObject::disconnect(sender, signal, obj, QMetaMethod()))
+        {
+            addSubscriber(obj, idx);
+        }
+    }
+
+    if (count == 0 && !objects.isEmpty()) // not connected, the plugin relies on the subscription only
+    {
+        const int idx = objects.front()->metaObject()->indexOfSlot(sig.constData());
+        if (idx >= 0)
+        {
+            addSubscriber(objects.front(), idx);
+        }
+    }
+
+    return count;
+}
+
+/*! Registers a plugin for filtered delivery if it declares subscriptions.
+    See IndicationSubscriber for the properties.
+ */
+void zmController::addSubscriber(QObject *plugin)
+{
+    if (!plugin)
+    {
+        return;
+    }
+
+    const QStringList apsFilter = plugin->property("subscribe.aps").toStringList();
+    const QVariantList eventFilter = plugin->property("subscribe.events").toList();
+
+    if (apsFilter.isEmpty() && eventFilter.isEmpty())
+    {
+        return; // gets everything via broadcast signals
+    }
+
+    const QMetaObject *meta = plugin->metaObject();
+    const QByteArray apsSlotSignature = QMetaObject::normalizedSignature("apsdeDataIndication(const deCONZ::ApsDataIndication&)");
+    const QByteArray eventSlotSignature = QMetaObject::normalizedSignature("nodeEvent(const deCONZ::NodeEvent&)");
+    QObjectList objects{plugin}; // plugin first, followed by children which can receive
+
+    for (QObject *obj : plugin->findChildren<QObject*>())
+    {
+        if (obj->metaObject()->indexOfSlot(apsSlotSignature.constData()) >= 0 ||
+            obj->metaObject()->indexOfSlot(eventSlotSignature.constData()) >= 0)
+        {
+            objects.push_back(obj);
+        }
+    }
+
+    // worst case every receiving object of the tree becomes a subscriber
+    if (m_subscribers.size() + size_t(objects.size()) > MaxSubscribers)
+    {
+        DBG_Printf(DBG_ERROR, "too many subscribers, %s uses broadcast\n", meta->className());
+        return;
+    }
+
+    std::vector<IndicationSubscriber> subs;
+    int apsReceivers = 0;
+
+    if (!apsFilter.isEmpty())
+    {
+        apsReceivers = SUB_TakeOverReceivers(this, QMetaMethod::fromSignal(&deCONZ::ApsController::apsdeDataIndication), objects,
+                                             apsSlotSignature.constData(), &IndicationSubscriber::apsSlot, subs);
+    }
+
+    if (!eventFilter.isEmpty())
+    {
+        SUB_TakeOverReceivers(this, QMetaMethod::fromSignal(&deCONZ::ApsController::nodeEvent), objects,
+                              eventSlotSignature.constData(), &IndicationSubscriber::eventSlot, subs);
+    }
+
+    if (subs.empty())
+    {
+        DBG_Printf(DBG_ERROR, "%s has subscriptions but no matching slots\n", meta->className());
+        return;
+    }
+
+    uint64_t eventMask = 0;
+    for (const QVariant &ev : eventFilter)
+    {
+        const uint e = ev.toUInt();
+        eventMask |= e < 64 ? (1ULL << e) : 0;
+    }
+
+    std::vector<ApsDispatchEntry> apsEntries;
+    if (apsReceivers > 0)
+    {
+        for (const QString &entry : apsFilter)
+        {
+            const QStringList ls = entry.split(QLatin1Char(':'));
+            if (ls.size() < 2 || ls.size() > 3)
+            {
+                DBG_Printf(DBG_ERROR, "invalid APS subscription %s\n", qPrintable(entry));
+                continue;
+            }
+
+            bool ok1 = true;
+            bool ok2 = true;
+            bool ok3 = true;
+            const uint profileId = ls[0] == QLatin1String("*") ? 0xFFFF : ls[0].toUInt(&ok1, 16);
+            const uint clusterId = ls[1].toUInt(&ok2, 16);
+            const uint endpoint = (ls.size() < 3 || ls[2] == QLatin1String("*")) ? 0xFF : ls[2].toUInt(&ok3, 16);
+
+            if (!ok1 || !ok2 || !ok3 || profileId > 0xFFFF || clusterId > 0xFFFF || endpoint > 0xFF)
+            {
+                DBG_Printf(DBG_ERROR, "invalid APS subscription %s\n", qPrintable(entry));
+                continue;
+            }
+
+            ApsDispatchEntry e;
+            e.key = (profileId << 16) | clusterId;
+            e.endpoint = uint8_t(endpoint);
+            apsEntries.push_back(e);
+        }
+    }
+
+    for (IndicationSubscriber &sub : subs)
+    {
+        const uint8_t subIndex = uint8_t(m_subscribers.size());
+
+        if (sub.apsSlot.isValid())
+        {
+            for (ApsDispatchEntry e : apsEntries)
+            {
+                e.subscriber = subIndex;
+                m_apsDispatch.push_back(e);
+            }
+        }
+
+        if (sub.eventSlot.isValid())
+        {
+            sub.eventMask = eventMask;
+        }
+
+        DBG_Printf(DBG_INFO, "%s (%s) subscribed to %d APS filters, %d node events\n", meta->className(), sub.receiver->metaObject()->className(),
+                   sub.apsSlot.isValid() ? int(apsEntries.size()) : 0, sub.eventSlot.isValid() ? int(eventFilter.size()) : 0);
+        m_subscribers.push_back(sub);
+    }
+
+    std::sort(m_apsDispatch.begin(), m_apsDispatch.end(), [](const ApsDispatchEntry &a, const ApsDispatchEntry &b) { return a.key < b.key; });
+}
+
+/*! Delivers an indication to broadcast receivers and matching subscribers.
+
+    The dispatch table is sorted by (profile, cluster), a lookup is done for the
+    exact profile and for subscriptions matching any profile.
+ */
+void zmController::dispatchApsIndication(const deCONZ::ApsDataIndication &ind)
+{
+    emit apsdeDataIndication(ind);
+
+    if (m_apsDispatch.empty())
+    {
+        return;
+    }
+
+    uint32_t delivered = 0; // bit per subscriber
+    const uint32_t keys[2] = { (uint32_t(ind.profileId()) << 16) | ind.clusterId(), (0xFFFFU << 16) | ind.clusterId() };
+
+    for (const uint32_t key : keys)
+    {
+        auto i = std::lower_bound(m_apsDispatch.cbegin(), m_apsDispatch.cend(), key, [](const ApsDispatchEntry &e, uint32_t k) { return e.key < k; });
+
+        for (; i != m_apsDispatch.cend() && i->key == key; ++i)
+        {
+            if (i->endpoint != 0xFF && i->endpoint != ind.dstEndpoint())
+            {
+                continue;
+            }
+
+            if (delivered & (1U << i->subscriber))
+            {
+                continue;
+            }
+
+            delivered |= 1U << i->subscriber;
+            IndicationSubscriber &sub = m_subscribers[i->subscriber];
+            sub.apsDeliveries++;
+            sub.apsSlot.invoke(sub.receiver, Qt::DirectConnection, Q_ARG(deCONZ::ApsDataIndication, ind));
+        }
+
+        if (ind.profileId() == 0xFFFF)
+        {
+            break;
+        }
+    }
+}
+
+/*! Delivers a node event to broadcast receivers and subscribers of the event type. */
+void zmController::dispatchNodeEvent(const deCONZ::NodeEvent &event)
+{
+    emit nodeEvent(event);
+
+    const uint e = uint(event.event());
+    const uint64_t bit = e < 64 ? (1ULL << e) : ~0ULL;
+
+    for (IndicationSubscriber &sub : m_subscribers)
+    {
+        if (sub.eventSlot.isValid() && (sub.eventMask & bit))
+        {
+            sub.eventDeliveries++;
+            sub.eventSlot.invoke(sub.receiver, Qt::DirectConnection, Q_ARG(deCONZ::NodeEvent, event));
+        }
+    }
+}
+
+void zmController::printSubscriberStats()
+{
+    for (IndicationSubscriber &sub : m_subscribers)
+    {
+        if (!sub.receiver)
+        {
+            continue;
+        }
+
+        DBG_Printf(DBG_MEASURE, "subscriber %s, delivered %u APS indications, %u node events\n",
+                   sub.receiver->metaObject()->className(), sub.apsDeliveries, sub.eventDeliveries);
+        sub.apsDeliveries = 0;
+        sub.eventDeliveries = 0;
     }
 }
 
@@ -17,6 +17,8 @@
 #include <array>
 #include <vector>
 #include <QElapsedTimer>
+#include <QMetaMethod>
+#include <QPointer>
 
 #include "deconz/types.h"
 #include "deconz/binding_table.h"
@@ -144,6 +146,118 @@ struct FastDiscover
     };
 };
 
+/*! A plugin which receives only the APS indications and node events it subscribed for.
+
+    Plugins opt in via dynamic properties of their plugin object:
+
+      "subscribe.aps"    QStringList of "profile:cluster[:endpoint]" in hex, '*' matches any, e.g. "*:0019"
+      "subscribe.events" QVariantList of deCONZ::NodeEvent::Event values
+
+    The plugin object and its child objects which are connected to the apsdeDataIndication()
+    or nodeEvent() broadcast signals and have a slot of the same name are disconnected,
+    matching items are delivered to these slots instead. If none is connected the plugin
+    object itself is the receiver. Helper objects outside of the plugin object tree must
+    not connect to the broadcast signals, they would get every item in addition.
+ */
+struct IndicationSubscriber
+{
+    QPointer<QObject> receiver;
+    QMetaMethod apsSlot;
+    QMetaMethod eventSlot;
+    uint64_t eventMask = 0; // bit per NodeEvent::Event
+    uint32_t apsDeliveries = 0;
+    uint32_t eventDeliveries = 0;
+};
+
+struct ApsDispatchEntry
+{
+    uint32_t key; // profileId << 16 | clusterId, profile 0xFFFF matches any
+    uint8_t endpoint; // 0xFF matches any
+    uint8_t subscriber; // index in subscribers
+};
+
+/*! Scheduling classes of APS requests, lower values are served first. */
+enum ApsPriorityClass
+{
+    ApsPrioInteractive = 0, //!< ZCL cluster commands like on/off, level
+    ApsPrioOta = 1,         //!< OTA cluster 0x0019
+    ApsPrioReporting = 2,   //!< ZCL global commands: read, write, configure reporting, default response
+    ApsPrioDiscovery = 3,   //!< ZDP discovery and maintenance like Mgmt_Lqi
+    ApsPrioMax
+};
+
+/*! Scheduling data of a queued APS request, kept parallel to the request queue. */
+struct ApsRequestMeta
+{
+    deCONZ::SteadyTimeRef enqueued;
+    deCONZ::SteadyTimeRef deadline; //!< optional, expired requests are confirmed as MAC transaction expired
+    uint64_t sentUs = 0; //!< MET_TimeUs() when passed to the firmware, 0 if not sent yet
+    uint8_t prio = ApsPrioReporting;
+};
+
+/*! Queueing delay per priority class, see zmController::printApsQueueStats(). */
+struct ApsQueueStats
+{
+    int64_t delaySumMs = 0;
+    int64_t delayMaxMs = 0;
+    uint32_t sent = 0;
+    uint32_t expired = 0;
+};
+
+/*! A discovery task of a node which is due at a given time.
+
+    The item is the ZDP request to fetch, ReqMgmtLqi for the neighbor table and
+    ReqUnknown for the zombie check. Tasks are kept in a min heap by due time,
+    see zmController::discoveryTick().
+ */
+struct DiscoveryTask
+{
+    deCONZ::SteadyTimeRef due;
+    uint64_t extAddress;
+    uint32_t seq; // keeps order of tasks with the same due time
+    deCONZ::RequestId item;
+};
+
+/*! Result of processing a DiscoveryTask. */
+enum DiscoveryResult
+{
+    DiscoveryDone,  //!< nothing to do, rescheduled on fetch state changes
+    DiscoverySent,  //!< request sent, consumes airtime budget
+    DiscoveryBusy,  //!< node is busy, try again shortly
+    DiscoveryWait,  //!< node is not ready, try again later
+    DiscoveryDefer, //!< Mgmt_Lqi rate limit, retry at m_lqiNextSlot
+    DiscoveryStop   //!< keep due time, global limits reached
+};
+
+/*! Counters of the discovery scheduler, see zmController::printDiscoveryStats(). */
+struct DiscoveryStats
+{
+    uint32_t sent = 0;
+    uint32_t busy = 0;
+    uint32_t stale = 0;
+};
+
+/*! Per node flags of a topology scan, see NodeInfo::topologyScan. */
+enum TopologyScanFlags
+{
+    TopoScanPending = 0x01, //!< router is part of the current scan
+    TopoScanLqi     = 0x02, //!< neighbor table is complete
+    TopoScanRtg     = 0x04  //!< routing table is complete
+};
+
+/*! Progress of a network wide neighbor and routing table scan, see zmController::startTopologyScan(). */
+struct TopologyScan
+{
+    deCONZ::SteadyTimeRef started;
+    deCONZ::SteadyTimeRef finished;
+    uint32_t routers = 0;
+    uint32_t done = 0;
+    uint32_t failed = 0;
+    uint32_t pages = 0; // Mgmt_Lqi_rsp and Mgmt_Rtg_rsp
+    bool active = false;
+    bool fast = false;
+};
+
 enum LinkViewMode
 {
     LinkShowAge,
@@ -153,6 +267,8 @@ enum LinkViewMode
 QString createUuid(const QString &prefix);
 void generateUniqueId2(uint64_t extAddress, char *buf, unsigned buflen);
 void CoreNode_NotifyDeviceChanged(uint64_t mac, const char *path);
+int CoreNode_AddSourceRoute(deCONZ::zmNode *node, const deCONZ::SourceRoute &sourceRoute);
+int CoreNode_RemoveSourceRoute(deCONZ::zmNode *node, uint uuidHash);
 
 class zmController : public deCONZ::ApsController
 {
@@ -174,6 +290,7 @@ public:
     int nodeCount() const { return static_cast<int>(m_nodes.size()); }
     NodeInfo nodeAt(size_t index);
     NodeInfo nodeWithMac(uint64_t mac);
+    void nodeModified(uint64_t mac, const char *path, uint64_t mtime);
     int zclCommandRequest(const deCONZ::Address &address, deCONZ::ApsAddressMode addressMode, const deCONZ::SimpleDescriptor &simpleDescriptor, const deCONZ::ZclCluster &cluster, const deCONZ::ZclCommand &command);
     const deCONZ::SimpleDescriptor *getCompatibleEndpoint(const deCONZ::SimpleDescriptor &other);
     void setNetworkConfig(const zmNet &net, const uint8_t *items);
@@ -189,9 +306,11 @@ public:
     void setDeviceState(deCONZ::State state);
     void unregisterGNode(zmgNode *gnode);
     void addNodePlugin(deCONZ::NodeInterface *plugin);
+    void dispatchNodeEvent(const deCONZ::NodeEvent &event);
     int apsQueueSize();
     int apsdeDataRequest(const deCONZ::ApsDataRequest &req);
     int checkIdOverFlowApsDataRequest(const deCONZ::ApsDataRequest &req);
+    bool setApsRequestDeadline(uint8_t id, deCONZ::TimeMs maxDelay);
     int resolveAddress(deCONZ::Address &addr);
     deCONZ::State networkState();
     int setNetworkState(deCONZ::State state);
@@ -234,6 +353,8 @@ public:
     void onNodeSelected(uint64_t mac);
     void onNodeDeselected(uint64_t mac);
     uint8_t nextRequestId();
+    void fetchStateChanged(deCONZ::zmNode *node, deCONZ::RequestId item);
+    const TopologyScan &topologyScan() const { return m_topologyScan; }
 
 private slots:
     void onMasterStateChanged();
@@ -258,8 +379,7 @@ private slots:
     void linkTick();
     void neighborTick();
     void timeoutTick();
-    void fetchZdpTick();
-    void zombieTick();
+    void discoveryTick();
     void linkCreateTick();
     void bindLinkTick();
     void bindTick();
@@ -274,6 +394,7 @@ Q_SIGNALS:
     void sourceRouteMinLqiChanged(int sourceRouteMinLqi);
     void sourceRouteMaxHopsChanged(int sourceRouteMmaxHops);    
     void sourceRoutingEnabledChanged(bool sourceRoutingEnabled);
+    void topologyScanChanged();
 
 protected:
     void timerEvent(QTimerEvent *event);
@@ -303,6 +424,7 @@ public slots:
     void setSourceRouteMaxHops(int sourceRouteMmaxHops);
     void setSourceRoutingEnabled(bool sourceRoutingEnabled);
     void setFastNeighborDiscovery(bool fastDiscovery);
+    void startTopologyScan(bool fast);
     void setMinLqiDisplay(int minLqi);
 
 private:
@@ -342,6 +464,23 @@ private:
 
     NodeInfo *getNode(const deCONZ::Address &addr, deCONZ::AddressMode mode);
     NodeInfo *getNode(deCONZ::zmNode *dnode);
+    void scheduleDiscovery(NodeInfo *node, deCONZ::RequestId item, deCONZ::SteadyTimeRef due);
+    void scheduleNodeDiscovery(NodeInfo *node);
+    int fetchFastDiscover();
+    int fetchZdp(deCONZ::zmNode *node, deCONZ::RequestId item, FastDiscover *fastDiscoverNode);
+    int fetchMgmtLqi(NodeInfo *node);
+    int checkZombie(NodeInfo *info);
+    void topologyScanPage(NodeInfo *node, uint8_t table, bool complete);
+    void topologyScanNodeDone(NodeInfo *node, bool success);
+    void finishTopologyScan();
+    void printDiscoveryStats();
+    void addSubscriber(QObject *plugin);
+    void dispatchApsIndication(const deCONZ::ApsDataIndication &ind);
+    void printSubscriberStats();
+    int sendNextApsdeDataRequestOfClass(NodeInfo *dst, int prio);
+    std::vector<deCONZ::ApsDataRequest>::iterator eraseApsRequest(std::vector<deCONZ::ApsDataRequest>::iterator i);
+    ApsRequestMeta &apsRequestMeta(std::vector<deCONZ::ApsDataRequest>::const_iterator i) { return m_apsRequestMeta[size_t(i - m_apsRequestQueue.cbegin())]; }
+    void printApsQueueStats();
 
     deCONZ::SteadyTimeRef m_apsGroupIndicationTimeRef;
     int m_apsGroupDelayMs = 0;
@@ -369,17 +508,14 @@ private:
     int m_fetchZdpDelay;
     qint64 m_fetchMgmtLqiDelay;
     int m_timer;
+    uint64_t m_tickTimeUs = 0;
     int m_timeoutTimer;
     int m_otauActivity;
     int m_zombieDelay;
-    int m_nodeZombieIter;
     int m_zombieCount;
-    size_t m_discoverIter;
-    size_t m_lqiIter;
     int m_linkIter;
     deCONZ::SteadyTimeRef m_linkUpdateTime;
     int m_neibIter;
-    int m_fetchCurNode;
     bool m_waitForQueueEmpty;
     bool m_autoFetchFFD;
     bool m_autoFetchRFD;
@@ -397,7 +533,22 @@ private:
     QString m_devName;
     QByteArray m_securityMaterial0;
     std::vector<FastDiscover> m_fastDiscover;
+    std::vector<DiscoveryTask> m_discoveryTasks; // min heap by due time
+    std::vector<DiscoveryTask> m_zombieTasks; // min heap by due time, no airtime needed
+    deCONZ::SteadyTimeRef m_lqiNextSlot; // earliest time for the next Mgmt_Lqi_req
+    uint32_t m_discoverySeq = 0;
+    int m_discoveryRate = 8; // requests per second
+    double m_discoveryBudget = 0;
+    deCONZ::SteadyTimeRef m_discoveryBudgetTime;
+    DiscoveryStats m_discoveryStats;
+    deCONZ::SteadyTimeRef m_discoveryStatsTime;
+    TopologyScan m_topologyScan;
+    int m_topologyParallel = 2; // Mgmt_Lqi/Rtg requests in flight during a scan
+    std::vector<IndicationSubscriber> m_subscribers;
+    std::vector<ApsDispatchEntry> m_apsDispatch; // sorted by key
+    deCONZ::SteadyTimeRef m_subscriberStatsTime;
     std::vector<NodeInfo> m_nodes;
+    QHash<uint64_t, size_t> m_nodeIndexByMac; // cache for getNode(), validated on use
     std::vector<NodeInfo> m_nodesDead;
     std::vector<deCONZ::SourceRoute> m_routes;
     QList<LinkInfo> m_neighbors;
@@ -408,6 +559,11 @@ private:
     QList<AddressPair> m_deviceDiscoverQueue;
     QList<AddressPair> m_createLinkQueue;
     std::vector<deCONZ::ApsDataRequest> m_apsRequestQueue;
+    std::vector<ApsRequestMeta> m_apsRequestMeta; // same index as m_apsRequestQueue, see eraseApsRequest()
+    std::array<int, ApsPrioMax> m_apsPrioCredits{};
+    std::array<ApsQueueStats, ApsPrioMax> m_apsQueueStats{};
+    deCONZ::TimeMs m_apsInteractiveDeadline{0};
+    deCONZ::SteadyTimeRef m_apsQueueStatsTime;
     std::vector<zmgSourceRoute*> m_gsourceRoutes;
     int m_apsBusyCounter;
     LinkViewMode m_linkViewMode;
@@ -46,6 +46,9 @@
 #define NODE_COLOR_DARK    180, 180, 180
 
 extern void NV_AddNodeIndicator(void *user, int runs); // defined in zm_graphicsview.cpp
+extern bool NV_QueueNodeIndication(void *user, bool important); // defined in zm_graphicsview.cpp
+extern void NV_AddNode(zmgNode *node); // defined in zm_graphicsview.cpp
+extern void NV_RemoveNode(zmgNode *node); // defined in zm_graphicsview.cpp
 
 static const int NamePad = 64;
 static const int NamePointSize = 10;
@@ -205,10 +208,13 @@ zmgNode::zmgNode(deCONZ::zmNode *data, QGraphicsItem *parent) :
 
     m_indicator = new QGraphicsEllipseItem(m_indRect, this);
     resetIndicator();
+
+    NV_AddNode(this);
 }
 
 zmgNode::~zmgNode()
 {
+    NV_RemoveNode(this);
 }
 
 QRectF zmgNode::boundingRect() const
@@ -326,6 +332,35 @@ void zmgNode::indicate(deCONZ::Indication type)
 
     Q_ASSERT(type < 6);
 
+    // coalesce until the next GUI flush, errors are never overwritten
+    if (m_indQueued)
+    {
+        if (m_indPending != deCONZ::IndicateError)
+        {
+            m_indPending = type;
+        }
+        return;
+    }
+
+    if (NV_QueueNodeIndication(this, type == deCONZ::IndicateError))
+    {
+        m_indQueued = true;
+        m_indPending = type;
+    }
+}
+
+/*! Starts the pending indication animation, called from the view at most once per display frame. */
+void zmgNode::startIndication()
+{
+    const deCONZ::Indication type = m_indPending;
+    m_indQueued = false;
+    m_indPending = deCONZ::IndicateNone;
+
+    if (type == deCONZ::IndicateNone)
+    {
+        return;
+    }
+
     static const IndicationDef indicationDef[] = {
          {0, 0, 1, QColor(NODE_COLOR_DARK) }, // None
          {IndGeneralInterval, IndGeneralCount, 1, QColor(Qt::green) }, // Receive
@@ -1180,6 +1215,25 @@ void NV_IndicatorCallback(void *user)
     }
 }
 
+void NV_IndicationFlushCallback(void *user)
+{
+    zmgNode *node = static_cast<zmgNode*>(user);
+
+    if (node)
+    {
+        node->startIndication();
+    }
+}
+
+void NV_NodeMovedCallback(zmgNode *node)
+{
+    if (node)
+    {
+        node->setNeedSaveToDatabase(true);
+        SendNotifyMessageMoved(node->data() ? node->data()->address().ext() : 0, node->pos());
+    }
+}
+
 void zmgNode::resetIndicator()
 {
     const QColor bg = indicatorBackGroundColor();
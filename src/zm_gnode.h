@@ -94,6 +94,7 @@ public:
     void setLastSeen(qint64 lastSeen);
     void setHasDDF(int hasDDF);
     void indicationTick();
+    void startIndication();
     void vfsModelUpdated(const QModelIndex &index);
 
 signals:
@@ -130,6 +131,8 @@ private:
     const IndicationDef *m_indDef = nullptr;
     int m_indCount = 0;
     deCONZ::Indication m_indType;
+    deCONZ::Indication m_indPending = deCONZ::IndicateNone;
+    bool m_indQueued = false;
     QRectF m_indRect;
     QString m_name;
     QString m_extAddress;
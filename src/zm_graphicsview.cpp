@@ -8,18 +8,26 @@
  *
  */
 
+#include <QElapsedTimer>
+#include <QGuiApplication>
 #include <QMimeData>
+#include <QScreen>
 #include <QTimerEvent>
 #include <QPixmap>
 #include <QWheelEvent>
 #include <qmath.h>
+#include <algorithm>
 #include <vector>
 #include "deconz/atom_table.h"
 #include "deconz/dbg_trace.h"
 #include "deconz/u_sstream_ex.h"
+#include "deconz/util.h"
 #include "gui/gnode_link_group.h"
+#include "zm_glink.h"
 #include "zm_graphicsview.h"
 #include "zm_gnode.h"
+#include "zm_gsocket.h"
+#include "zm_node.h"
 #include "actor_vfs_model.h"
 
 struct NodeIndicator
@@ -28,16 +36,57 @@ struct NodeIndicator
     int runs;
 };
 
+/*! Per node state of the force directed layout.
+
+    Nodes are sorted by \c cell so that all nodes of a grid cell form a
+    contiguous range which can be looked up via binary search.
+ */
+struct LayoutItem
+{
+    zmgNode *node;
+    uint64_t cell;
+    QPointF pos; // center in scene coordinates
+    QPointF disp;
+    bool pinned;
+};
+
 class GraphicsViewPrivate
 {
 public:
     QTimer *m_marginTimer;
     int m_moveTimer;
     int m_indicationTimer;
+    int m_layoutSteps = 0;
+    qreal m_layoutTemperature = 0;
+    int m_flushTimer = 0;
+    int m_flushIntervalMs = 16;
     NodeLinkGroup *m_nodeLinkGroup;
     std::vector<NodeIndicator> indicators;
+    std::vector<void*> pendingIndications; // flushed at most once per display frame
+
+    // rate limiting and instrumentation of GUI updates
+    int m_maxIndicationRate = 0; // per second, above the view degrades
+    bool m_degraded = false;
+    unsigned m_indQueuedCount = 0;
+    unsigned m_indFlushedCount = 0;
+    unsigned m_indDroppedCount = 0;
+    qint64 m_guiTimeNs = 0;
+    QElapsedTimer m_statTimer;
+    std::vector<zmgNode*> nodes; // maintained by NV_AddNode() and NV_RemoveNode()
+    std::vector<LayoutItem> layout;
+    std::vector<std::pair<const zmgNode*, size_t>> layoutIndex; // sorted by node
 };
 
+namespace {
+    const int LayoutTickMs = 40;
+    const int LayoutMaxSteps = 400;
+    const qreal LayoutIdealDistance = 260; // preferred distance between linked nodes
+    const qreal LayoutCutoff = 2 * LayoutIdealDistance; // no repulsion beyond
+    const qreal LayoutStartTemperature = 120; // max. displacement per step
+    const qreal LayoutMinTemperature = 1.5;
+    const qreal LayoutCooling = 0.97;
+}
+
 static zmGraphicsView *inst;
 static GraphicsViewPrivate *inst_d;
 static AT_AtomIndex ati_state;
@@ -46,6 +95,70 @@ static AT_AtomIndex ati_devices;
 
 // defined in zm_gnode.cpp
 extern void NV_IndicatorCallback(void *user);
+extern void NV_IndicationFlushCallback(void *user);
+extern void NV_NodeMovedCallback(zmgNode *node);
+
+/*! Queues a node indication which is started in the next display frame.
+
+    Returns false if the indication was dropped since the view is in degrade mode.
+    \param important - true if the indication must not be dropped (errors)
+ */
+bool NV_QueueNodeIndication(void *user, bool important)
+{
+    if (!inst || !inst_d)
+        return false;
+
+    inst_d->m_indQueuedCount++;
+
+    if (inst_d->m_degraded && !important)
+    {
+        inst_d->m_indDroppedCount++;
+        return false;
+    }
+
+    inst_d->pendingIndications.push_back(user);
+
+    if (inst_d->m_flushTimer == 0)
+    {
+        inst_d->m_flushTimer = inst->startTimer(inst_d->m_flushIntervalMs, Qt::PreciseTimer);
+    }
+
+    return true;
+}
+
+void NV_AddNode(zmgNode *node)
+{
+    if (!inst_d || !node)
+        return;
+
+    auto i = std::find(inst_d->nodes.begin(), inst_d->nodes.end(), node);
+
+    if (i == inst_d->nodes.end())
+    {
+        inst_d->nodes.push_back(node);
+    }
+}
+
+void NV_RemoveNode(zmgNode *node)
+{
+    if (!inst_d)
+        return;
+
+    auto i = std::find(inst_d->nodes.begin(), inst_d->nodes.end(), node);
+
+    if (i != inst_d->nodes.end())
+    {
+        *i = inst_d->nodes.back();
+        inst_d->nodes.pop_back();
+    }
+
+    void *user = node;
+    auto &pending = inst_d->pendingIndications;
+    pending.erase(std::remove(pending.begin(), pending.end(), user), pending.end());
+
+    auto &ind = inst_d->indicators;
+    ind.erase(std::remove_if(ind.begin(), ind.end(), [user](const NodeIndicator &x){ return x.user == user; }), ind.end());
+}
 
 void NV_AddNodeIndicator(void *user, int runs)
 {
@@ -93,6 +206,14 @@ zmGraphicsView::zmGraphicsView(QWidget *parent) :
     inst_d = d_ptr;
 
     d_ptr->m_indicationTimer = startTimer(500);
+    d_ptr->m_maxIndicationRate = deCONZ::appArgumentNumeric("--gui-ind-max-rate", 250);
+    d_ptr->m_statTimer.start();
+
+    const QScreen *screen = QGuiApplication::primaryScreen();
+    if (screen && screen->refreshRate() > 1.0)
+    {
+        d_ptr->m_flushIntervalMs = qMax(8, int(1000.0 / screen->refreshRate()));
+    }
 
     AT_AddAtom("config", qstrlen("config"), &ati_config);
     AT_AddAtom("state", qstrlen("state"), &ati_state);
@@ -147,14 +268,21 @@ void zmGraphicsView::setScene(QGraphicsScene *scene)
 
 void zmGraphicsView::timerEvent(QTimerEvent *event)
 {
-    if (d_ptr->m_indicationTimer == event->timerId())
+    if (d_ptr->m_flushTimer == event->timerId())
+    {
+        killTimer(d_ptr->m_flushTimer);
+        d_ptr->m_flushTimer = 0;
+        flushIndications();
+    }
+    else if (d_ptr->m_indicationTimer == event->timerId())
     {
         processIndications();
+        updateIndicationStats();
+    }
+    else if (d_ptr->m_moveTimer && d_ptr->m_moveTimer == event->timerId())
+    {
+        processForces();
     }
-//    if (m_moveTimer && (event->timerId() == m_moveTimer))
-//    {
-//        // processForces();
-//    }
 }
 
 void zmGraphicsView::wheelEvent(QWheelEvent *event)
@@ -248,8 +376,86 @@ void zmGraphicsView::dropEvent(QDropEvent *event)
     }
 }
 
+/*! Starts all indications queued since the last display frame. */
+void zmGraphicsView::flushIndications()
+{
+    QElapsedTimer t;
+    t.start();
+
+    // swap since callbacks might queue again
+    std::vector<void*> pending;
+    pending.swap(d_ptr->pendingIndications);
+
+    for (void *user : pending)
+    {
+        NV_IndicationFlushCallback(user);
+    }
+
+    d_ptr->m_indFlushedCount += unsigned(pending.size());
+    pending.clear();
+
+    if (d_ptr->pendingIndications.empty())
+    {
+        d_ptr->pendingIndications.swap(pending); // keep capacity
+    }
+
+    d_ptr->m_guiTimeNs += t.nsecsElapsed();
+}
+
+/*! Evaluates the indication rate once per second and switches degrade mode.
+
+    In degrade mode only error indications are shown until the rate drops
+    below half of the configured maximum (--gui-ind-max-rate).
+ */
+void zmGraphicsView::updateIndicationStats()
+{
+    const qint64 dt = d_ptr->m_statTimer.elapsed();
+
+    if (dt < 1000)
+    {
+        return;
+    }
+
+    d_ptr->m_statTimer.restart();
+
+    const int rate = int((qint64(d_ptr->m_indQueuedCount) * 1000) / dt);
+    const bool degraded = d_ptr->m_degraded;
+
+    if (d_ptr->m_maxIndicationRate > 0)
+    {
+        if (!degraded && rate > d_ptr->m_maxIndicationRate)
+        {
+            d_ptr->m_degraded = true;
+        }
+        else if (degraded && rate < d_ptr->m_maxIndicationRate / 2)
+        {
+            d_ptr->m_degraded = false;
+        }
+    }
+
+    if (degraded != d_ptr->m_degraded)
+    {
+        DBG_Printf(DBG_INFO, "GUI indication degrade mode %s (%d/s)\n", d_ptr->m_degraded ? "on" : "off", rate);
+    }
+
+    if (DBG_IsEnabled(DBG_MEASURE) && d_ptr->m_indQueuedCount > 0)
+    {
+        DBG_Printf(DBG_MEASURE, "GUI indications %u queued, %u flushed, %u dropped, %d animated, main thread %.2f ms/s\n",
+                   d_ptr->m_indQueuedCount, d_ptr->m_indFlushedCount, d_ptr->m_indDroppedCount,
+                   int(d_ptr->indicators.size()), double(d_ptr->m_guiTimeNs) * 1000.0 / (1e6 * double(dt)));
+    }
+
+    d_ptr->m_indQueuedCount = 0;
+    d_ptr->m_indFlushedCount = 0;
+    d_ptr->m_indDroppedCount = 0;
+    d_ptr->m_guiTimeNs = 0;
+}
+
 void zmGraphicsView::processIndications()
 {
+    QElapsedTimer t;
+    t.start();
+
     for (size_t i = 0; i < d_ptr->indicators.size(); i++)
     {
         NodeIndicator &ind = d_ptr->indicators[i];
@@ -262,6 +468,8 @@ void zmGraphicsView::processIndications()
             d_ptr->indicators.pop_back();
         }
     }
+
+    d_ptr->m_guiTimeNs += t.nsecsElapsed();
 }
 
 void zmGraphicsView::vfsDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
@@ -373,43 +581,214 @@ void zmGraphicsView::onSceneRectChanged(const QRectF &rect)
     d_ptr->m_nodeLinkGroup->setSceneRect(rect.adjusted(-96, -96, 96, 96));
 }
 
-#if 0
+/*! Starts the force directed auto layout of all visible nodes.
+
+    The layout runs incrementally in timer ticks, each tick is O(n) for
+    typical meshes since repulsion is only calculated between nodes in
+    neighboring grid cells of size LayoutCutoff.
+ */
+void zmGraphicsView::startAutoLayout()
+{
+    d_ptr->m_layoutSteps = 0;
+    d_ptr->m_layoutTemperature = LayoutStartTemperature;
+
+    if (d_ptr->m_moveTimer == 0)
+    {
+        NodeLinkGroup::setRenderQuality(NodeLinkGroup::RenderQualityFast);
+        d_ptr->m_moveTimer = startTimer(LayoutTickMs);
+        DBG_Printf(DBG_INFO, "start auto layout of %d nodes\n", int(d_ptr->nodes.size()));
+    }
+}
+
+void zmGraphicsView::stopAutoLayout()
+{
+    if (d_ptr->m_moveTimer == 0)
+    {
+        return;
+    }
+
+    killTimer(d_ptr->m_moveTimer);
+    d_ptr->m_moveTimer = 0;
+    d_ptr->layout.clear();
+    d_ptr->layoutIndex.clear();
+    NodeLinkGroup::setRenderQuality(NodeLinkGroup::RenderQualityHigh);
+
+    for (zmgNode *node : d_ptr->nodes)
+    {
+        if (node->isVisible())
+        {
+            NV_NodeMovedCallback(node); // persist positions
+        }
+    }
+
+    DBG_Printf(DBG_INFO, "auto layout finished after %d steps\n", d_ptr->m_layoutSteps);
+    repaintAll();
+}
+
+static uint64_t layoutCell(qreal x, qreal y)
+{
+    const uint32_t cx = uint32_t(int32_t(qFloor(x / LayoutCutoff)));
+    const uint32_t cy = uint32_t(int32_t(qFloor(y / LayoutCutoff)));
+    return (uint64_t(cx) << 32) | cy;
+}
+
+static const LayoutItem *layoutItemForNode(const GraphicsViewPrivate *d, const zmgNode *node)
+{
+    const auto i = std::lower_bound(d->layoutIndex.cbegin(), d->layoutIndex.cend(), node,
+                                    [](const std::pair<const zmgNode*, size_t> &a, const zmgNode *n) { return a.first < n; });
+
+    if (node && i != d->layoutIndex.cend() && i->first == node)
+    {
+        return &d->layout[i->second];
+    }
+    return nullptr;
+}
+
+/*! One step of a Fruchterman-Reingold layout with grid cutoff.
+
+    Repulsion only considers nodes within the 3x3 neighboring cells,
+    attraction is applied along visible neighbor links.
+ */
 void zmGraphicsView::processForces()
 {
-    QList<zmgNode *> nodes;
-    foreach (QGraphicsItem *item, scene()->items())
+    std::vector<LayoutItem> &layout = d_ptr->layout;
+    layout.clear();
+
+    for (zmgNode *node : d_ptr->nodes)
     {
-        zmgNode *node = qgraphicsitem_cast<zmgNode *>(item);
-        if (node)
+        if (!node->isVisible())
         {
-            nodes.append(node);
+            continue;
         }
+
+        LayoutItem item;
+        item.node = node;
+        item.pos = node->pos() + node->boundingRect().center();
+        item.cell = layoutCell(item.pos.x(), item.pos.y());
+        item.disp = QPointF(0, 0);
+        item.pinned = node->isSelected() || (node->data() && node->data()->isCoordinator());
+        layout.push_back(item);
     }
 
-    foreach (zmgNode *node, nodes)
+    if (layout.size() < 2 || d_ptr->m_layoutSteps >= LayoutMaxSteps || d_ptr->m_layoutTemperature < LayoutMinTemperature)
     {
-        node->calculateForces();
+        stopAutoLayout();
+        return;
     }
 
-    bool itemsMoved = false;
-    foreach (zmgNode *node, nodes)
+    d_ptr->m_layoutSteps++;
+
+    std::sort(layout.begin(), layout.end(), [](const LayoutItem &a, const LayoutItem &b) { return a.cell < b.cell; });
+
+    d_ptr->layoutIndex.clear();
+    for (size_t i = 0; i < layout.size(); i++)
     {
-        QPointF pos = node->pos();
+        d_ptr->layoutIndex.emplace_back(layout[i].node, i);
+    }
+    std::sort(d_ptr->layoutIndex.begin(), d_ptr->layoutIndex.end());
 
-        node->advance(1);
-        if (pos != node->pos())
+    const auto cellLess = [](const LayoutItem &a, uint64_t cell) { return a.cell < cell; };
+    const qreal k2 = LayoutIdealDistance * LayoutIdealDistance;
+    const qreal cutoff2 = LayoutCutoff * LayoutCutoff;
+
+    // repulsion
+    for (LayoutItem &a : layout)
+    {
+        const uint32_t cx = uint32_t(a.cell >> 32);
+        const uint32_t cy = uint32_t(a.cell & 0xFFFFFFFF);
+
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            for (int dy = -1; dy <= 1; dy++)
+            {
+                const uint64_t cell = (uint64_t(uint32_t(cx + dx)) << 32) | uint32_t(cy + dy);
+                auto b = std::lower_bound(layout.begin(), layout.end(), cell, cellLess);
+
+                for (; b != layout.end() && b->cell == cell; ++b)
+                {
+                    if (b->node == a.node)
+                    {
+                        continue;
+                    }
+
+                    QPointF delta = a.pos - b->pos;
+                    qreal d2 = QPointF::dotProduct(delta, delta);
+
+                    if (d2 > cutoff2)
+                    {
+                        continue;
+                    }
+
+                    if (d2 < 1.0) // overlapping, push apart in a deterministic direction
+                    {
+                        delta = QPointF(a.node < b->node ? 1.0 : -1.0, 0.5);
+                        d2 = 1.0;
+                    }
+
+                    a.disp += delta * (k2 / d2);
+                }
+            }
+        }
+    }
+
+    // attraction along neighbor links
+    for (LayoutItem &a : layout)
+    {
+        for (int i = 0; i < a.node->linkCount(); i++)
+        {
+            NodeLink *link = a.node->link(i);
+            if (!link || !link->isVisible() || link->linkType() != NodeLink::LinkNormal || !link->src() || !link->dst())
+            {
+                continue;
+            }
+
+            QGraphicsItem *other = link->src()->parentItem();
+            if (other == a.node)
+            {
+                other = link->dst()->parentItem();
+            }
+
+            const LayoutItem *b = layoutItemForNode(d_ptr, qgraphicsitem_cast<zmgNode*>(other));
+            if (!b)
+            {
+                continue;
+            }
+
+            const QPointF delta = a.pos - b->pos;
+            const qreal d = qSqrt(QPointF::dotProduct(delta, delta));
+            a.disp -= delta * (d / LayoutIdealDistance);
+        }
+    }
+
+    // apply displacement limited by temperature
+    const qreal t = d_ptr->m_layoutTemperature;
+    qreal maxMove = 0;
+
+    for (LayoutItem &a : layout)
+    {
+        if (a.pinned)
         {
-            itemsMoved = true;
+            continue;
         }
+
+        const qreal len = qSqrt(QPointF::dotProduct(a.disp, a.disp));
+        if (len < 0.5)
+        {
+            continue;
+        }
+
+        const QPointF move = a.disp * (qMin(len, t) / len);
+        a.node->setPos(a.node->pos() + move);
+        maxMove = qMax(maxMove, qMin(len, t));
     }
 
-    if (!itemsMoved)
+    d_ptr->m_layoutTemperature *= LayoutCooling;
+
+    if (maxMove < 0.5)
     {
-        killTimer(m_moveTimer);
-        m_moveTimer = 0;
+        stopAutoLayout();
     }
 }
-#endif
 
 //void zmGraphicsView::displayNode(zmgNode *node)
 //{
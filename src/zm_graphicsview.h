@@ -32,7 +32,8 @@ public Q_SLOTS:
     void onSceneRectChanged(const QRectF &rect);
     void updateMargins();
     void repaintAll();
-//    void processForces();
+    void startAutoLayout();
+    void stopAutoLayout();
 
 protected:
     void timerEvent(QTimerEvent *event) override;
@@ -44,6 +45,9 @@ protected:
 
 private:
     void processIndications();
+    void flushIndications();
+    void updateIndicationStats();
+    void processForces();
     void vfsDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles = QVector<int>());
 
     GraphicsViewPrivate *d_ptr = nullptr;
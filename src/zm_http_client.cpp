@@ -22,11 +22,14 @@
 #include "deconz/dbg_trace.h"
 #include "deconz/http_client_handler.h"
 #include "deconz/util.h"
+#include "event_monitor.h"
+#include "metrics.h"
 #include "zm_http_client.h"
 #include "deconz/u_sstream.h"
 #include "deconz/timeref.h"
 
 #define MAX_HTTP_HEADER_LENGTH 8192
+#define MAX_METRICS_LENGTH 32768
 
 const char *HttpStatusOk           = "200 OK"; // OK
 const char *HttpStatusAccepted     = "202 Accepted"; // Accepted but not complete
@@ -50,6 +53,7 @@ const char *HttpContentFontTtf     = "application/x-font-ttf";
 const char *HttpContentFontWoff    = "application/font-woff";
 const char *HttpContentFontWoff2   = "application/font-woff2";
 const char *HttpContentRSS         = "application/rss+xml";
+const char *HttpContentMetrics     = "text/plain; version=0.0.4; charset=utf-8";
 
 // check socket state
 // netstat -anp --inet | grep deCONZ
@@ -153,6 +157,7 @@ enum UrlParseState
 
 void zmHttpClient::handleHttpRequest()
 {
+    EVM_Scope evm("zmHttpClient::handleHttpRequest");
     if (m_clientState == ClientIdle)
     {
         m_clientState = ClientRecvHeader;
@@ -280,6 +285,7 @@ void zmHttpClient::handleHttpRequest()
     }
 
     m_clientState = ClientIdle;
+    const uint64_t startUs = MET_TimeUs();
 
     // check if a handler is available
     for (auto *handler : m_handlers)
@@ -287,6 +293,7 @@ void zmHttpClient::handleHttpRequest()
         if (handler && handler->isHttpTarget(m_hdr))
         {
             const int ret = handler->handleHttpRequest(m_hdr, this);
+            MET_Observe(MET_HttpRequestTime, MET_TimeUs() - startUs);
 
             if (ret != 0)
             {
@@ -306,6 +313,7 @@ void zmHttpClient::handleHttpRequest()
     }
 
     handleHttpFileRequest(m_hdr);
+    MET_Observe(MET_HttpRequestTime, MET_TimeUs() - startUs);
     m_timer->stop();
     close();
 }
@@ -615,6 +623,11 @@ int zmHttpClient::handleHttpFileRequest(const QHttpRequestHeader &hdr)
         isPwa = true;
     }
 
+    if (path == QLatin1String("/metrics"))
+    {
+        return handleMetricsRequest(hdr);
+    }
+
     if (path == QLatin1String("/") || isPwa)
     {
         if (QFile::exists(m_serverRoot + QLatin1String("/pwa/index.html")))
@@ -848,6 +861,42 @@ int zmHttpClient::handleHttpFileRequest(const QHttpRequestHeader &hdr)
     return 0;
 }
 
+/*! Writes the runtime metrics in Prometheus text format. */
+int zmHttpClient::handleMetricsRequest(const QHttpRequestHeader &hdr)
+{
+    QByteArray data(MAX_METRICS_LENGTH, '\0');
+    const unsigned length = MET_Format(data.data(), unsigned(data.size()));
+    data.truncate(int(length));
+
+    QTextStream stream(this);
+
+    if (length == 0)
+    {
+        DBG_Printf(DBG_ERROR, "HTTP metrics exceed %d bytes\n", MAX_METRICS_LENGTH);
+        stream << "HTTP/1.1 500 Internal Server Error\r\n";
+        stream << "Content-Length: 0\r\n";
+        stream << "\r\n";
+        stream.flush();
+        flush();
+        return -1;
+    }
+
+    stream << "HTTP/1.1 200 OK\r\n";
+    stream << "Content-Type: " << HttpContentMetrics << "\r\n";
+    stream << "Content-Length: " << QString::number(data.size()) << "\r\n";
+    stream << "Cache-Control: no-cache\r\n";
+    stream << "\r\n";
+    stream.flush();
+
+    if (hdr.method() != QLatin1String("HEAD"))
+    {
+        write(data);
+    }
+
+    flush();
+    return 0;
+}
+
 void zmHttpClient::handlerDeleted()
 {
     for (auto &handler : m_handlers)
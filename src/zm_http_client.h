@@ -54,6 +54,8 @@ private slots:
     void timeout();
 
 private:
+    int handleMetricsRequest(const QHttpRequestHeader &hdr);
+
     enum ClientState
     {
         ClientIdle,
@@ -31,6 +31,12 @@
 #include "deconz/util.h"
 #include "deconz/green_power_controller.h"
 #include "deconz/timeref.h"
+#include "aps_trace.h"
+#include "event_monitor.h"
+#include "metrics.h"
+#include "param_cache.h"
+#include "phy_sniffer.h"
+#include "serial_capture.h"
 #include "zm_controller.h"
 #include "zm_global.h"
 #include "zm_master.h"
@@ -70,10 +76,31 @@ static const int TimeoutDelay = 500;
 static const int StatusQueryDelay = 500;
 static const int SendDelay = 20;
 static const int MaxCommandFails = 10;
+static const int StatusPushPollDelay = 10000; // fallback poll if a status change frame got lost
+static const int Status1PollInterval = 1000; // APS request responses don't carry status byte 1 (ZLL, interpan)
+static const unsigned StatusPushProtocolVersion = DECONZ_PROTOCOL_VERSION_1_12;
 static int needStatus = 1;
 static uint32_t fwDebugLevel = FW_DEBUG_LEVEL_DISABLED;
 static int64_t tSend;
 static int64_t tStatus;
+static int64_t tIdle;
+static uint64_t tIndPending; // µs, since a status reported a pending APS indication
+
+/*
+ * Status push mode, firmware with protocol version >= StatusPushProtocolVersion
+ * sends ZM_CMD_STATUS_CHANGE unsolicited. Once the first such frame arrived it
+ * replaces the ZM_CMD_STATUS polling, confirm and indication fetches are queued
+ * together and sent back-to-back. Disabled with --status-push=0.
+ */
+enum StatusPushState
+{
+    StatusPushOff,
+    StatusPushSupported, // protocol version matches, waiting for a status change frame
+    StatusPushActive
+};
+
+static bool statusPushAllowed = true;
+static StatusPushState statusPush = StatusPushOff;
 #ifdef PL_LINUX
 // a file in which the firmware version will be written
 // the info will be used by the update script
@@ -215,6 +242,12 @@ static void QItem_Init(QueueItem_t *item)
     item->retries = 0;
 }
 
+static void QItem_UpdateMetrics()
+{
+    MET_Set(MET_QItemsWaitSend, Master.q_items_wait_send);
+    MET_Set(MET_QItemsWaitConfirm, Master.q_items_wait_confirm);
+}
+
 static uint8_t QItem_NextSeq()
 {
     unsigned i;
@@ -283,6 +316,7 @@ static void QItem_Free(QueueItem_t *item)
     }
     item->cmd.cmd = ZM_CMD_INVALID;
     item->state = QITEM_STATE_INIT;
+    QItem_UpdateMetrics();
 }
 
 static int QItem_Enqueue(QueueItem_t *item)
@@ -297,6 +331,7 @@ static int QItem_Enqueue(QueueItem_t *item)
         Q_ASSERT(Master.q_items_wait_send < MAX_QUEUE_ITEMS);
         Master.q_items_wait_send++;
         Master.q_item_wp++;
+        QItem_UpdateMetrics();
 
         if (m_state == zmMaster::MASTER_IDLE)
         {
@@ -345,6 +380,7 @@ static int QItem_Send(QueueItem_t *item)
             item->state = QITEM_STATE_WAIT_CONFIRM;
             item->tref_tx = deCONZ::steadyTimeRef().ref;
             tSend = item->tref_tx;
+            QItem_UpdateMetrics();
         }
         else
         {
@@ -543,6 +579,8 @@ zmMaster::zmMaster(QObject *parent) :
     connect(QCoreApplication::instance(), SIGNAL(aboutToQuit()),
             this, SLOT(appAboutToQuit()));
 
+    statusPushAllowed = deCONZ::appArgumentNumeric("--status-push", 1) != 0;
+
     m_timeoutTimer = startTimer(100);
 }
 
@@ -561,7 +599,7 @@ zmMaster::~zmMaster()
 
 int zmMaster::openSerial(const QString &port, int baudrate)
 {
-    if (m_state != MASTER_OFF)
+    if (m_state != MASTER_OFF || CAP_IsReplay())
     {
         return -4;
     }
@@ -580,6 +618,9 @@ int zmMaster::openSerial(const QString &port, int baudrate)
     m_bootloaderStarted = 0;
     tSend = 0;
     tStatus = 0;
+    tIdle = 0;
+    tIndPending = 0;
+    statusPush = StatusPushOff;
     Master.cmd_fails = 0;
 
     Q_ASSERT(Master.q_aps_rp == 0);
@@ -687,6 +728,7 @@ void zmMaster::queNextApsDataRequest()
         memcpy(&cmd->buffer.data[0], arr.constData(), cmd->buffer.len);
         Master.status0 &= ~ZM_STATUS_FREE_APS_SLOTS;
         QItem_Enqueue(item);
+        TRC_RecordApsRequest(*aps, cmd->seq);
     }
 }
 
@@ -875,6 +917,7 @@ void zmMaster::sendNextCommand()
 
 void zmMaster::taskTimerFired()
 {
+    EVM_Scope evm("zmMaster::taskTimerFired");
     taskHandler(m_taskTimerEvent);
 }
 
@@ -969,7 +1012,21 @@ void zmMaster::processQueue()
             return;
         }
 
-        if (Master.status0 & ZM_STATUS_APS_DATA_CONF)
+        if (statusPush == StatusPushActive && (Master.status0 & (ZM_STATUS_APS_DATA_CONF | ZM_STATUS_APS_DATA_IND)))
+        {
+            int queued = 0;
+
+            // queue both, handleStateIdle() sends them back-to-back
+            if (Master.status0 & ZM_STATUS_APS_DATA_CONF)
+                queued |= queApsDataConfirm();
+
+            if (Master.status0 & ZM_STATUS_APS_DATA_IND)
+                queued |= queApsDataIndication();
+
+            if (queued)
+                return;
+        }
+        else if (Master.status0 & ZM_STATUS_APS_DATA_CONF)
         {
             if (queApsDataConfirm())
                 return;
@@ -1010,6 +1067,8 @@ void zmMaster::timerEvent(QTimerEvent *event)
     if (m_state != MASTER_IDLE)
         return;
 
+    EVM_Scope evm("zmMaster::timerEvent");
+
     if (event->timerId() == m_timeoutTimer)
     {
         if (Master.q_items_wait_confirm || Master.q_items_wait_send || QAPS_Empty() == 0)
@@ -1021,6 +1080,8 @@ void zmMaster::timerEvent(QTimerEvent *event)
 
         if (now - tSend > 60)
         {
+            // Responses are outstanding: keep sending fill commands in push mode too,
+            // the status response recovers a pushed status which got lost on the line.
             if (Master.q_items_wait_confirm)
             {
                 if (needStatus == 0)
@@ -1029,10 +1090,15 @@ void zmMaster::timerEvent(QTimerEvent *event)
                     DBG_Printf(DBG_PROT, "[Master] send fill command\n");
                 }
             }
-            else if ((now - tStatus) > 1000)
+            else if ((now - tStatus) > 1000 && (statusPush != StatusPushActive || (now - tIdle) > 1000))
             {
-                //DBG_Printf(DBG_PROT, "[Master] query status\n");
-                needStatus = 1;
+                tIdle = now;
+
+                if (statusPush != StatusPushActive || (now - tStatus) > StatusPushPollDelay)
+                {
+                    //DBG_Printf(DBG_PROT, "[Master] query status\n");
+                    needStatus = 1;
+                }
 
                 if (QAPS_Empty())
                 {
@@ -1114,6 +1180,17 @@ void zmMaster::processPacked(const zm_command *cmd)
     case ZM_CMD_STATUS:
     case ZM_CMD_STATUS_CHANGE:
     {
+        if (cmd->cmd == ZM_CMD_STATUS_CHANGE)
+        {
+            MET_Inc(MET_SerialStatusPush);
+
+            if (statusPush == StatusPushSupported)
+            {
+                statusPush = StatusPushActive;
+                DBG_Printf(DBG_INFO, "[Master] firmware pushes status changes, stop polling\n");
+            }
+        }
+
         tStatus = deCONZ::steadyTimeRef().ref;
         needStatus = 0;
         checkStatus0(cmd->data);
@@ -1226,6 +1303,7 @@ void zmMaster::processPacked(const zm_command *cmd)
     {
         checkStatus0(cmd->buffer.data);
         needStatus = 0;
+        TRC_RecordApsRequestStatus(cmd->buffer.data[1], cmd->seq, cmd->status);
 
         if (cmd->status == ZM_STATE_SUCCESS)
         {
@@ -1251,6 +1329,8 @@ void zmMaster::processPacked(const zm_command *cmd)
             stream.setByteOrder(QDataStream::LittleEndian);
 
             confirm.readFromStream(stream);
+            TRC_RecordApsConfirm(confirm, cmd->seq, 0);
+
             if (!confirm.dstAddress().hasExt() && confirm.dstAddress().hasNwk())
             {
                 deCONZ::controller()->resolveAddress(confirm.dstAddress());
@@ -1269,7 +1349,13 @@ void zmMaster::processPacked(const zm_command *cmd)
     case ZM_CMD_APS_DATA_INDICATION_2:
     {
         //DBG_Assert(m_state == MASTER_BUSY);
-        checkStatus0(cmd->buffer.data);
+        if (tIndPending != 0)
+        {
+            MET_Observe(MET_ApsIndicationLatency, MET_TimeUs() - tIndPending);
+            tIndPending = 0;
+        }
+
+        checkStatus0(cmd->buffer.data); // restarts the latency measurement if more are pending
         needStatus = 0;
 
         if (cmd->status == ZM_STATE_SUCCESS)
@@ -1298,6 +1384,8 @@ void zmMaster::processPacked(const zm_command *cmd)
                 ind.readFromStream(stream);
             }
 
+            TRC_RecordApsIndication(ind, cmd->seq);
+
             // DBG_Printf(DBG_PROT, "[Master] got APS indication rxtime: %u ms\n", ind.rxTime());
 
             if (DBG_IsEnabled(DBG_APS))
@@ -1429,6 +1517,11 @@ void zmMaster::processPacked(const zm_command *cmd)
                 {
                     m_devProtocolVersion = version;
                     DBG_Printf(DBG_INFO, "Device protocol version: 0x%04X\n", version);
+
+                    if (statusPushAllowed && version >= StatusPushProtocolVersion && statusPush == StatusPushOff)
+                    {
+                        statusPush = StatusPushSupported;
+                    }
                 }
                 else
                 {
@@ -1439,6 +1532,7 @@ void zmMaster::processPacked(const zm_command *cmd)
             {
                 // downgrade if device was changed
                 m_devProtocolVersion = DECONZ_PROTOCOL_VERSION_MIN;
+                statusPush = StatusPushOff;
             }
         }
         else if (id == ZM_DID_APS_TRUST_CENTER_ADDRESS)
@@ -1451,6 +1545,13 @@ void zmMaster::processPacked(const zm_command *cmd)
                 readParameterWithArg(ZM_DID_STK_LINK_KEY, &cmd->buffer.data[1], sizeof(uint64_t));
             }
         }
+        else if (id == ZM_DID_STK_CURRENT_CHANNEL)
+        {
+            if (status == ZM_STATE_SUCCESS && cmd->buffer.len == 2)
+            {
+                SNF_SetChannel(cmd->buffer.data[1]);
+            }
+        }
         else if (id == ZM_DID_STK_DEBUG_LOG_LEVEL)
         {
             if (status == ZM_STATE_SUCCESS)
@@ -1466,8 +1567,14 @@ void zmMaster::processPacked(const zm_command *cmd)
             }
         }
 
+        const bool changed = PRM_Update(id, status, &cmd->buffer.data[1], cmd->buffer.len - 1, deCONZ::steadyTimeRef().ref);
+
         deCONZ::controller()->readParameterResponse(status, id, &cmd->buffer.data[1], cmd->buffer.len - 1);
         emit parameterUpdated(id);
+        if (changed)
+        {
+            emit parameterChanged(id);
+        }
     }
         break;
 
@@ -1598,99 +1705,7 @@ void zmMaster::processPacked(const zm_command *cmd)
     {
         if (cmd->buffer.len > 0)
         {
-            /*------------------------------------------------------------
-            *
-            *      ZEP Packets must be received in the following format:
-            *      |UDP Header|  ZEP Header |IEEE 802.15.4 Packet|
-            *      | 8 bytes  | 16/32 bytes |    <= 127 bytes    |
-            *------------------------------------------------------------
-            *
-            *      ZEP v1 Header will have the following format:
-            *      |Preamble|Version|Channel ID|Device ID|CRC/LQI Mode|LQI Val|Reserved|Length|
-            *      |2 bytes |1 byte |  1 byte  | 2 bytes |   1 byte   |1 byte |7 bytes |1 byte|
-            *
-            *      ZEP v2 Header will have the following format (if type=1/Data):
-            *      |Preamble|Version| Type |Channel ID|Device ID|CRC/LQI Mode|LQI Val|NTP Timestamp|Sequence#|Reserved|Length|
-            *      |2 bytes |1 byte |1 byte|  1 byte  | 2 bytes |   1 byte   |1 byte |   8 bytes   | 4 bytes |10 bytes|1 byte|
-            *
-            *      ZEP v2 Header will have the following format (if type=2/Ack):
-            *      |Preamble|Version| Type |Sequence#|
-            *      |2 bytes |1 byte |1 byte| 4 bytes |
-            *------------------------------------------------------------
-            */
-            QByteArray pkt;
-            QDataStream stream(&pkt, QIODevice::WriteOnly);
-            stream.setByteOrder(QDataStream::BigEndian);
-
-            static quint32 seqNum = 1;
-            quint8 type = cmd->buffer.len > 5 ? 1 : 0;
-
-
-            struct timeval tref;
-            gettimeofday(&tref, NULL);
-
-            const quint32 secs = tref.tv_sec + 0x83AA7E80;
-            const quint32 fraction = (uint32_t)( (double)(tref.tv_usec+1) * (double)(1LL<<32) * 1.0e-6 );
-
-            // preamble
-            stream << (uint8_t)'E';
-            stream << (uint8_t)'X';
-            // version
-            stream << (uint8_t)2;
-            // type
-            stream << type;
-
-            if (type == 1) // data
-            {
-                // channel
-                stream << (uint8_t)11;
-                // deviceId
-                stream << (uint16_t)0;
-                // crc/lqi mode
-                stream << (uint8_t)0;
-                // lqi val
-                stream << (uint8_t)0;
-                // NTP timestamp
-                stream << secs;
-                stream << fraction;
-            }
-
-            // http://waitingkuo.blogspot.de/2012/06/conversion-between-ntp-time-and-unix.html
-
-//            void convert_ntp_time_into_unix_time(struct ntp_time_t *ntp, struct timeval *unix)
-//            {
-//                unix->tv_sec = ntp->second - 0x83AA7E80; // the seconds from Jan 1, 1900 to Jan 1, 1970
-//                unix->tv_usec = (uint32_t)( (double)ntp->fraction * 1.0e6 / (double)(1LL<<32) );
-//            }
-
-//            void convert_unix_time_into_ntp_time(struct timeval *unix, struct ntp_time_t *ntp)
-//            {
-//                ntp->second = unix->tv_sec + 0x83AA7E80;
-//                ntp->fraction = (uint32_t)( (double)(unix->tv_usec+1) * (double)(1LL<<32) * 1.0e-6 );
-//            }
-
-            // seq num
-            stream << (quint32)seqNum++;
-
-            quint8 len = cmd->buffer.len;
-            if (type == 1) // data
-            {
-                // reserved 10 bytes
-                stream << (quint8)0;
-                stream << (quint8)0;
-                stream << (quint8)0;
-                stream << (quint8)0;
-                stream << (quint8)0;
-                stream << (quint8)0;
-                stream << (quint8)0;
-                stream << (quint8)0;
-                stream << (quint8)0;
-                stream << (quint8)0;
-                stream << (quint8)len;
-            }
-
-            for (uint i = 0; i < len; i++)
-                stream << cmd->buffer.data[i];
+            SNF_PhyFrame(cmd->buffer.data, cmd->buffer.len);
         }
     }
         break;
@@ -1750,6 +1765,11 @@ void zmMaster::processPacked(const zm_command *cmd)
  */
 int zmMaster::apsdeDataRequest(const deCONZ::ApsDataRequest &aps)
 {
+    if (CAP_IsReplay())
+    {
+        return 0; // the captured firmware responses follow in the replayed frames
+    }
+
     if (!connected())
     {
         return -1;
@@ -2007,9 +2027,21 @@ void COM_OnPacket(const zm_command *cmd)
     Master.instance->processPacked(cmd);
 }
 
+/*!
+    Prepares processing of captured frames without a device, see CAP_StartReplay().
+
+    Commands which would be sent in response are rejected since connected() stays false.
+ */
+void zmMaster::beginReplay()
+{
+    m_packetCounter = 1; // don't query firmware version and emit deviceConnected()
+    setState(MASTER_IDLE);
+}
+
 void zmMaster::onDeviceConnected()
 {
     needStatus = 1;
+    PRM_Reset();
     setState(MASTER_IDLE);
     startTaskTimer(ACTION_PROCESS, SendDelay, __LINE__);
 }
@@ -2021,6 +2053,9 @@ void zmMaster::onDeviceDisconnected(int reason)
     m_serialPort.clear();
     m_devFirmwareVersion = 0;
     killCommandQueue();
+    PRM_Reset();
+    statusPush = StatusPushOff;
+    tIndPending = 0;
     emit deviceDisconnected(reason);
 }
 
@@ -2051,6 +2086,11 @@ void zmMaster::handleStateIdle(zmMaster::MasterEvent event)
         processQueue();
         sendNextCommand();
 
+        if (statusPush == StatusPushActive)
+        {
+            sendNextCommand(); // pipeline, up to MaxUnconfirmed
+        }
+
         if (Master.q_items_wait_confirm < MaxUnconfirmed && !m_taskTimer->isActive())
         {
             if (Master.status0 & (ZM_STATUS_APS_DATA_CONF | ZM_STATUS_APS_DATA_IND))
@@ -2079,6 +2119,15 @@ void zmMaster::handleStateIdle(zmMaster::MasterEvent event)
     }
 }
 
+/*!
+    Queues a status request unless one is queued already.
+
+    A status request is also redundant while an APS request waits to be sent,
+    its response carries the same status byte 0. Only status byte 1 isn't part of
+    it, so a real status request is sent if none was answered for Status1PollInterval.
+
+    \returns the queue item which will deliver the status, or nullptr if the queue is full.
+ */
 QueueItem *EnqueueStatus()
 {
     unsigned i;
@@ -2087,6 +2136,18 @@ QueueItem *EnqueueStatus()
 
     if (!QItems_Empty())
     {
+        const bool needStatus1 = (deCONZ::steadyTimeRef().ref - tStatus) > Status1PollInterval;
+
+        for (i = 0; i < MAX_QUEUE_ITEMS && !needStatus1; i++)
+        {
+            if (Master.q_items[i].state == QITEM_STATE_WAIT_SEND &&
+                (Master.q_items[i].cmd.cmd == ZM_CMD_APS_DATA_REQ || Master.q_items[i].cmd.cmd == ZM_CMD_APS_DATA_REQ_2))
+            {
+                MET_Inc(MET_SerialStatusCoalesced);
+                return &Master.q_items[i];
+            }
+        }
+
         for (i = 0; i < MAX_QUEUE_ITEMS; i++)
         {
             if (Master.q_items[i].state == QITEM_STATE_INIT)
@@ -2109,6 +2170,7 @@ QueueItem *EnqueueStatus()
     if (!item)
         return nullptr;
 
+    MET_Inc(MET_SerialStatusRequests);
     cmd = &item->cmd;
     cmd->cmd = ZM_CMD_STATUS;
     cmd->data[0] = 0; // dummy value
@@ -2306,9 +2368,15 @@ void zmMaster::checkStatus0(const uint8_t *status)
 {
     ZM_NetState_t n0 = (ZM_NetState_t)(Master.status0 & ZM_STATUS_NET_STATE_MASK);
     ZM_NetState_t n1 = (ZM_NetState_t)(status[0] & ZM_STATUS_NET_STATE_MASK);
+    const bool configChanged = (status[0] & ZM_STATUS_CONFIG_CHANGED) && !(Master.status0 & ZM_STATUS_CONFIG_CHANGED);
 
     Master.status0 = status[0];
 
+    if ((Master.status0 & ZM_STATUS_APS_DATA_IND) && tIndPending == 0)
+    {
+        tIndPending = MET_TimeUs();
+    }
+
     if ((Master.status0 & (ZM_STATUS_APS_DATA_CONF | ZM_STATUS_APS_DATA_IND)) != 0)
     {
         DBG_Printf(DBG_PROT, "[Master] dev-status0: conf: %u, free-slots: %u, ind: %u\n",
@@ -2317,10 +2385,17 @@ void zmMaster::checkStatus0(const uint8_t *status)
                (Master.status0 & ZM_STATUS_APS_DATA_IND) ? 1 : 0);
     }
 
-    if (Master.status0 & ZM_STATUS_CONFIG_CHANGED)
+    if (configChanged)
     {
         DBG_Printf(DBG_INFO, "[Master] config changed, read parameters\n");
-        readParameters();
+        PRM_Invalidate();
+    }
+
+    if (Master.status0 & ZM_STATUS_CONFIG_CHANGED)
+    {
+        // the flag is set in every status until cleared by the firmware,
+        // only parameters which weren't read since the invalidation are queued
+        queParameterReads(true);
     }
 
     if (n0 != n1)
@@ -2503,6 +2578,7 @@ void zmMaster::killCommand(const struct zm_command *cmd, ZM_State_t state)
     switch (cmd->cmd)
     {
     case ZM_CMD_READ_PARAM:
+        PRM_ClearPending((ZM_DataId_t)cmd->data[0]);
         deCONZ::controller()->readParameterResponse(state, (ZM_DataId_t)cmd->data[0], 0, 0);
         break;
 
@@ -2515,6 +2591,8 @@ void zmMaster::killCommand(const struct zm_command *cmd, ZM_State_t state)
     case ZM_CMD_APS_DATA_REQ:
     case ZM_CMD_APS_DATA_REQ_2:
     {
+        // EnqueueStatus() might have relied on the response of this request
+        needStatus = 1;
         emit apsdeDataRequestDone(cmd->buffer.data[0], state);
     }
         break;
@@ -2581,6 +2659,8 @@ int zmMaster::writeParameter(ZM_DataId_t id, const uint8_t *data, uint8_t length
         cmd->buffer.data[0] = (uint8_t)id;
         memcpy(cmd->buffer.data + 1, data, length);
         QItem_Enqueue(item);
+        PRM_InvalidateParam(id);
+        PRM_ClearPending(id); // a read queued before returns the old value, don't merge later reads into it
 
         DBG_Printf(DBG_PROT, "[Master] write param req param: 0x%02X\n", cmd->buffer.data[0]);
         return 0;
@@ -2675,34 +2755,52 @@ int zmMaster::forceRejoinChildNode(const deCONZ::Address &address)
 }
 
 /*!
-    Read all parameters from device.
+    Read all parameters from device, reads which are already queued aren't repeated.
 
     \returns 0 if the request is send to device.
             -1 if the request can't be processed.
  */
 int zmMaster::readParameters()
 {
+    return queParameterReads(false);
+}
+
+/*!
+    Queues reads of all parameters.
+
+    \param invalidOnly - skip parameters read successfully since the last invalidation
+ */
+int zmMaster::queParameterReads(bool invalidOnly)
+{
+    const auto readIfInvalid = [this, invalidOnly](ZM_DataId_t id)
+    {
+        if (!invalidOnly || !PRM_IsValid(id))
+        {
+            readParameter(id);
+        }
+    };
+
     if (connected())
     {
-        readParameter(ZM_DID_STK_PROTOCOL_VERSION);
-        readParameter(ZM_DID_NWK_NETWORK_ADDRESS);
-        readParameter(ZM_DID_MAC_ADDRESS);
-        readParameter(ZM_DID_NWK_PANID);
-        readParameter(ZM_DID_NWK_EXTENDED_PANID);
-        readParameter(ZM_DID_APS_CHANNEL_MASK);
-        readParameter(ZM_DID_APS_DESIGNED_COORDINATOR);
-        readParameter(ZM_DID_APS_TRUST_CENTER_ADDRESS);
-        readParameter(ZM_DID_APS_USE_INSECURE_JOIN);
-        readParameter(ZM_DID_STK_SECURITY_MODE);
-        readParameter(ZM_DID_APS_USE_EXTENDED_PANID);
-        readParameter(ZM_DID_STK_PREDEFINED_PANID);
-        readParameter(ZM_DID_STK_CURRENT_CHANNEL);
-        readParameter(ZM_DID_STK_CONNECT_MODE);
-        readParameter(ZM_DID_STK_PERMIT_JOIN);
-        readParameter(ZM_DID_STK_NWK_UPDATE_ID);
-        readParameter(ZM_DID_STK_ANT_CTRL);
-        readParameter(ZM_DID_STK_NO_ZDP_RESPONSE);
-        readParameter(ZM_DID_STK_DEBUG_LOG_LEVEL);
+        readIfInvalid(ZM_DID_STK_PROTOCOL_VERSION);
+        readIfInvalid(ZM_DID_NWK_NETWORK_ADDRESS);
+        readIfInvalid(ZM_DID_MAC_ADDRESS);
+        readIfInvalid(ZM_DID_NWK_PANID);
+        readIfInvalid(ZM_DID_NWK_EXTENDED_PANID);
+        readIfInvalid(ZM_DID_APS_CHANNEL_MASK);
+        readIfInvalid(ZM_DID_APS_DESIGNED_COORDINATOR);
+        readIfInvalid(ZM_DID_APS_TRUST_CENTER_ADDRESS);
+        readIfInvalid(ZM_DID_APS_USE_INSECURE_JOIN);
+        readIfInvalid(ZM_DID_STK_SECURITY_MODE);
+        readIfInvalid(ZM_DID_APS_USE_EXTENDED_PANID);
+        readIfInvalid(ZM_DID_STK_PREDEFINED_PANID);
+        readIfInvalid(ZM_DID_STK_CURRENT_CHANNEL);
+        readIfInvalid(ZM_DID_STK_CONNECT_MODE);
+        readIfInvalid(ZM_DID_STK_PERMIT_JOIN);
+        readIfInvalid(ZM_DID_STK_NWK_UPDATE_ID);
+        readIfInvalid(ZM_DID_STK_ANT_CTRL);
+        readIfInvalid(ZM_DID_STK_NO_ZDP_RESPONSE);
+        readIfInvalid(ZM_DID_STK_DEBUG_LOG_LEVEL);
         //readParameter(ZM_DID_ZLL_KEY);
         //readParameter(ZM_DID_ZLL_FACTORY_NEW);
         uint8_t keyNum = 0;
@@ -2727,12 +2825,12 @@ int zmMaster::readParameters()
         idx = 2;
         readParameterWithArg(ZM_DID_STK_ENDPOINT, &idx, 1);
 
-        readParameter(ZM_DID_STK_STATIC_NETWORK_ADDRESS);
-        readParameter(ZM_DID_STK_SECURITY_MATERIAL0);
+        readIfInvalid(ZM_DID_STK_STATIC_NETWORK_ADDRESS);
+        readIfInvalid(ZM_DID_STK_SECURITY_MATERIAL0);
 
         if (m_devProtocolVersion >= DECONZ_PROTOCOL_VERSION_1_12)
         {
-            readParameter(ZM_DID_STK_DEBUG);
+            readIfInvalid(ZM_DID_STK_DEBUG);
         }
 
         return 0;
@@ -2741,6 +2839,9 @@ int zmMaster::readParameters()
     return -1;
 }
 
+/*!
+    Queues a read of parameter \p id unless the same read is already queued.
+ */
 int zmMaster::readParameter(ZM_DataId_t id)
 {
     QueueItem_t *item;
@@ -2748,6 +2849,13 @@ int zmMaster::readParameter(ZM_DataId_t id)
 
     if (connected())
     {
+        const int64_t now = deCONZ::steadyTimeRef().ref;
+        if (PRM_IsPending(id, now))
+        {
+            DBG_Printf(DBG_PROT, "[Master] read parameter 0x%02X already queued\n", id);
+            return 0;
+        }
+
         item = QItem_Alloc();
         if (!item)
             return -1;
@@ -2757,6 +2865,7 @@ int zmMaster::readParameter(ZM_DataId_t id)
         cmd->buffer.len = 1;
         cmd->buffer.data[0] = (uint8_t)id;
         QItem_Enqueue(item);
+        PRM_SetPending(id, now);
 
         DBG_Printf(DBG_PROT, "[Master] read parameter 0x%02X\n", id);
         return 0;
@@ -2765,6 +2874,34 @@ int zmMaster::readParameter(ZM_DataId_t id)
     return -1;
 }
 
+/*!
+    Reads subscribed parameters whose TTL has expired.
+
+    \returns the number of queued reads.
+ */
+int zmMaster::refreshParameters()
+{
+    ZM_DataId_t ids[PRM_MAX_PARAMS];
+
+    if (!connected())
+    {
+        return 0;
+    }
+
+    int result = 0;
+    const unsigned n = PRM_Expired(ids, PRM_MAX_PARAMS, deCONZ::steadyTimeRef().ref);
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        if (readParameter(ids[i]) == 0)
+        {
+            result++;
+        }
+    }
+
+    return result;
+}
+
 int zmMaster::readParameterWithArg(ZM_DataId_t id, const uint8_t *data, uint8_t length)
 {
     QueueItem_t *item;
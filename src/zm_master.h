@@ -170,6 +170,7 @@ public:
     const QString &devicePath() const;
     const QString &deviceName() const;
     void startTaskTimer(MasterEvent event, int interval, int line);
+    void beginReplay();
 
 Q_SIGNALS:
     void deviceConnected();
@@ -189,6 +190,10 @@ Q_SIGNALS:
         \param parameter a ZM_DataId_t identifier
      */
     void parameterUpdated(int parameter);
+    /*! Is emitted when a parameter response differs from the previous one, see PRM_Subscribe().
+        \param parameter a ZM_DataId_t identifier
+     */
+    void parameterChanged(int parameter);
     void macPoll(deCONZ::Address address, quint32 lifeTime);
     void beacon(const deCONZ::Beacon&);
 
@@ -203,6 +208,7 @@ public slots:
     int resetDeviceWatchdog(quint32 ttl);
     int readParameters();
     int readParameter(ZM_DataId_t id);
+    int refreshParameters();
     int readParameterWithArg(ZM_DataId_t id, const uint8_t *data, uint8_t length);
     int writeParameter(ZM_DataId_t id, const uint8_t *data, uint8_t length);
     int verifyChildNode(const deCONZ::Address &address, quint8 macCapabilities);
@@ -224,6 +230,7 @@ private:
     void queInterpanDataIndication();
     void queInterpanDataConfirm();
     void queGetStartNetworkConfirmStatus();
+    int queParameterReads(bool invalidOnly);
     void checkStatus0(const uint8_t *status);
     void checkStatus1(const uint8_t *status);
     void killCommand(const struct zm_command *cmd, ZM_State_t state);
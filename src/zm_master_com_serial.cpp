@@ -34,6 +34,9 @@
 
 #include "deconz/dbg_trace.h"
 #include "deconz/util.h"
+#include "event_monitor.h"
+#include "metrics.h"
+#include "serial_capture.h"
 #include "zm_master_com.h"
 #include "zm_master.h"
 #include "common/protocol.h"
@@ -71,7 +74,11 @@
 #define RX_BUFFER_SIZE 256
 #define TX_BUFFER_SIZE 1024
 #define MAX_SEND_LENGTH 196
-#define MAX_SEND_QUEUE_SIZE 4
+#define MAX_SEND_QUEUE_SIZE 8 // power of two, upper bound of LinkProfile::txQueueDepth
+// frames per write, zmMaster has at most two commands (MaxUnconfirmed) in flight,
+// so the firmware never has to take more than two back-to-back frames
+#define MAX_TX_BURST 2
+#define LINK_PROBE_TIMEOUT 3000 // valid frames must arrive within this time after connect
 
 enum ComState
 {
@@ -87,6 +94,24 @@ struct TrxBuffer
     uint8_t data[MAX_SEND_LENGTH];
 };
 
+/*! Settings which depend on the UART speed. */
+struct LinkProfile
+{
+    int baudrate;
+    unsigned txQueueDepth; // power of two
+};
+
+// a deep queue at low speed only delays frames which might be outdated when sent
+static const LinkProfile linkProfiles[] = {
+    { 38400,  2 },
+    { 115200, 4 },
+    { 230400, 8 },
+    { 460800, 8 }
+};
+
+// tried from fastest to slowest with --baudrate-probe=1
+static const int linkProbeRates[] = { 460800, 230400, 115200, 38400 };
+
 class SerialComPrivate
 {
 public:
@@ -99,12 +124,14 @@ public:
     void setState(ComState nextState);
     ComState state();
     void checkBootloader();
+    void checkLinkProbe();
     ComState comState = ComStateOff;
     SerialCom *q = nullptr;
 #ifdef USE_QSERIAL_PORT
     QSerialPort *serialPort = nullptr;
 #endif
     uint8_t protId;
+    bool txHold = false; // collect frames in txBuffer, flush() is called by tx()
     size_t rxBytes = 0;
     int closeReason = deCONZ::DeviceDisconnectNormal;
     bool btlResponse = false;
@@ -137,6 +164,16 @@ static uint8_t PROT_RxBuffer[256];
 static uint8_t sendPos = 0;
 static uint8_t sendEnd = 0;
 static TrxBuffer sendQueue[MAX_SEND_QUEUE_SIZE];
+static unsigned txQueueDepth = 4;
+
+static int linkBaudrate = 0;
+static QString linkProbePort;
+static unsigned linkProbeIndex = 0;
+static bool linkProbeLocked = false;
+static unsigned linkRxFrames = 0; // valid frames since open
+static uint64_t linkOpenUs = 0;
+static uint64_t linkOpenRxFrames = 0;
+static uint64_t linkOpenTxFrames = 0;
 
 static char SER_Getc(void);
 static short SER_Putc(char c);
@@ -152,6 +189,8 @@ static int PL_Read(void *buf, int maxsize);
 static int PL_Write(const void *buf, int size);
 static void PL_Poll();
 
+static void LINK_SetProfile(int baudrate);
+
 static void TXQ_Init(void);
 static int TXQ_IsEmpty(void);
 static int TXQ_IsFull(void);
@@ -194,7 +233,7 @@ static int PL_Connect(const char *path, int baudrate)
 {
     ComPriv->serialPort->setPortName(QLatin1String(path));
 
-    auto bd = QSerialPort::Baud115200;
+    qint32 bd = QSerialPort::Baud115200;
 
     switch (baudrate)
     {
@@ -202,6 +241,8 @@ static int PL_Connect(const char *path, int baudrate)
     [[clang::fallthrough]];
     case 38400:  bd = QSerialPort::Baud38400;  break;
     case 115200:  bd = QSerialPort::Baud115200;  break;
+    case 230400:  bd = 230400;  break;
+    case 460800:  bd = 460800;  break;
     default: // unsupported
     {
         DBG_Printf(DBG_ERROR, "[COM] unsupported --baudrate value\n");
@@ -210,6 +251,7 @@ static int PL_Connect(const char *path, int baudrate)
     }
 
     ComPriv->serialPort->setBaudRate(bd);
+    LINK_SetProfile(bd);
 
     if (!ComPriv->serialPort->open(QSerialPort::ReadWrite))
     {
@@ -434,6 +476,26 @@ static int PL_IsConnected()
     return plThread == nullptr ? 0 : 1;
 }
 
+/*! Returns the termios speed of \p baudrate or 0 if not supported. */
+static speed_t plSpeed(int baudrate)
+{
+    switch (baudrate)
+    {
+    case 38400: return B38400;
+    case 115200: return B115200;
+#ifdef B230400
+    case 230400: return B230400;
+#endif
+#ifdef B460800
+    case 460800: return B460800;
+#endif
+    default:
+        break;
+    }
+
+    return 0;
+}
+
 // https://tldp.org/HOWTO/Serial-Programming-HOWTO/x115.html
 static int plSetupPort(int fd, int baudrate)
 {
@@ -551,7 +613,7 @@ static int PL_Connect(const char *path, int baudrate)
     if (baudrate == 0)
     {
         // TODO this is mostly guess wrong
-        baudrate = B38400;
+        baudrate = 38400;
 
 #ifdef __linux__
         struct stat sb;
@@ -572,7 +634,7 @@ static int PL_Connect(const char *path, int baudrate)
 #endif
             if (dev_major == 166)
             {
-                baudrate = B115200;
+                baudrate = 115200;
             }
         }
         else
@@ -581,24 +643,26 @@ static int PL_Connect(const char *path, int baudrate)
             if (strstr(path, "ACM") ||
                     strstr(path, "ConBee_II")) /* ConBee II Linux */
             {
-                baudrate = B115200;
+                baudrate = 115200;
             }
             else if (strstr(path, "cu.usbmodemDE")) /* ConBee II macOS */
             {
-                baudrate = B115200;
+                baudrate = 115200;
             }
         }
     }
-    else if (baudrate == 115200)
-    {
-        baudrate = B115200;
-    }
-    else if (baudrate == 38400)
+
+    const speed_t speed = plSpeed(baudrate);
+    if (speed == 0)
     {
-        baudrate = B38400;
+        DBG_Printf(DBG_ERROR, "[COM] unsupported --baudrate value\n");
+        ::close(platform.fd);
+        platform.fd = 0;
+        return 0;
     }
 
-    plSetupPort(platform.fd, baudrate);
+    plSetupPort(platform.fd, int(speed));
+    LINK_SetProfile(baudrate);
 
     plThread = new PL_Thread;
     plThread->rx_a = 0;
@@ -815,6 +879,7 @@ void SerialCom::timerEvent(QTimerEvent *event)
 {
     if (event->timerId() == d->pollTimerId)
     {
+        EVM_Scope evm("SerialCom::timerEvent");
         SER_ProcessEvents();
     }
 }
@@ -878,7 +943,7 @@ static void TXQ_Test()
 
     // # 3
     TXQ_Init();
-    for (unsigned i = 0; i < MAX_SEND_QUEUE_SIZE; i++)
+    for (unsigned i = 0; i < txQueueDepth; i++)
     {
         TXQ_Push();
     }
@@ -921,10 +986,7 @@ static int TXQ_IsEmpty(void)
 */
 static int TXQ_IsFull(void)
 {
-    unsigned a = sendPos % MAX_SEND_QUEUE_SIZE;
-    unsigned b = sendEnd % MAX_SEND_QUEUE_SIZE;
-
-    if (sendPos != sendEnd && a == b)
+    if (uint8_t(sendEnd - sendPos) >= txQueueDepth)
     {
         return 1;
     }
@@ -999,6 +1061,7 @@ int SerialCom::send(zm_command *cmd)
 
 void SerialCom::readyRead()
 {
+    EVM_Scope evm("SerialCom::readyRead");
     if (d->rxBuffer.size() == d->rxWritePos)
     {
         DBG_Printf(DBG_ERROR, "[COM] rx buffer full\n");
@@ -1028,6 +1091,7 @@ void SerialCom::readyRead()
     else if ((size_t(nread) + d->rxWritePos) <= d->rxBuffer.size())
     {
         d->rxWritePos +=size_t(nread);
+        MET_Add(MET_SerialRxBytes, unsigned(nread));
     }
 
     DBG_Assert(d->rxWritePos <= d->rxBuffer.size());
@@ -1065,11 +1129,17 @@ void SerialCom::timeout()
     {
         d->setState(ComStateRxTx);
         emit connected();
+
+        if (!linkProbePort.isEmpty() && !linkProbeLocked)
+        {
+            QTimer::singleShot(LINK_PROBE_TIMEOUT, this, [this]() { d->checkLinkProbe(); });
+        }
     }
 }
 
 void SerialCom::processTh0Events()
 {
+    EVM_Scope evm("SerialCom::processTh0Events");
     SER_ProcessEvents();
 }
 
@@ -1099,6 +1169,19 @@ int SerialComPrivate::open(int baudrate)
 {
     baudrate = deCONZ::appArgumentNumeric("--baudrate", baudrate);
 
+    if (deCONZ::appArgumentNumeric("--baudrate-probe", 0) > 0)
+    {
+        if (linkProbePort != port)
+        {
+            linkProbePort = port;
+            linkProbeIndex = 0;
+            linkProbeLocked = false;
+        }
+
+        baudrate = linkProbeRates[linkProbeIndex];
+    }
+
+    linkRxFrames = 0;
     TXQ_Init();
 
     rxBytes = 0;
@@ -1115,9 +1198,58 @@ int SerialComPrivate::open(int baudrate)
     protId = protocol_add(PROTO_RX | PROTO_TX | PROTO_FLAGGED | PROTO_TRACE,
                                   SER_Getc, SER_Isc, SER_Putc, SER_Flush, SER_Packet);
     protocol_set_buffer(protId, PROT_RxBuffer, sizeof(PROT_RxBuffer));
+
+    linkOpenUs = MET_TimeUs();
+    linkOpenRxFrames = MET_Value(MET_SerialRxFrames);
+    linkOpenTxFrames = MET_Value(MET_SerialTxFrames);
     return 0;
 }
 
+/*! Selects the link profile with the highest baud rate not above \p baudrate. */
+static void LINK_SetProfile(int baudrate)
+{
+    const LinkProfile *profile = &linkProfiles[0];
+
+    for (const LinkProfile &p : linkProfiles)
+    {
+        if (p.baudrate <= baudrate)
+        {
+            profile = &p;
+        }
+    }
+
+    linkBaudrate = baudrate;
+    txQueueDepth = profile->txQueueDepth;
+    MET_Set(MET_SerialBaudrate, uint64_t(baudrate));
+
+    DBG_Printf(DBG_INFO, "[COM] link %d baud, tx queue depth: %u\n", baudrate, txQueueDepth);
+}
+
+/*! Falls back to the next slower rate if no valid frame arrived at the probed rate. */
+void SerialComPrivate::checkLinkProbe()
+{
+    if (comState != ComStateRxTx || linkProbeLocked)
+    {
+        return;
+    }
+
+    if (linkRxFrames > 0)
+    {
+        linkProbeLocked = true;
+        return;
+    }
+
+    if (linkProbeIndex + 1 >= sizeof(linkProbeRates) / sizeof(linkProbeRates[0]))
+    {
+        DBG_Printf(DBG_ERROR, "[COM] link probe: no valid frames at %d baud\n", linkBaudrate);
+        return; // slowest rate, keep trying
+    }
+
+    linkProbeIndex++;
+    DBG_Printf(DBG_INFO, "[COM] link probe: no valid frames at %d baud, fall back to %d baud\n", linkBaudrate, linkProbeRates[linkProbeIndex]);
+    q->close();
+}
+
 int SerialComPrivate::close()
 {
     if (protId != PROTO_NO_PROTOCOL)
@@ -1130,6 +1262,19 @@ int SerialComPrivate::close()
     sendEnd = 0;
     sendPos = 0;
 
+    if (linkOpenUs > 0)
+    {
+        // effective throughput of the session, compare runs at different --baudrate
+        const double secs = double(MET_TimeUs() - linkOpenUs) / 1e6;
+        if (secs > 0)
+        {
+            DBG_Printf(DBG_INFO, "[COM] link %d baud: %.1f s, rx %.1f frames/s, tx %.1f frames/s\n", linkBaudrate, secs,
+                       double(MET_Value(MET_SerialRxFrames) - linkOpenRxFrames) / secs,
+                       double(MET_Value(MET_SerialTxFrames) - linkOpenTxFrames) / secs);
+        }
+        linkOpenUs = 0;
+    }
+
     closeReason = deCONZ::DeviceDisconnectNormal;
 
     if (PL_IsConnected())
@@ -1165,25 +1310,42 @@ int SerialComPrivate::rx()
         protocol_receive(protId);
     }
 
+    MET_Set(MET_SerialCrcErrors, protocol_crc_errors());
+
     return 0;
 }
 
+/*! Writes up to MAX_TX_BURST queued frames with one write as long as they fit into txBuffer. */
 int SerialComPrivate::tx()
 {
-    if (TXQ_IsEmpty() == 0)
+    txHold = true;
+
+    for (int n = 0; n < MAX_TX_BURST && TXQ_IsEmpty() == 0; n++)
     {
+        // worst case SLIP size: every byte and the CRC escaped plus two end markers
+        const TrxBuffer &next = sendQueue[sendPos % MAX_SEND_QUEUE_SIZE];
+        if (txWritePos > 0 && txWritePos + 2 * (next.length + 2) + 2 >= txBuffer.size())
+        {
+            break;
+        }
+
         unsigned a =  TXQ_Pop();
         TrxBuffer &buf = sendQueue[a];
 
         if (buf.length > 0)
         {
             protocol_send(protId, buf.data, buf.length);
+            MET_Inc(MET_SerialTxFrames);
+            CAP_RecordFrame(CAP_DirTx, buf.data, buf.length);
 #ifdef DBG_SERIAL
             DBG_Printf(DBG_WIRE, "\n");
 #endif
         }
     }
 
+    txHold = false;
+    flush();
+
     return 0;
 }
 
@@ -1199,10 +1361,12 @@ void SerialComPrivate::flush()
 
     M_ASSERT((txReadPos + length) < txBuffer.size());
     int nwrite = PL_Write(&txBuffer[txReadPos], length);
+    MET_Inc(MET_SerialTxWrites);
 
     // M_ASSERT(nwrite == length);
     if (nwrite > 0)
     {
+        MET_Add(MET_SerialTxBytes, unsigned(nwrite));
         txReadPos += nwrite;
         int remaining = (int)txWritePos - (int)txReadPos;
         DBG_Printf(DBG_PROT, "[COM] written %d bytes, left %d\n", nwrite, remaining);
@@ -1329,7 +1493,7 @@ short SER_Putc(char c)
 
 static void SER_Flush()
 {
-    if (ComPriv)
+    if (ComPriv && !ComPriv->txHold)
     {
         ComPriv->flush();
     }
@@ -1350,10 +1514,18 @@ static void SER_Packet(uint8_t *data, uint16_t length)
             DBG_Printf(DBG_PROT_L2, "[COM] rx: %s\n", ascii);
         }
 #endif
+        MET_Inc(MET_SerialRxFrames);
+        CAP_RecordFrame(CAP_DirRx, data, length);
         struct zm_command cmd;
         const auto ret = zm_protocol_buffer2command(data, length, &cmd);
         if (ret == ZM_PARSE_OK)
         {
+            linkRxFrames++;
+            if (!linkProbePort.isEmpty() && !linkProbeLocked)
+            {
+                linkProbeLocked = true;
+                DBG_Printf(DBG_INFO, "[COM] link probe: %d baud ok\n", linkBaudrate);
+            }
             COM_OnPacket(&cmd);
         }
 #ifdef DBG_SERIAL
@@ -27,10 +27,16 @@ static const int BindingTableCheckInterval = 90 * 1000;
 static const int PowerCheckInterval = 60 * 60 * 1000;
 static const int MaxRetrys = 2;
 static const uint MaxRetryWait = 600 * 1000;
+static deCONZ::FetchChangedCallback fetchChangedCallback = nullptr;
 
 namespace deCONZ
 {
 
+void setFetchChangedCallback(FetchChangedCallback callback)
+{
+    fetchChangedCallback = callback;
+}
+
 void setFetchInterval(RequestId item, int interval)
 {
     interval *= 1000;
@@ -371,6 +377,11 @@ void zmNode::resetItem(RequestId item)
     default:
         break;
     }
+
+    if (fetchChangedCallback)
+    {
+        fetchChangedCallback(this, item);
+    }
 }
 
 /*!
@@ -605,6 +616,11 @@ int zmNode::retryIncr(deCONZ::RequestId item)
             fi.lastCheck = deCONZ::steadyTimeRef().ref;
         }
 
+        if (fetchChangedCallback)
+        {
+            fetchChangedCallback(this, item);
+        }
+
         return fi.retries;
     }
 
@@ -657,236 +673,210 @@ void zmNode::FetchInfo::removeDependency(deCONZ::RequestId id)
 }
 
 /*!
-    Optain if \p item has to be fetched (or fetched again).
+    Set the \p fetched state of a item.
  */
-bool zmNode::needFetch(deCONZ::RequestId item)
+void zmNode::setFetched(deCONZ::RequestId item, bool fetched)
 {
     if (item >= ReqMaxItems)
     {
-         // default for unknown items to prevent endless requests
-        return false;
+        return;
     }
 
     FetchInfo &fi = m_fetchItems[item];
 
-    if (!fi.isEnabled())
-    {
-        return false;
-    }
-
-    if (fi.retries >= fi.retriesMax)
+    switch (item)
     {
-        if ((fi.lastCheck + (int64_t)MaxRetryWait) < deCONZ::steadyTimeRef().ref)
+    case deCONZ::ReqActiveEndpoints:
+    case deCONZ::ReqSimpleDescriptor:
+    case deCONZ::ReqMgmtLqi:
+    case deCONZ::ReqNwkAddr:
+    case deCONZ::ReqIeeeAddr:
+    case deCONZ::ReqMgmtBind:
+    case deCONZ::ReqPowerDescriptor:
+        if (fetched)
         {
-            // try again
-            fi.retries = 0;
+            fi.lastCheck = deCONZ::steadyTimeRef().ref +  (U_rand32() % 30);
         }
         else
         {
-            return false;
+            fi.lastCheck = 0;
         }
+        break;
+
+    default:
+        break;
     }
 
-    switch (item)
-    {
-    case deCONZ::ReqNodeDescriptor:
+    // force refetch of known simpledescriptors
+    if (item == deCONZ::ReqSimpleDescriptor && !fetched)
     {
-        if (nodeDescriptor().isNull())
+        for (const deCONZ::SimpleDescriptor &sd : simpleDescriptors())
         {
-            return true;
+            auto &feps = d_ptr->m_fetchEndpoints;
+            if (std::find(feps.begin(), feps.end(), sd.endpoint()) == feps.end())
+            {
+                feps.push_back(sd.endpoint());
+            }
         }
     }
-        break;
 
-    case deCONZ::ReqIeeeAddr:
+    fi.retries = 0;
+    fi.fetched = fetched;
+
+    if (fetched)
     {
-        if (fi.checkInterval != IeeeAddrCheckInterval)
+        for (int i = 0; i < ReqMaxItems; i++)
         {
-            fi.checkInterval = IeeeAddrCheckInterval;
+            FetchInfo &fi = m_fetchItems[i];
+            fi.removeDependency(item);
         }
+    }
 
-        if (address().hasNwk() && !address().hasExt())
-        {
-            return true;
-        }
-        else if (!fi.fetched)
-        {
-            return true;
-        }
-        else if ((fi.lastCheck + fi.checkInterval) < deCONZ::steadyTimeRef().ref)
-        {
+    if (fetchChangedCallback)
+    {
+        fetchChangedCallback(this, item);
+    }
+}
 
-            return true;
-        }
+/*!
+    Optain if \p item has to be fetched (or fetched again).
+
+    The decision is taken from fetchDue(), so the discovery schedule and the
+    fetch can't disagree.
+ */
+bool zmNode::needFetch(deCONZ::RequestId item)
+{
+    if (item <= ReqUnknown || item >= ReqMaxItems)
+    {
+         // default for unknown items to prevent endless requests
+        return false;
     }
-        break;
 
-    case deCONZ::ReqActiveEndpoints:
+    FetchInfo &fi = m_fetchItems[item];
+    const SteadyTimeRef now = deCONZ::steadyTimeRef();
+
+    switch (item)
     {
-        if (fi.checkInterval != ActiveEndpointsCheckInterval)
-        {
-            fi.checkInterval = ActiveEndpointsCheckInterval;
-        }
+    case deCONZ::ReqIeeeAddr:        fi.checkInterval = IeeeAddrCheckInterval; break;
+    case deCONZ::ReqActiveEndpoints: fi.checkInterval = ActiveEndpointsCheckInterval; break;
+    case deCONZ::ReqPowerDescriptor: fi.checkInterval = PowerCheckInterval; break;
+    case deCONZ::ReqMgmtLqi:         fi.checkInterval = MgmtLqiCheckInterval; break;
+    default:
+        break;
+    }
 
-        if (!fi.fetched)
-        {
-            return true;
-        }
-        else if (isEndDevice())
-        {
-            return false; // no periodic fetchting for end devices
-        }
-        else if (endpoints().empty())
-        {
-            return true;
-        }
+    if (fi.retries >= fi.retriesMax && (fi.lastCheck + (int64_t)MaxRetryWait) <= now.ref)
+    {
+        // try again
+        fi.retries = 0;
     }
-        break;
 
+    const SteadyTimeRef due = fetchDue(item);
+    return isValid(due) && due.ref <= now.ref;
+}
 
-    case deCONZ::ReqNwkAddr:
+/*!
+    Returns the time when \p item needs to be fetched, a time not later than
+    now if it's needed already. needFetch() is true from this time on.
+
+    The time is invalid when the item is disabled or has no periodic check,
+    in this case it is only scheduled again when the fetch state changes.
+ */
+SteadyTimeRef zmNode::fetchDue(deCONZ::RequestId item)
+{
+    if (item <= ReqUnknown || item >= ReqMaxItems)
     {
-        if (address().hasExt() && !address().hasNwk())
-        {
-            return true;
-        }
-        else if (!fi.fetched)
-        {
-            return true;
-        }
+        return {};
     }
-        break;
 
-    case deCONZ::ReqSimpleDescriptor:
+    const FetchInfo &fi = m_fetchItems[item];
+    const SteadyTimeRef now = deCONZ::steadyTimeRef();
+    SteadyTimeRef due;
+
+    if (item == deCONZ::ReqMgmtLqi)
     {
-        if (!fi.fetched)
-        {
-            return true;
-        }
-        else if (endpoints().size() == (uint)simpleDescriptors().size() &&
-                 d_ptr->m_fetchEndpoints.empty())
+        // routers are polled independent of the enabled state
+        if (isEndDevice())
         {
-            return false;
+            return {};
         }
 
-        return true;
+        return fi.fetched ? SteadyTimeRef{fi.lastCheck + MgmtLqiCheckInterval} : now;
     }
 
-    case deCONZ::ReqPowerDescriptor:
-        if (!powerDescriptor().isValid())
+    if (!fi.enabled || fi.depend != 0)
+    {
+        return {};
+    }
+
+    switch (item)
+    {
+    case deCONZ::ReqNodeDescriptor:
+        if (nodeDescriptor().isNull() || !fi.fetched)
         {
-            return true;
+            due = now;
         }
-        else if (!isEndDevice())
+        break;
+
+    case deCONZ::ReqIeeeAddr:
+        if ((address().hasNwk() && !address().hasExt()) || !fi.fetched)
         {
-            return false;
+            due = now;
         }
-
-        if (isEndDevice() && fi.fetched)
+        else
         {
-            return false;
+            due = SteadyTimeRef{fi.lastCheck + IeeeAddrCheckInterval};
         }
+        break;
 
-        if (fi.checkInterval != PowerCheckInterval)
+    case deCONZ::ReqActiveEndpoints:
+        if (!fi.fetched)
         {
-            fi.checkInterval = PowerCheckInterval;
+            due = now;
         }
-
-        if ((fi.lastCheck + fi.checkInterval) < deCONZ::steadyTimeRef().ref)
+        else if (!isEndDevice() && endpoints().empty()) // no periodic fetching for end devices
         {
-            return true;
+            due = now;
         }
         break;
 
-    case deCONZ::ReqMgmtLqi:
-        if (isCoordinator() || isRouter())
+    case deCONZ::ReqNwkAddr:
+        if ((address().hasExt() && !address().hasNwk()) || !fi.fetched)
         {
-            if (!fi.fetched)
-            {
-                return true;
-            }
-
-            if (fi.checkInterval != MgmtLqiCheckInterval)
-            {
-                fi.checkInterval = MgmtLqiCheckInterval;
-            }
-
-            int64_t cur = deCONZ::steadyTimeRef().ref;
-
-            if ((fi.lastCheck + fi.checkInterval) < cur)
-            {
-                return true;
-            }
+            due = now;
         }
-
-        return false;
-
-    default:
         break;
-    }
-
-    return !fi.fetched;
-}
 
-/*!
-    Set the \p fetched state of a item.
- */
-void zmNode::setFetched(deCONZ::RequestId item, bool fetched)
-{
-    if (item >= ReqMaxItems)
-    {
-        return;
-    }
-
-    FetchInfo &fi = m_fetchItems[item];
-
-    switch (item)
-    {
-    case deCONZ::ReqActiveEndpoints:
     case deCONZ::ReqSimpleDescriptor:
-    case deCONZ::ReqMgmtLqi:
-    case deCONZ::ReqNwkAddr:
-    case deCONZ::ReqIeeeAddr:
-    case deCONZ::ReqMgmtBind:
-    case deCONZ::ReqPowerDescriptor:
-        if (fetched)
+        if (!fi.fetched || endpoints().size() != (uint)simpleDescriptors().size() ||
+            !d_ptr->m_fetchEndpoints.empty())
         {
-            fi.lastCheck = deCONZ::steadyTimeRef().ref +  (U_rand32() % 30);
+            due = now;
         }
-        else
+        break;
+
+    case deCONZ::ReqPowerDescriptor:
+        if (!powerDescriptor().isValid() || (isEndDevice() && !fi.fetched))
         {
-            fi.lastCheck = 0;
+            due = now;
         }
         break;
 
     default:
-        break;
-    }
-
-    // force refetch of known simpledescriptors
-    if (item == deCONZ::ReqSimpleDescriptor && !fetched)
-    {
-        for (const deCONZ::SimpleDescriptor &sd : simpleDescriptors())
+        if (!fi.fetched)
         {
-            auto &feps = d_ptr->m_fetchEndpoints;
-            if (std::find(feps.begin(), feps.end(), sd.endpoint()) == feps.end())
-            {
-                feps.push_back(sd.endpoint());
-            }
+            due = now;
         }
+        break;
     }
 
-    fi.retries = 0;
-    fi.fetched = fetched;
-
-    if (fetched)
+    if (isValid(due) && fi.retries >= fi.retriesMax && due.ref < fi.lastCheck + (int64_t)MaxRetryWait)
     {
-        for (int i = 0; i < ReqMaxItems; i++)
-        {
-            FetchInfo &fi = m_fetchItems[i];
-            fi.removeDependency(item);
-        }
+        // wait before trying again
+        due = SteadyTimeRef{fi.lastCheck + (int64_t)MaxRetryWait};
     }
+
+    return due;
 }
 
 #if 0
@@ -933,6 +923,11 @@ void zmNode::setFetchItemEnabled(deCONZ::RequestId item, bool enabled)
              m_fetchItems[item].fetched = false;
              m_fetchItems[item].lastCheck = 0;
         }
+
+        if (fetchChangedCallback)
+        {
+            fetchChangedCallback(this, item);
+        }
     }
 }
 
@@ -13,6 +13,7 @@
 
 #include <QString>
 #include <QElapsedTimer>
+#include <array>
 #include <vector>
 
 #include "deconz/binding_table.h"
@@ -32,8 +33,14 @@ class zmNeighbor;
 
 namespace deCONZ
 {
+    class zmNode;
+
+    /*! Called when the fetch state of an item changes, see zmNode::fetchDue(). */
+    typedef void (*FetchChangedCallback)(zmNode *node, RequestId item);
+
     void /*DECONZ_DLLSPEC*/ setFetchInterval(RequestId item, int interval);
     int /*DECONZ_DLLSPEC*/ getFetchInterval(RequestId item);
+    void setFetchChangedCallback(FetchChangedCallback callback);
 
     struct RoutingTableEntry
     {
@@ -85,6 +92,7 @@ public:
 
     // fetch helper
     bool needFetch(RequestId item);
+    deCONZ::SteadyTimeRef fetchDue(RequestId item);
     void setFetched(RequestId item, bool fetched);
     bool isFetchItemEnabled(RequestId item);
     void setFetchItemEnabled(RequestId item, bool enabled);
@@ -194,17 +202,61 @@ private:
 } // namespace deCONZ
 
 #include <QPointF>
+/*! Cached (endpoint, cluster, side) resolution, stored as indexes so it can't dangle. */
+struct ClusterCacheEntry
+{
+    uint16_t clusterId = 0xFFFF;
+    uint16_t clusterIndex = 0;
+    uint8_t endpoint = 0;
+    uint8_t side = 0;
+    uint8_t sdIndex = 0xFF; // 0xFF unused
+};
+
+/*! Last time bindings matching reports of (source endpoint, cluster, destination) were refreshed. */
+struct BindingRefreshEntry
+{
+    deCONZ::SteadyTimeRef time;
+    uint16_t clusterId = 0xFFFF;
+    uint16_t dst = 0; //!< group or destination endpoint
+    uint8_t srcEndpoint = 0;
+    uint8_t isGroup = 0;
+};
+
+/*! Per destination APS congestion state (AIMD), see NI_ApsConfirmed(). */
+struct ApsCongestion
+{
+    float window = 0; //!< in-flight requests, 0 until first confirm
+    uint16_t srttMs = 0; //!< smoothed confirm round trip time
+    uint16_t rttVarMs = 0;
+    uint16_t spacingMs = 0; //!< minimum time between two requests
+    uint32_t confirms = 0;
+    uint32_t failures = 0;
+    deCONZ::SteadyTimeRef lastSend;
+};
+
 struct NodeInfo
 {
     NodeInfo() = default;
     bool operator ==(const NodeInfo &other) { return id == other.id; }
     bool operator <(const NodeInfo &other) const;
 
-    bool isValid() const { return (id && data && g); }
+    bool isValid() const { return (id && data); }
     uint32_t id = 0; //!< Internal unique id.
     deCONZ::zmNode *data = nullptr; //!< The node data.
-    zmgNode *g = nullptr; //!< The QGraphicsItem representation.
-    QPointF pos;
+    zmgNode *g = nullptr; //!< The QGraphicsItem representation, nullptr in headless mode.
+    QPointF pos; //!< Scene position, stored from here when \c g is nullptr.
+    bool needSaveToDatabase = false; //!< Replaces zmgNode::needSaveToDatabase() when \c g is nullptr.
+    bool visible = true; //!< Hidden nodes are inactive, tracked independent of \c g.
+    uint8_t clusterCacheIter = 0;
+    std::array<ClusterCacheEntry, 4> clusterCache{}; //!< See NI_GetCluster().
+    uint8_t bindingRefreshIter = 0;
+    std::array<BindingRefreshEntry, 4> bindingRefresh{}; //!< See NI_BindingRefreshDue().
+    ApsCongestion aps;
+    std::array<deCONZ::SteadyTimeRef, deCONZ::ReqMaxItems> discoveryDue{}; //!< Scheduled discovery tasks, ReqUnknown is the zombie check.
+    uint8_t topologyScan = 0; //!< TopologyScanFlags
+    uint8_t topologyScanTries = 0; //!< requests without response for the current page
+    uint64_t vfsMtime = 0; //!< Last change of notified VFS entries, 0 if unknown.
+    uint64_t vfsEndpointsMtime = 0; //!< Last change of the simple descriptors, 0 if unknown.
 };
 
 Q_DECLARE_METATYPE(NodeInfo)
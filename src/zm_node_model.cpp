@@ -8,8 +8,11 @@
  *
  */
 
+#include <QBasicTimer>
 #include <QFont>
+#include <QHash>
 #include <QStringList>
+#include <QTimerEvent>
 #include <vector>
 #include "zm_node_model.h"
 
@@ -26,12 +29,21 @@ public:
     QString version;
     uint64_t mac;
     uint16_t nwk;
+    uint8_t dirtyColumns = 0; // bit per Column, pending dataChanged()
 };
 
+/* Updates are signalled at most once per frame. */
+#define NM_FLUSH_INTERVAL_MS 16
+
 class NodeModelPrivate
 {
 public:
+    int row(uint64_t mac) const { return rows.value(mac, -1); }
+
     std::vector<NodeModelEntry> entries;
+    QHash<uint64_t, int> rows; // mac -> index in entries
+    std::vector<uint64_t> dirty; // macs with dirtyColumns set
+    QBasicTimer flushTimer;
     QStringList m_sectionNames;
     State m_devState;
 };
@@ -141,12 +153,9 @@ void NodeModel::addNode(uint64_t extAddr, uint16_t nwkAddr)
         return;
     }
 
-    for (size_t i = 0; i < d_ptr2->entries.size(); i++)
+    if (d_ptr2->row(extAddr) >= 0)
     {
-        if (d_ptr2->entries[i].mac == extAddr)
-        {
-            return;
-        }
+        return;
     }
 
     int row = (int)d_ptr2->entries.size();
@@ -159,87 +168,138 @@ void NodeModel::addNode(uint64_t extAddr, uint16_t nwkAddr)
     entry.nwkAddress = QString("0x%1").arg(nwkAddr, int(4), int(16), QChar('0'));
 
     d_ptr2->entries.push_back(entry);
+    d_ptr2->rows.insert(extAddr, row);
 
     endInsertRows();
 }
 
+/*! Removes the row of \p extAddr, the last row is moved into its place. */
 void NodeModel::removeNode(uint64_t extAddr)
 {
-    for (size_t i = 0; i < d_ptr2->entries.size(); i++)
+    const int row = d_ptr2->row(extAddr);
+    if (row < 0)
     {
-        if (d_ptr2->entries[i].mac == extAddr)
-        {
-            beginRemoveRows(QModelIndex(), i, i);
-            d_ptr2->entries[i] = d_ptr2->entries.back();
-            d_ptr2->entries.pop_back();
-            endRemoveRows();
-            return;
-        }
+        return;
+    }
+
+    const int last = (int)d_ptr2->entries.size() - 1;
+    d_ptr2->rows.remove(extAddr);
+
+    if (row != last)
+    {
+        d_ptr2->entries[row] = d_ptr2->entries[last];
+        d_ptr2->rows.insert(d_ptr2->entries[row].mac, row);
+        emit dataChanged(index(row, 0, QModelIndex()), index(row, MaxColumn - 1, QModelIndex()), { Qt::DisplayRole });
     }
+
+    beginRemoveRows(QModelIndex(), last, last);
+    d_ptr2->entries.pop_back();
+    endRemoveRows();
 }
 
+/*! Updates a column of \p extAddr, the dataChanged() signal is emitted delayed per frame. */
 void NodeModel::setData(uint64_t extAddr, Column column, const QVariant &data)
 {
-    for (size_t i = 0; i < d_ptr2->entries.size(); i++)
+    const int row = d_ptr2->row(extAddr);
+    if (row < 0)
+    {
+        return;
+    }
+
+    NodeModelEntry &entry = d_ptr2->entries[row];
+    QString *str = nullptr;
+
+    switch (column)
+    {
+    case NwkAddressColumn:
     {
-        NodeModelEntry &entry = d_ptr2->entries[i];
-        if (entry.mac == extAddr)
+        const uint16_t nwk = data.toUInt();
+        if (entry.nwk == nwk)
         {
+            return;
+        }
+
+        entry.nwk = nwk;
+        entry.nwkAddress = QString("0x%1").arg(entry.nwk, int(4), int(16), QChar('0'));
+    }
+        break;
+
+    case NameColumn:    str = &entry.name; break;
+    case ModelIdColumn: str = &entry.model; break;
+    case VendorColumn:  str = &entry.vendor; break;
+    case VersionColumn: str = &entry.version; break;
+    default:
+        return;
+    }
 
-            bool updated = false;
-            if (column == NwkAddressColumn && entry.nwk != data.toUInt())
-            {
-                    entry.nwk = data.toUInt();
-                    entry.nwkAddress = QString("0x%1").arg(entry.nwk, int(4), int(16), QChar('0'));
-                    updated = true;
-            }
-
-            if (column == ModelIdColumn && entry.model != data.toString())
-            {
-                entry.model = data.toString();
-                updated = true;
-            }
-
-            if (column == VendorColumn && entry.vendor != data.toString())
-            {
-                entry.vendor = data.toString();
-                updated = true;
-            }
-
-            if (column == NameColumn && entry.name != data.toString())
-            {
-                entry.name = data.toString();
-                updated = true;
-            }
-
-            if (column == VersionColumn && entry.version != data.toString())
-            {
-                entry.version = data.toString();
-                updated = true;
-            }
-
-            if (updated)
-            {
-                QModelIndex topLeft = index((int)i, column, QModelIndex());
-                QModelIndex bottomRight = index((int)i, column, QModelIndex());
-                emit dataChanged(topLeft, bottomRight, { Qt::DisplayRole });
-            }
+    if (str)
+    {
+        QString value = data.toString();
+        if (*str == value)
+        {
             return;
         }
+        *str = std::move(value);
+    }
+
+    if (entry.dirtyColumns == 0)
+    {
+        d_ptr2->dirty.push_back(extAddr);
+    }
+    entry.dirtyColumns |= 1 << column;
+
+    if (!d_ptr2->flushTimer.isActive())
+    {
+        d_ptr2->flushTimer.start(NM_FLUSH_INTERVAL_MS, this);
     }
 }
 
 QVariant NodeModel::data(uint64_t extAddr, Column column) const
 {
-    for (size_t i = 0; i < d_ptr2->entries.size(); i++)
+    const int row = d_ptr2->row(extAddr);
+    if (row >= 0)
     {
-        if (d_ptr2->entries[i].mac == extAddr)
+        return data(index(row, column, QModelIndex()), Qt::DisplayRole);
+    }
+
+    return QVariant();
+}
+
+/*! Emits the pending dataChanged() signals, one per changed row. */
+void NodeModel::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != d_ptr2->flushTimer.timerId())
+    {
+        QAbstractTableModel::timerEvent(event);
+        return;
+    }
+
+    d_ptr2->flushTimer.stop();
+
+    for (uint64_t mac : d_ptr2->dirty)
+    {
+        const int row = d_ptr2->row(mac);
+        if (row < 0)
         {
-            return data(index((int)i, column, QModelIndex()), Qt::DisplayRole);
+            continue; // removed meanwhile
         }
+
+        NodeModelEntry &entry = d_ptr2->entries[row];
+        if (entry.dirtyColumns == 0)
+        {
+            continue;
+        }
+
+        int first = 0;
+        int last = MaxColumn - 1;
+        while (!(entry.dirtyColumns & (1 << first))) { first++; }
+        while (!(entry.dirtyColumns & (1 << last))) { last--; }
+        entry.dirtyColumns = 0;
+
+        emit dataChanged(index(row, first, QModelIndex()), index(row, last, QModelIndex()), { Qt::DisplayRole });
     }
 
-    return QVariant();
+    d_ptr2->dirty.clear();
 }
 
 
@@ -59,6 +59,9 @@ public:
 public Q_SLOTS:
     void setDeviceState(State state);
 
+protected:
+    void timerEvent(QTimerEvent *event) override;
+
 private:
     NodeModelPrivate *d_ptr2 = nullptr;
 };